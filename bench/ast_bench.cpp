@@ -0,0 +1,108 @@
+/**
+ * @file ast_bench.cpp
+ * @author Salvatore Cardamone
+ * @brief Microbenchmarks for traversal of the Kaleidoscope ASTs.
+ */
+// clang-format off
+#include <benchmark/benchmark.h>
+
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "hls/ast.hpp"
+#include "hls/ast_visitor.hpp"
+// clang-format on
+
+/**
+ * @brief Build a call-heavy expression; a tree of calls with the given fan-out
+ * and depth whose leaves alternate between variables and numbers.
+ * @param fanout Number of arguments to each call.
+ * @param depth Depth of the call tree.
+ * @return The root of the expression.
+ */
+static std::shared_ptr<hls::ExprAST> call_tree(int fanout, int depth) {
+  if (depth == 0) {
+    return std::make_shared<hls::BinaryExprAST>(
+        '+', std::make_shared<hls::VariableExprAST>("x"),
+        std::make_shared<hls::NumberExprAST>(1.0));
+  }
+  std::vector<std::shared_ptr<hls::ExprAST>> args;
+  for (int idx = 0; idx < fanout; ++idx)
+    args.push_back(call_tree(fanout, depth - 1));
+  return std::make_shared<hls::CallExprAST>("f" + std::to_string(depth),
+                                            std::move(args));
+}
+
+/**
+ * @brief Visitor that counts the nodes in an expression, walking it through
+ * the reference-returning accessors.
+ */
+class CountingVisitor : public hls::ASTVisitor {
+ public:
+  void number_expr(hls::NumberExprAST&) override { ++count_; }
+  void variable_expr(hls::VariableExprAST&) override { ++count_; }
+  void binary_expr(hls::BinaryExprAST& ast) override {
+    ++count_;
+    ast.lhs()->accept(*this);
+    ast.rhs()->accept(*this);
+  }
+  void if_expr(hls::IfExprAST&) override {}
+  void for_expr(hls::ForExprAST&) override {}
+  void call_expr(hls::CallExprAST& ast) override {
+    ++count_;
+    for (std::size_t idx = 0; idx < ast.arg_count(); ++idx)
+      ast.arg(idx)->accept(*this);
+  }
+  void prototype(hls::PrototypeAST&) override {}
+  void function(hls::FunctionAST&) override {}
+
+  std::size_t count_ = 0;
+  // Root of the expression being traversed
+  std::shared_ptr<hls::ExprAST> root_;
+};
+
+/**
+ * @brief Visitor that counts the nodes in an expression, taking a reference-
+ * counted copy of each child the way the by-value accessors used to.
+ */
+class CopyingVisitor : public CountingVisitor {
+ public:
+  void binary_expr(hls::BinaryExprAST& ast) override {
+    ++count_;
+    std::shared_ptr<hls::ExprAST> lhs(root_, ast.lhs()), rhs(root_, ast.rhs());
+    lhs->accept(*this);
+    rhs->accept(*this);
+  }
+  void call_expr(hls::CallExprAST& ast) override {
+    ++count_;
+    std::vector<std::shared_ptr<hls::ExprAST>> args;
+    for (std::size_t idx = 0; idx < ast.arg_count(); ++idx)
+      args.emplace_back(root_, ast.arg(idx));
+    for (auto arg : args) arg->accept(*this);
+  }
+};
+
+/**
+ * @brief Traverse a call-heavy expression with the given visitor.
+ */
+template <typename Visitor>
+static void traverse_calls(benchmark::State& state) {
+  auto expr = call_tree(4, static_cast<int>(state.range(0)));
+  std::size_t nodes = 0;
+  for (auto _ : state) {
+    Visitor visitor;
+    visitor.root_ = expr;
+    expr->accept(visitor);
+    nodes = visitor.count_;
+    benchmark::DoNotOptimize(nodes);
+  }
+  state.SetItemsProcessed(state.iterations() * nodes);
+}
+
+BENCHMARK(traverse_calls<CopyingVisitor>)
+    ->Name("TraverseCallsCopying")
+    ->DenseRange(4, 8, 2);
+BENCHMARK(traverse_calls<CountingVisitor>)
+    ->Name("TraverseCallsByReference")
+    ->DenseRange(4, 8, 2);
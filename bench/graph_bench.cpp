@@ -0,0 +1,220 @@
+/**
+ * @file graph_bench.cpp
+ * @author Salvatore Cardamone
+ * @brief Benchmarks for solving large systems of scheduling constraints and
+ * for finding shortest paths in large graphs.
+ */
+// clang-format off
+#include <benchmark/benchmark.h>
+
+#include <map>
+#include <memory>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "hls/constraint_graph.hpp"
+#include "hls/constraint_solver.hpp"
+#include "hls/csr_graph.hpp"
+#include "hls/graph.hpp"
+#include "hls/graph_visitor.hpp"
+#include "hls/thread_pool.hpp"
+// clang-format on
+
+/**
+ * @brief Generate the constraints of a schedule shaped like a data-flow
+ * graph: each operation comes some cycles after a couple of earlier ones, and
+ * within a generous window of one of them.
+ * @param operations Number of operations, each a variable.
+ * @param seed Seed for the random choices.
+ * @return The constraints; three per operation but the first.
+ */
+static std::vector<hls::ConstraintExpr> schedule(int operations,
+                                                 unsigned seed) {
+  std::mt19937 random(seed);
+  std::vector<hls::ConstraintExpr> constraints;
+  for (int op = 1; op < operations; ++op) {
+    std::uniform_int_distribution<int> earlier(std::max(0, op - 64), op - 1);
+    const std::string name = "x" + std::to_string(op);
+    for (int input = 0; input < 2; ++input) {
+      constraints.emplace_back("x" + std::to_string(earlier(random)), name,
+                               -static_cast<int>(random() % 4));
+    }
+    constraints.emplace_back(name, "x" + std::to_string(earlier(random)),
+                             4 * 64);
+  }
+  return constraints;
+}
+
+/**
+ * @brief Add and then remove a single constraint in a large schedule, as a
+ * scheduler exploring alternatives would.
+ */
+static void incremental_edit(benchmark::State& state) {
+  const int operations = static_cast<int>(state.range(0));
+  // Add the last operations first, so that each new variable has only to be
+  // placed before those already scheduled, rather than pushing them all back
+  hls::IncrementalConstraintSolver solver;
+  auto constraints = schedule(operations, 1);
+  for (auto constraint = constraints.rbegin(); constraint != constraints.rend();
+       ++constraint) {
+    solver.add_constraint(*constraint);
+  }
+  auto edits = schedule(operations, 2);
+  std::size_t next = 0;
+  for (auto _ : state) {
+    const auto& edit = edits[next++ % edits.size()];
+    if (solver.add_constraint(edit)) solver.remove_constraint(edit);
+  }
+  state.counters["Constraints"] = static_cast<double>(solver.size());
+  state.SetItemsProcessed(state.iterations());
+}
+
+/**
+ * @brief Solve a large schedule from scratch, as every edit would need
+ * without the incremental solver.
+ */
+static void solve_from_scratch(benchmark::State& state) {
+  hls::ConstraintGraph graph;
+  for (const auto& constraint :
+       schedule(static_cast<int>(state.range(0)), 1)) {
+    graph.add_constraint(constraint);
+  }
+  for (auto _ : state) {
+    hls::GraphBellmanFord solver;
+    graph.accept(solver);
+    benchmark::DoNotOptimize(solver.feasible());
+  }
+  state.SetItemsProcessed(state.iterations());
+}
+
+BENCHMARK(incremental_edit)
+    ->Name("IncrementalEdit")
+    ->RangeMultiplier(10)
+    ->Range(1000, 100000);
+BENCHMARK(solve_from_scratch)
+    ->Name("SolveFromScratch")
+    ->RangeMultiplier(10)
+    ->Range(1000, 100000)
+    ->Unit(benchmark::kMillisecond);
+
+/**
+ * @brief Generate a random graph with non-negative weights.
+ * @param vertices Number of vertices.
+ * @param degree Number of edges out of each vertex.
+ * @param seed Seed for the random choices.
+ * @return The graph.
+ */
+static hls::Graph random_graph(int vertices, int degree, unsigned seed) {
+  std::mt19937 random(seed);
+  std::vector<std::shared_ptr<hls::Vertex>> v;
+  hls::Graph graph;
+  for (int i = 0; i < vertices; ++i) {
+    v.push_back(std::make_shared<hls::Vertex>());
+    graph.add_vertex(v.back());
+  }
+  // Only join each vertex to those after it, so that no edge is repeated or
+  // doubles back
+  for (int i = 0; i + 1 < vertices; ++i) {
+    const int span = vertices - i - 1;
+    for (int edge = 0; edge < std::min(degree, span); ++edge) {
+      int j = i + 1 + (span * edge) / std::min(degree, span) +
+              static_cast<int>(random() % std::max(1, span / degree));
+      graph.add_edge(v[i], v[std::min(j, vertices - 1)],
+                     static_cast<int>(random() % 100));
+    }
+  }
+  return graph;
+}
+
+/**
+ * @brief Find the shortest paths between every pair of vertices of a random
+ * graph of the given size and degree, with the given algorithm, on the given
+ * number of threads.
+ */
+template <hls::GraphAllPairs::Method Method>
+static void all_pairs(benchmark::State& state) {
+  hls::CSRGraph graph(random_graph(static_cast<int>(state.range(0)),
+                                   static_cast<int>(state.range(1)), 3));
+  hls::GraphAllPairs paths(Method, static_cast<unsigned>(state.range(2)));
+  for (auto _ : state) {
+    graph.accept(paths);
+    benchmark::DoNotOptimize(paths.matrix().data());
+  }
+  state.counters["Edges"] = static_cast<double>(graph.num_edges());
+  state.SetItemsProcessed(state.iterations() * state.range(0) *
+                          state.range(0));
+}
+
+BENCHMARK(all_pairs<hls::GraphAllPairs::Method::floyd_warshall>)
+    ->Name("AllPairsFloydWarshall")
+    ->ArgsProduct({{256, 1024}, {4, 64}, {1, 2, 4, 8}})
+    ->UseRealTime()
+    ->Unit(benchmark::kMillisecond);
+BENCHMARK(all_pairs<hls::GraphAllPairs::Method::johnson>)
+    ->Name("AllPairsJohnson")
+    ->ArgsProduct({{256, 1024}, {4, 64}, {1, 2, 4, 8}})
+    ->UseRealTime()
+    ->Unit(benchmark::kMillisecond);
+
+/**
+ * @brief Compressed random graph of the given size, with a vertex at the end
+ * that nothing reaches, built once and shared between benchmarks.
+ * @param vertices Number of vertices, besides the one nothing reaches.
+ * @return The graph.
+ */
+static const hls::CSRGraph& large_graph(int vertices) {
+  static std::map<int, std::unique_ptr<hls::CSRGraph>> graphs;
+  auto& graph = graphs[vertices];
+  if (!graph) {
+    auto random = random_graph(vertices, 8, 4);
+    random.add_vertex(std::make_shared<hls::Vertex>());
+    graph = std::make_unique<hls::CSRGraph>(random);
+  }
+  return *graph;
+}
+
+/**
+ * @brief Find the shortest paths from one vertex to every other with
+ * Dijkstra's algorithm, on a single thread. Searching for the vertex that
+ * nothing reaches makes the search visit everything.
+ */
+static void sequential_dijkstra(benchmark::State& state) {
+  const auto& graph = large_graph(static_cast<int>(state.range(0)));
+  const auto unreachable = static_cast<hls::CSRGraph::vertex_id>(
+      graph.num_vertices() - 1);
+  for (auto _ : state) {
+    hls::GraphShortestPath path(graph.vertex(0), graph.vertex(unreachable));
+    graph.accept(path);
+    benchmark::DoNotOptimize(path.path_length());
+  }
+  state.SetItemsProcessed(state.iterations() * graph.num_edges());
+}
+
+/**
+ * @brief Find the shortest paths from one vertex to every other by
+ * delta-stepping, on the given number of threads.
+ */
+static void delta_stepping(benchmark::State& state) {
+  const auto& graph = large_graph(static_cast<int>(state.range(0)));
+  // Threads are started once, as a caller searching many times would
+  hls::ThreadPool pool(static_cast<unsigned>(state.range(1)));
+  for (auto _ : state) {
+    hls::GraphDeltaStepping paths(pool, graph.vertex(0));
+    graph.accept(paths);
+    benchmark::DoNotOptimize(paths.distances().data());
+  }
+  state.counters["Threads"] = static_cast<double>(pool.size());
+  state.SetItemsProcessed(state.iterations() * graph.num_edges());
+}
+
+BENCHMARK(sequential_dijkstra)
+    ->Name("SSSPDijkstra")
+    ->RangeMultiplier(10)
+    ->Range(10000, 1000000)
+    ->Unit(benchmark::kMillisecond);
+BENCHMARK(delta_stepping)
+    ->Name("SSSPDeltaStepping")
+    ->ArgsProduct({{10000, 100000, 1000000}, {1, 2, 4, 8}})
+    ->UseRealTime()
+    ->Unit(benchmark::kMillisecond);
@@ -0,0 +1,108 @@
+/**
+ * @file lexer_bench.cpp
+ * @author Salvatore Cardamone
+ * @brief Microbenchmarks for the Kaleidoscope lexer.
+ */
+// clang-format off
+#include <benchmark/benchmark.h>
+
+#include <sstream>
+#include <string>
+
+#include "hls/lexer.hpp"
+#include "hls/scan.hpp"
+// clang-format on
+
+/**
+ * @brief Generate a synthetic source resembling our machine-generated
+ * kernels; comment banners, deep indentation and long identifiers.
+ * @param functions Number of function definitions to generate.
+ * @return The generated source.
+ */
+static std::string generate_source(int functions) {
+  std::string source;
+  for (int idx = 0; idx < functions; ++idx) {
+    source += "#########################################################\n";
+    source += "# Generated datapath kernel number " + std::to_string(idx) +
+              "                     #\n";
+    source += "#########################################################\n";
+    source += "def datapath_kernel_" + std::to_string(idx) +
+              "(input_stream_value accumulator_register)\n";
+    source += "                accumulator_register_intermediate_value_" +
+              std::to_string(idx) + " * 2.5\n";
+    source += "                    + input_stream_value_after_scaling\n\n";
+  }
+  return source;
+}
+
+static const std::string source = generate_source(1000);
+
+// ==========================================================================
+//                        CHARACTER-CLASS SCANNING
+// ==========================================================================
+
+/**
+ * @brief Walk the entire source, alternating between the three character
+ * classes the lexer skips over, using the given scanning functions.
+ */
+template <auto SkipSpace, auto SkipIdentifier, auto FindLineEnd>
+static void scan_source(benchmark::State& state) {
+  const char* data = source.data();
+  const std::size_t size = source.size();
+  for (auto _ : state) {
+    std::size_t pos = 0, classes = 0;
+    while (pos < size) {
+      pos = SkipSpace(data, pos, size);
+      if (pos >= size) break;
+      if (data[pos] == '#') {
+        pos = FindLineEnd(data, pos, size);
+      } else if (hls::scan::is_identifier(data[pos])) {
+        pos = SkipIdentifier(data, pos, size);
+      } else {
+        ++pos;
+      }
+      ++classes;
+    }
+    benchmark::DoNotOptimize(classes);
+  }
+  state.SetBytesProcessed(state.iterations() * size);
+}
+
+BENCHMARK(scan_source<hls::scan::skip_whitespace_scalar,
+                      hls::scan::skip_identifier_scalar,
+                      hls::scan::find_line_end_scalar>)
+    ->Name("ScanScalar");
+BENCHMARK(scan_source<hls::scan::skip_whitespace, hls::scan::skip_identifier,
+                      hls::scan::find_line_end>)
+    ->Name("ScanVectorised");
+
+// ==========================================================================
+//                              FULL LEXING
+// ==========================================================================
+
+/**
+ * @brief Lex the entire source through an input stream.
+ */
+static void LexStream(benchmark::State& state) {
+  for (auto _ : state) {
+    std::stringstream input(source);
+    hls::Lexer lexer(input);
+    while (lexer.get_token().type() != hls::TokenType::tok_eof) {
+    }
+  }
+  state.SetBytesProcessed(state.iterations() * source.size());
+}
+BENCHMARK(LexStream);
+
+/**
+ * @brief Lex the entire source from a contiguous buffer.
+ */
+static void LexBuffer(benchmark::State& state) {
+  for (auto _ : state) {
+    hls::Lexer lexer(source);
+    while (lexer.get_token().type() != hls::TokenType::tok_eof) {
+    }
+  }
+  state.SetBytesProcessed(state.iterations() * source.size());
+}
+BENCHMARK(LexBuffer);
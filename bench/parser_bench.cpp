@@ -0,0 +1,132 @@
+/**
+ * @file parser_bench.cpp
+ * @author Salvatore Cardamone
+ * @brief Stress benchmarks for parsing very deep and very long expressions.
+ */
+// clang-format off
+#include <benchmark/benchmark.h>
+
+#include <memory>
+#include <string>
+
+#include "hls/arena.hpp"
+#include "hls/ast.hpp"
+#include "hls/ast_factory.hpp"
+#include "hls/lexer.hpp"
+#include "hls/parser.hpp"
+#include "hls/source_manager.hpp"
+// clang-format on
+
+/**
+ * @brief Generate a reduction over the given number of terms, written as one
+ * long flat sum.
+ * @param terms Number of terms.
+ * @return The generated source.
+ */
+static std::string long_sum(int terms) {
+  std::string source = "x0";
+  for (int idx = 1; idx < terms; ++idx)
+    source += " + x" + std::to_string(idx % 100) + " * 2";
+  return source + "\n";
+}
+
+/**
+ * @brief Generate a reduction over the given number of terms, written as a
+ * fully-parenthesised chain, e.g. (x + (x + (x + x))).
+ * @param terms Number of terms.
+ * @return The generated source.
+ */
+static std::string deep_sum(int terms) {
+  std::string source;
+  for (int idx = 1; idx < terms; ++idx)
+    source += "(x" + std::to_string(idx % 100) + " + ";
+  return source + "x0" + std::string(terms - 1, ')') + "\n";
+}
+
+/**
+ * @brief Generate a balanced reduction tree over the given number of terms,
+ * the way our reduction generators emit them.
+ * @param terms Number of terms.
+ * @return The generated source.
+ */
+static std::string tree_sum(int terms) {
+  if (terms == 1) return "x" + std::to_string(terms % 100);
+  return "(" + tree_sum(terms / 2) + " + " + tree_sum(terms - terms / 2) + ")";
+}
+
+/**
+ * @brief Parse an expression from the generator as a top-level expression.
+ */
+template <std::string (*Generate)(int)>
+static void parse_expression(benchmark::State& state) {
+  const std::string source = Generate(static_cast<int>(state.range(0)));
+  for (auto _ : state) {
+    // Freeing the tree, which happens within the loop too, doesn't recurse
+    // either
+    hls::Lexer lexer(source);
+    hls::Parser parser(lexer);
+    benchmark::DoNotOptimize(parser.step());
+  }
+  state.SetItemsProcessed(state.iterations() * state.range(0));
+  state.SetBytesProcessed(state.iterations() * source.size());
+}
+
+BENCHMARK(parse_expression<long_sum>)
+    ->Name("ParseLongSum")
+    ->RangeMultiplier(10)
+    ->Range(100, 1000000);
+BENCHMARK(parse_expression<deep_sum>)
+    ->Name("ParseDeepSum")
+    ->RangeMultiplier(10)
+    ->Range(100, 1000000);
+BENCHMARK(parse_expression<tree_sum>)
+    ->Name("ParseTreeSum")
+    ->RangeMultiplier(10)
+    ->Range(100, 1000000);
+
+/**
+ * @brief An AST node as it was before nodes recorded their SourceOffset.
+ */
+struct UnlocatedAST {
+  virtual ~UnlocatedAST() {}
+  hls::ASTKind kind;
+};
+
+/**
+ * @brief Parse a long sum, with or without its source registered with a
+ * SourceManager, and report how much memory the AST takes per node along with
+ * how much of that is down to recording the nodes' locations.
+ */
+template <bool Located>
+static void parse_located(benchmark::State& state) {
+  const int terms = static_cast<int>(state.range(0));
+  const std::string source = long_sum(terms);
+  hls::SourceManager sources;
+  const hls::SourceOffset base =
+      Located ? sources.add("sum.k", source) : hls::no_offset;
+  std::size_t bytes = 0;
+  for (auto _ : state) {
+    auto arena = std::make_shared<hls::Arena>();
+    hls::Lexer lexer(source, nullptr, nullptr, base);
+    hls::Parser parser(lexer, hls::ASTFactory(arena));
+    benchmark::DoNotOptimize(parser.step());
+    bytes = arena->bytes_allocated();
+  }
+  // Every term but the first adds a variable, a number, a product and a sum;
+  // the first is a variable, and the whole is wrapped in a prototype and a
+  // function
+  const double nodes = 4.0 * (terms - 1) + 3;
+  state.counters["BytesPerNode"] = bytes / nodes;
+  state.counters["LocationBytesPerNode"] =
+      static_cast<double>(sizeof(hls::AST)) - sizeof(UnlocatedAST);
+  state.SetItemsProcessed(state.iterations() * nodes);
+}
+
+BENCHMARK(parse_located<false>)
+    ->Name("ParseUnlocated")
+    ->RangeMultiplier(10)
+    ->Range(1000, 100000);
+BENCHMARK(parse_located<true>)
+    ->Name("ParseLocated")
+    ->RangeMultiplier(10)
+    ->Range(1000, 100000);
@@ -0,0 +1,123 @@
+/**
+ * @file arena.hpp
+ * @author Salvatore Cardamone
+ * @brief Bump allocator for objects sharing a single lifetime.
+ */
+#ifndef __HLS_ARENA_HPP
+#define __HLS_ARENA_HPP
+
+#include <algorithm>
+#include <cstddef>
+#include <memory>
+#include <new>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+namespace hls {
+
+/**
+ * @brief Bump allocator. Objects are laid out contiguously in large blocks and
+ * are all released together when the Arena is reset or destroyed, rather than
+ * individually.
+ *
+ * Destructors of non-trivially destructible objects are still run (in reverse
+ * order of construction), but no memory is returned to the heap until the
+ * whole Arena goes.
+ */
+class Arena {
+ public:
+  /**
+   * @brief Class constructor.
+   * @param block_size Size of the blocks requested from the heap. Allocations
+   * larger than this get a block to themselves.
+   */
+  Arena(std::size_t block_size = 64 * 1024) : block_size_{block_size} {}
+
+  /**
+   * @brief Class destructor. Destroys everything allocated in the Arena.
+   */
+  ~Arena() { reset(); }
+
+  // Objects in the Arena are referred to by address, so it can't be copied
+  Arena(const Arena&) = delete;
+  Arena& operator=(const Arena&) = delete;
+
+  /**
+   * @brief Allocate uninitialised memory from the Arena.
+   * @param size Number of bytes to allocate.
+   * @param alignment Required alignment of the allocation.
+   * @return Pointer to the allocation.
+   */
+  void* allocate(std::size_t size, std::size_t alignment) {
+    std::size_t space = static_cast<std::size_t>(end_ - cursor_);
+    void* ptr = cursor_;
+    if (!cursor_ || !std::align(alignment, size, ptr, space)) {
+      // Doesn't fit in what's left of the current block, so start a new one
+      std::size_t block_size = std::max(block_size_, size + alignment);
+      // Not make_unique, which would zero the block for no reason
+      blocks_.emplace_back(new std::byte[block_size]);
+      cursor_ = blocks_.back().get();
+      end_ = cursor_ + block_size;
+      space = block_size;
+      ptr = cursor_;
+      std::align(alignment, size, ptr, space);
+    }
+    cursor_ = static_cast<std::byte*>(ptr) + size;
+    bytes_allocated_ += size;
+    return ptr;
+  }
+
+  /**
+   * @brief Construct an object in the Arena.
+   * @param args Arguments forwarded to the object's constructor.
+   * @return Pointer to the object, which lives until the Arena is reset or
+   * destroyed.
+   */
+  template <typename T, typename... Args>
+  T* create(Args&&... args) {
+    T* object =
+        new (allocate(sizeof(T), alignof(T))) T(std::forward<Args>(args)...);
+    if constexpr (!std::is_trivially_destructible_v<T>) {
+      destructors_.push_back(
+          {object, [](void* ptr) { static_cast<T*>(ptr)->~T(); }});
+    }
+    return object;
+  }
+
+  /**
+   * @brief Destroy every object in the Arena and release its memory.
+   */
+  void reset() {
+    for (auto it = destructors_.rbegin(); it != destructors_.rend(); ++it)
+      it->second(it->first);
+    destructors_.clear();
+    blocks_.clear();
+    cursor_ = end_ = nullptr;
+    bytes_allocated_ = 0;
+  }
+
+  /**
+   * @brief Getter for the number of bytes handed out by the Arena.
+   * @return Bytes allocated since construction or the last reset.
+   */
+  std::size_t bytes_allocated() const { return bytes_allocated_; }
+
+  /**
+   * @brief Getter for the number of blocks requested from the heap.
+   * @return Number of blocks.
+   */
+  std::size_t blocks() const { return blocks_.size(); }
+
+ private:
+  std::size_t block_size_;
+  std::vector<std::unique_ptr<std::byte[]>> blocks_;
+  std::byte* cursor_ = nullptr;
+  std::byte* end_ = nullptr;
+  std::size_t bytes_allocated_ = 0;
+  std::vector<std::pair<void*, void (*)(void*)>> destructors_;
+};
+
+}  // namespace hls
+
+#endif /* #ifndef __HLS_ARENA_HPP */
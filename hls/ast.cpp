@@ -0,0 +1,238 @@
+/**
+ * @file ast.cpp
+ * @author Salvatore Cardamone
+ * @brief Structural comparison, hashing and destruction of AST nodes.
+ *
+ * Each of these walks the trees with an explicit stack rather than recursing,
+ * so they're safe on the very deep trees that machine-generated code produces.
+ */
+#include "ast.hpp"
+
+#include <cstring>
+#include <memory>
+#include <utility>
+#include <vector>
+
+namespace hls {
+
+namespace {
+
+// Children released by nodes being destroyed on this thread, and not yet
+// freed themselves; and whether a call further up the stack is freeing them
+thread_local std::vector<std::shared_ptr<ExprAST>> released;
+thread_local bool releasing = false;
+
+}  // namespace
+
+void release_child(std::shared_ptr<ExprAST>& child) {
+  if (!child) return;
+  released.push_back(std::move(child));
+  if (releasing) return;
+
+  // Freeing a child runs its destructor, which just adds the grandchildren to
+  // the list for this loop to free in turn
+  releasing = true;
+  while (!released.empty()) {
+    auto next = std::move(released.back());
+    released.pop_back();
+    next.reset();
+  }
+  releasing = false;
+}
+
+bool structural_equal(const AST& lhs, const AST& rhs) {
+  std::vector<std::pair<const AST*, const AST*>> stack{{&lhs, &rhs}};
+
+  while (!stack.empty()) {
+    auto [a, b] = stack.back();
+    stack.pop_back();
+
+    // Shared subtrees are trivially equal to themselves
+    if (a == b) continue;
+    // Optional children (e.g. the for-loop step) need to be absent in both
+    if (!a || !b) return false;
+    if (a->kind() != b->kind()) return false;
+
+    // Kinds match, so static casts are safe; compare the node contents and
+    // queue up the children for comparison
+    switch (a->kind()) {
+      case ASTKind::number_expr: {
+        if (static_cast<const NumberExprAST*>(a)->value() !=
+            static_cast<const NumberExprAST*>(b)->value())
+          return false;
+        break;
+      }
+      case ASTKind::variable_expr: {
+        if (static_cast<const VariableExprAST*>(a)->name() !=
+            static_cast<const VariableExprAST*>(b)->name())
+          return false;
+        break;
+      }
+      case ASTKind::binary_expr: {
+        auto* x = static_cast<const BinaryExprAST*>(a);
+        auto* y = static_cast<const BinaryExprAST*>(b);
+        if (x->op() != y->op()) return false;
+        stack.emplace_back(x->rhs(), y->rhs());
+        stack.emplace_back(x->lhs(), y->lhs());
+        break;
+      }
+      case ASTKind::if_expr: {
+        auto* x = static_cast<const IfExprAST*>(a);
+        auto* y = static_cast<const IfExprAST*>(b);
+        stack.emplace_back(x->else_expr(), y->else_expr());
+        stack.emplace_back(x->then_expr(), y->then_expr());
+        stack.emplace_back(x->cond(), y->cond());
+        break;
+      }
+      case ASTKind::for_expr: {
+        auto* x = static_cast<const ForExprAST*>(a);
+        auto* y = static_cast<const ForExprAST*>(b);
+        if (x->loop_var() != y->loop_var()) return false;
+        stack.emplace_back(x->body_expr(), y->body_expr());
+        stack.emplace_back(x->step_expr(), y->step_expr());
+        stack.emplace_back(x->end_expr(), y->end_expr());
+        stack.emplace_back(x->start_expr(), y->start_expr());
+        break;
+      }
+      case ASTKind::call_expr: {
+        auto* x = static_cast<const CallExprAST*>(a);
+        auto* y = static_cast<const CallExprAST*>(b);
+        if (x->callee() != y->callee()) return false;
+        if (x->arg_count() != y->arg_count()) return false;
+        for (std::size_t idx = x->arg_count(); idx-- > 0;)
+          stack.emplace_back(x->arg(idx), y->arg(idx));
+        break;
+      }
+      case ASTKind::prototype: {
+        auto* x = static_cast<const PrototypeAST*>(a);
+        auto* y = static_cast<const PrototypeAST*>(b);
+        if (x->name() != y->name() || x->args() != y->args()) return false;
+        break;
+      }
+      case ASTKind::function: {
+        auto* x = static_cast<const FunctionAST*>(a);
+        auto* y = static_cast<const FunctionAST*>(b);
+        stack.emplace_back(x->body(), y->body());
+        stack.emplace_back(x->proto(), y->proto());
+        break;
+      }
+    }
+  }
+  return true;
+}
+
+namespace {
+
+/**
+ * @brief 64-bit FNV-1a hash accumulator. Unlike std::hash, the result is
+ * specified, so hashes are stable across runs and standard libraries.
+ */
+class FNV1a {
+ public:
+  void bytes(const void* data, std::size_t size) {
+    auto* ptr = static_cast<const unsigned char*>(data);
+    for (std::size_t idx = 0; idx < size; ++idx) {
+      hash_ ^= ptr[idx];
+      hash_ *= 0x100000001b3ull;
+    }
+  }
+
+  void integer(std::uint64_t value) { bytes(&value, sizeof(value)); }
+
+  // Length-prefixed so that adjacent strings can't alias one another
+  void string(const std::string& value) {
+    integer(value.size());
+    bytes(value.data(), value.size());
+  }
+
+  void real(double value) {
+    // -0.0 == 0.0, so they need to hash identically
+    if (value == 0.0) value = 0.0;
+    std::uint64_t bits;
+    std::memcpy(&bits, &value, sizeof(bits));
+    integer(bits);
+  }
+
+  std::uint64_t value() const { return hash_; }
+
+ private:
+  std::uint64_t hash_ = 0xcbf29ce484222325ull;
+};
+
+}  // namespace
+
+std::uint64_t structural_hash(const AST& ast) {
+  FNV1a hash;
+  std::vector<const AST*> stack{&ast};
+
+  // Pre-order walk; every node contributes its kind and contents, and absent
+  // optional children contribute a marker, so the encoding is unambiguous
+  while (!stack.empty()) {
+    const AST* node = stack.back();
+    stack.pop_back();
+
+    if (!node) {
+      hash.integer(0xFF);
+      continue;
+    }
+    hash.integer(static_cast<std::uint64_t>(node->kind()));
+
+    switch (node->kind()) {
+      case ASTKind::number_expr: {
+        hash.real(static_cast<const NumberExprAST*>(node)->value());
+        break;
+      }
+      case ASTKind::variable_expr: {
+        hash.string(static_cast<const VariableExprAST*>(node)->name());
+        break;
+      }
+      case ASTKind::binary_expr: {
+        auto* x = static_cast<const BinaryExprAST*>(node);
+        hash.integer(static_cast<unsigned char>(x->op()));
+        stack.push_back(x->rhs());
+        stack.push_back(x->lhs());
+        break;
+      }
+      case ASTKind::if_expr: {
+        auto* x = static_cast<const IfExprAST*>(node);
+        stack.push_back(x->else_expr());
+        stack.push_back(x->then_expr());
+        stack.push_back(x->cond());
+        break;
+      }
+      case ASTKind::for_expr: {
+        auto* x = static_cast<const ForExprAST*>(node);
+        hash.string(x->loop_var());
+        stack.push_back(x->body_expr());
+        stack.push_back(x->step_expr());
+        stack.push_back(x->end_expr());
+        stack.push_back(x->start_expr());
+        break;
+      }
+      case ASTKind::call_expr: {
+        auto* x = static_cast<const CallExprAST*>(node);
+        hash.string(x->callee());
+        hash.integer(x->arg_count());
+        for (std::size_t idx = x->arg_count(); idx-- > 0;)
+          stack.push_back(x->arg(idx));
+        break;
+      }
+      case ASTKind::prototype: {
+        auto* x = static_cast<const PrototypeAST*>(node);
+        hash.string(x->name());
+        hash.integer(x->args().size());
+        for (const auto& arg : x->args()) hash.string(arg);
+        break;
+      }
+      case ASTKind::function: {
+        auto* x = static_cast<const FunctionAST*>(node);
+        stack.push_back(x->body());
+        stack.push_back(x->proto());
+        break;
+      }
+    }
+  }
+  return hash.value();
+}
+
+}  // namespace hls
@@ -6,18 +6,67 @@
 #ifndef __HLS_AST_HPP
 #define __HLS_AST_HPP
 
+#include <cstdint>
 #include <memory>
 #include <ostream>
 #include <string>
 #include <vector>
 
 #include "ast_visitor.hpp"
+#include "source_manager.hpp"
 
 namespace hls {
 
+/**
+ * @brief Tag identifying the concrete type of an AST node, so that nodes can be
+ * discriminated without RTTI.
+ */
+enum class ASTKind : std::uint8_t {
+  number_expr,
+  variable_expr,
+  binary_expr,
+  if_expr,
+  for_expr,
+  call_expr,
+  prototype,
+  function
+};
+
+class AST;
+
+/**
+ * @brief Structural equality of two ASTs; the node kinds, contents and
+ * children of both trees are identical. Evaluated iteratively, so is safe on
+ * arbitrarily deep trees.
+ * @param lhs The first AST.
+ * @param rhs The second AST.
+ * @return True if the ASTs are structurally equal, false otherwise.
+ */
+bool structural_equal(const AST& lhs, const AST& rhs);
+
+/**
+ * @brief Structural hash of an AST, consistent with structural_equal. The hash
+ * is deterministic across runs and platforms, so can be persisted.
+ * @param ast The AST to hash.
+ * @return Hash of the AST.
+ */
+std::uint64_t structural_hash(const AST& ast);
+
 /**
  * @brief Base class for all AST types allowing us to specify a common interface
  * for expression ASTs *as well as* prototype and function ASTs.
+ *
+ * Every node records the SourceOffset it was parsed from, which sits in the
+ * padding after the node kind, so locating nodes doesn't make them any bigger.
+ * The offset isn't part of the node's structure; nodes parsed from different
+ * places can still be structurally equal.
+ *
+ * Nodes on the heap own their children, whereas nodes in an Arena are all
+ * owned by the Arena and link to their children by nothing more than a
+ * pointer (see ASTFactory). Either way, children are handed out as plain
+ * pointers, which are valid for as long as the root of the AST is held. To
+ * hold onto a child by itself, alias the root, e.g.
+ * std::shared_ptr<ExprAST>(function, function->body()).
  */
 class AST {
  public:
@@ -43,9 +92,42 @@ class AST {
   virtual void accept(ASTVisitor& visitor) = 0;
 
   /**
-   * @brief Operator overload for equality of AST objects.
+   * @brief Getter for the kind of AST node.
+   * @return The node kind.
+   */
+  ASTKind kind() const { return kind_; }
+
+  /**
+   * @brief Getter for where the node was parsed from; the first token of
+   * the construct, or for binary expressions the operator.
+   * @return Offset in the SourceManager, or no_offset if the node's source
+   * wasn't registered with one.
+   */
+  SourceOffset offset() const { return offset_; }
+
+  /**
+   * @brief Record where the node was parsed from.
+   * @param offset Offset in the SourceManager.
+   */
+  void set_offset(SourceOffset offset) { offset_ = offset; }
+
+  /**
+   * @brief Operator overload for structural equality of AST objects.
+   * @param rhs The RHS of the equality condition.
+   * @return True if equal, false otherwise.
+   */
+  bool operator==(const AST& rhs) const { return structural_equal(*this, rhs); }
+
+ protected:
+  /**
+   * @brief Class constructor.
+   * @param kind The kind of the derived node.
    */
-  virtual bool operator==(const AST& rhs) const = 0;
+  AST(ASTKind kind) : kind_{kind} {}
+
+ private:
+  ASTKind kind_;
+  SourceOffset offset_ = no_offset;
 };
 
 /**
@@ -62,7 +144,20 @@ static std::ostream& operator<<(std::ostream& os, const AST& ast) {
 /**
  * @brief Base class for all expression AST nodes.
  */
-class ExprAST : public AST {};
+class ExprAST : public AST {
+ protected:
+  using AST::AST;
+};
+
+/**
+ * @brief Release a child of an expression node that's being destroyed. If this
+ * was the last reference to the child, it's destroyed only once the outermost
+ * node being destroyed on this thread is done with, rather than from within
+ * its parent's destructor, so freeing an arbitrarily deep AST takes constant
+ * native stack.
+ * @param child The child; left empty.
+ */
+void release_child(std::shared_ptr<ExprAST>& child);
 
 /**
  * @brief Numerical expression AST node for numeric literals.
@@ -72,13 +167,14 @@ class NumberExprAST : public ExprAST {
   /**
    * @brief Default constructor.
    */
-  NumberExprAST() : val_{0} {}
+  NumberExprAST() : ExprAST{ASTKind::number_expr}, val_{0} {}
 
   /**
    * @brief Class constructor.
    * @param val The numeric value to initialise the expression with.
    */
-  NumberExprAST(const double& val) : val_{val} {}
+  NumberExprAST(const double& val)
+      : ExprAST{ASTKind::number_expr}, val_{val} {}
 
   /**
    * @brief Getter for the underying value.
@@ -101,20 +197,6 @@ class NumberExprAST : public ExprAST {
    */
   void accept(ASTVisitor& visitor) override { visitor.number_expr(*this); }
 
-  /**
-   * @brief Equality overload.
-   * @param rhs The RHS of the equality condition. If the LHS and RHS aren't
-   * of the same type, then we catch the resultant exception and return false.
-   * @return True if equal, false otherwise.
-   */
-  bool operator==(const AST& rhs) const override {
-    try {
-      return val_ == dynamic_cast<const NumberExprAST&>(rhs).val_;
-    } catch (std::bad_cast&) {
-      return false;
-    }
-  }
-
  private:
   double val_;
 };
@@ -127,19 +209,20 @@ class VariableExprAST : public ExprAST {
   /**
    * @brief Default constructor.
    */
-  VariableExprAST() : name_{""} {}
+  VariableExprAST() : ExprAST{ASTKind::variable_expr}, name_{""} {}
 
   /**
    * @brief Class constructor.
    * @param name Name of the variable.
    */
-  VariableExprAST(const std::string& name) : name_{name} {}
+  VariableExprAST(const std::string& name)
+      : ExprAST{ASTKind::variable_expr}, name_{name} {}
 
   /**
    * @brief Getter for the underying name.
    * @return AST name.
    */
-  std::string name() const { return name_; }
+  const std::string& name() const { return name_; }
 
   /**
    * @brief Overload of the string representation method for the object.
@@ -156,20 +239,6 @@ class VariableExprAST : public ExprAST {
    */
   void accept(ASTVisitor& visitor) override { visitor.variable_expr(*this); }
 
-  /**
-   * @brief Equality overload.
-   * @param rhs The RHS of the equality condition. If the LHS and RHS aren't
-   * of the same type, then we catch the resultant exception and return false.
-   * @return True if equal, false otherwise.
-   */
-  bool operator==(const AST& rhs) const override {
-    try {
-      return name_ == dynamic_cast<const VariableExprAST&>(rhs).name_;
-    } catch (std::bad_cast&) {
-      return false;
-    }
-  }
-
  private:
   std::string name_;
 };
@@ -183,7 +252,8 @@ class BinaryExprAST : public ExprAST {
   /**
    * @brief Default constructor.
    */
-  BinaryExprAST() : op_{' '}, lhs_{nullptr}, rhs_{nullptr} {}
+  BinaryExprAST()
+      : ExprAST{ASTKind::binary_expr}, op_{' '}, lhs_{nullptr}, rhs_{nullptr} {}
 
   /**
    * @brief Class constructor.
@@ -193,7 +263,18 @@ class BinaryExprAST : public ExprAST {
    */
   BinaryExprAST(const char op, std::shared_ptr<ExprAST> lhs,
                 std::shared_ptr<ExprAST> rhs)
-      : op_{op}, lhs_{std::move(lhs)}, rhs_{std::move(rhs)} {}
+      : ExprAST{ASTKind::binary_expr},
+        op_{op},
+        lhs_{std::move(lhs)},
+        rhs_{std::move(rhs)} {}
+
+  /**
+   * @brief Class destructor. Releases the children without recursing.
+   */
+  ~BinaryExprAST() override {
+    release_child(lhs_);
+    release_child(rhs_);
+  }
 
   /**
    * @brief Getter for the underying operator.
@@ -205,13 +286,13 @@ class BinaryExprAST : public ExprAST {
    * @brief Getter for the LHS expression.
    * @return LHS expression.
    */
-  std::shared_ptr<ExprAST> lhs() const { return lhs_; }
+  ExprAST* lhs() const { return lhs_.get(); }
 
   /**
    * @brief Getter for the RHS expression.
    * @return RHS expression.
    */
-  std::shared_ptr<ExprAST> rhs() const { return rhs_; }
+  ExprAST* rhs() const { return rhs_.get(); }
 
   /**
    * @brief Overload of the string representation method for the object.
@@ -229,33 +310,6 @@ class BinaryExprAST : public ExprAST {
    */
   void accept(ASTVisitor& visitor) override { visitor.binary_expr(*this); }
 
-  /**
-   * @brief Equality overload.
-   *
-   * Attempt to cast RHS to a BinaryExprAST and perform equality check. If we
-   * get a bad cast, then the other AST isn't a BinaryExprAST, and consequently
-   * not equal to the LHS.
-   * @param rhs The RHS of the equality condition.
-   * @return True if equal, false otherwise.
-   */
-  bool operator==(const AST& rhs) const override {
-    try {
-      auto recast_rhs = dynamic_cast<const BinaryExprAST&>(rhs);
-      return *this == recast_rhs;
-    } catch (std::bad_cast&) {
-      return false;
-    }
-  }
-
-  /**
-   * @brief Equality overload for two BinaryExprAST objects.
-   * @param rhs The RHS BinaryExprAST of the equality condition.
-   * @return True if equal, false otherwise.
-   */
-  bool operator==(const BinaryExprAST& rhs) const {
-    return ((op_ == rhs.op_) && (*lhs_ == *rhs.lhs_) && (*rhs_ == *rhs.rhs_));
-  }
-
  private:
   char op_;
   std::shared_ptr<ExprAST> lhs_, rhs_;
@@ -269,7 +323,11 @@ class IfExprAST : public ExprAST {
   /**
    * @brief Empty class constructor.
    */
-  IfExprAST() : cond_{nullptr}, then_expr_{nullptr}, else_expr_{nullptr} {}
+  IfExprAST()
+      : ExprAST{ASTKind::if_expr},
+        cond_{nullptr},
+        then_expr_{nullptr},
+        else_expr_{nullptr} {}
 
   /**
    * @brief Class constructor.
@@ -279,10 +337,20 @@ class IfExprAST : public ExprAST {
    */
   IfExprAST(std::shared_ptr<ExprAST> cond, std::shared_ptr<ExprAST> then_expr,
             std::shared_ptr<ExprAST> else_expr)
-      : cond_{std::move(cond)},
+      : ExprAST{ASTKind::if_expr},
+        cond_{std::move(cond)},
         then_expr_{std::move(then_expr)},
         else_expr_{std::move(else_expr)} {}
 
+  /**
+   * @brief Class destructor. Releases the children without recursing.
+   */
+  ~IfExprAST() override {
+    release_child(cond_);
+    release_child(then_expr_);
+    release_child(else_expr_);
+  }
+
   /**
    * @brief Overload of the string representation method for the object.
    * @return String representation of the object.
@@ -296,19 +364,19 @@ class IfExprAST : public ExprAST {
    * @brief Getter for the condition expression.
    * @return Condition expression.
    */
-  std::shared_ptr<ExprAST> cond() const { return cond_; }
+  ExprAST* cond() const { return cond_.get(); }
 
   /**
    * @brief Getter for the then expression.
    * @return Then expression.
    */
-  std::shared_ptr<ExprAST> then_expr() const { return then_expr_; }
+  ExprAST* then_expr() const { return then_expr_.get(); }
 
   /**
    * @brief Getter for the else expression.
    * @return Else expression.
    */
-  std::shared_ptr<ExprAST> else_expr() const { return else_expr_; }
+  ExprAST* else_expr() const { return else_expr_.get(); }
 
   /**
    * @brief Accept an ASTVisitor instance to manipulate the IfExprAST
@@ -317,34 +385,6 @@ class IfExprAST : public ExprAST {
    */
   void accept(ASTVisitor& visitor) override { visitor.if_expr(*this); }
 
-  /**
-   * @brief Equality overload.
-   *
-   * Attempt to cast RHS to a IfExprAST and perform equality check. If we
-   * get a bad cast, then the other AST isn't a IfExprAST, and consequently
-   * not equal to the LHS.
-   * @param rhs The RHS of the equality condition.
-   * @return True if equal, false otherwise.
-   */
-  bool operator==(const AST& rhs) const override {
-    try {
-      auto recast_rhs = dynamic_cast<const IfExprAST&>(rhs);
-      return *this == recast_rhs;
-    } catch (std::bad_cast&) {
-      return false;
-    }
-  }
-
-  /**
-   * @brief Equality overload for two IfExprAST objects.
-   * @param rhs The RHS IfExprAST of the equality condition.
-   * @return True if equal, false otherwise.
-   */
-  bool operator==(const IfExprAST& rhs) const {
-    return ((*cond_ == *rhs.cond_) && (*then_expr_ == *rhs.then_expr_) &&
-            (*else_expr_ == *rhs.else_expr_));
-  }
-
  private:
   std::shared_ptr<ExprAST> cond_, then_expr_, else_expr_;
 };
@@ -358,7 +398,8 @@ class ForExprAST : public ExprAST {
    * @brief Empty class constructor.
    */
   ForExprAST()
-      : loop_var_{""},
+      : ExprAST{ASTKind::for_expr},
+        loop_var_{""},
         start_expr_{nullptr},
         end_expr_{nullptr},
         step_expr_{nullptr},
@@ -368,12 +409,23 @@ class ForExprAST : public ExprAST {
              std::shared_ptr<ExprAST> end_expr,
              std::shared_ptr<ExprAST> step_expr,
              std::shared_ptr<ExprAST> body_expr)
-      : loop_var_{loop_var},
+      : ExprAST{ASTKind::for_expr},
+        loop_var_{loop_var},
         start_expr_{std::move(start_expr)},
         end_expr_{std::move(end_expr)},
         step_expr_{std::move(step_expr)},
         body_expr_{std::move(body_expr)} {}
 
+  /**
+   * @brief Class destructor. Releases the children without recursing.
+   */
+  ~ForExprAST() override {
+    release_child(start_expr_);
+    release_child(end_expr_);
+    release_child(step_expr_);
+    release_child(body_expr_);
+  }
+
   /**
    * @brief Overload of the string representation method for the object.
    * @return String representation of the object.
@@ -385,52 +437,42 @@ class ForExprAST : public ExprAST {
            body_expr_->print() + ")";
   }
 
-  std::string loop_var() const { return loop_var_; }
-
-  std::shared_ptr<ExprAST> start_expr() const { return start_expr_; }
-
-  std::shared_ptr<ExprAST> end_expr() const { return end_expr_; }
+  /**
+   * @brief Getter for the loop variable name.
+   * @return Loop variable name.
+   */
+  const std::string& loop_var() const { return loop_var_; }
 
-  std::shared_ptr<ExprAST> step_expr() const { return step_expr_; }
+  /**
+   * @brief Getter for the loop variable initialisation expression.
+   * @return Start expression.
+   */
+  ExprAST* start_expr() const { return start_expr_.get(); }
 
-  std::shared_ptr<ExprAST> body_expr() const { return body_expr_; }
+  /**
+   * @brief Getter for the loop termination expression.
+   * @return End expression.
+   */
+  ExprAST* end_expr() const { return end_expr_.get(); }
 
   /**
-   * @brief Accept an ASTVisitor instance to manipulate the ForExprAST
-   * object.
-   * @param visitor The visitor to apply to the AST node.
+   * @brief Getter for the loop variable increment expression.
+   * @return Step expression; nullptr if the loop didn't specify one.
    */
-  void accept(ASTVisitor& visitor) override { visitor.for_expr(*this); }
+  ExprAST* step_expr() const { return step_expr_.get(); }
 
   /**
-   * @brief Equality overload.
-   *
-   * Attempt to cast RHS to a ForExprAST and perform equality check. If we
-   * get a bad cast, then the other AST isn't a ForExprAST, and consequently
-   * not equal to the LHS.
-   * @param rhs The RHS of the equality condition.
-   * @return True if equal, false otherwise.
+   * @brief Getter for the loop body expression.
+   * @return Body expression.
    */
-  bool operator==(const AST& rhs) const override {
-    try {
-      auto recast_rhs = dynamic_cast<const ForExprAST&>(rhs);
-      return *this == recast_rhs;
-    } catch (std::bad_cast&) {
-      return false;
-    }
-  }
+  ExprAST* body_expr() const { return body_expr_.get(); }
 
   /**
-   * @brief Equality overload for two ForExprAST objects.
-   * @param rhs The RHS ForExprAST of the equality condition.
-   * @return True if equal, false otherwise.
+   * @brief Accept an ASTVisitor instance to manipulate the ForExprAST
+   * object.
+   * @param visitor The visitor to apply to the AST node.
    */
-  bool operator==(const ForExprAST& rhs) const {
-    return (
-        (loop_var_ == rhs.loop_var_) && (*start_expr_ == *rhs.start_expr_) &&
-        (*end_expr_ == *rhs.end_expr_) && (*step_expr_ == *rhs.step_expr_) &&
-        (*body_expr_ == *rhs.body_expr_));
-  }
+  void accept(ASTVisitor& visitor) override { visitor.for_expr(*this); }
 
  private:
   std::string loop_var_;
@@ -448,7 +490,7 @@ class CallExprAST : public ExprAST {
   /**
    * @brief Default constructor.
    */
-  CallExprAST() : callee_{""}, args_{} {}
+  CallExprAST() : ExprAST{ASTKind::call_expr}, callee_{""}, args_{} {}
 
   /**
    * @brief Class constructor.
@@ -457,19 +499,35 @@ class CallExprAST : public ExprAST {
    */
   CallExprAST(const std::string& callee,
               std::vector<std::shared_ptr<ExprAST>> args)
-      : callee_{callee}, args_{std::move(args)} {}
+      : ExprAST{ASTKind::call_expr},
+        callee_{callee},
+        args_{std::move(args)} {}
+
+  /**
+   * @brief Class destructor. Releases the arguments without recursing.
+   */
+  ~CallExprAST() override {
+    for (auto& arg : args_) release_child(arg);
+  }
 
   /**
    * @brief Getter for the callee.
    * @return Callee name.
    */
-  std::string callee() const { return callee_; }
+  const std::string& callee() const { return callee_; }
 
   /**
-   * @brief Getter for the call arguments.
-   * @return Arguments.
+   * @brief Getter for the number of call arguments.
+   * @return Number of arguments.
    */
-  std::vector<std::shared_ptr<ExprAST>> args() const { return args_; }
+  std::size_t arg_count() const { return args_.size(); }
+
+  /**
+   * @brief Getter for a call argument.
+   * @param idx Index of the argument.
+   * @return Argument expression.
+   */
+  ExprAST* arg(std::size_t idx) const { return args_[idx].get(); }
 
   /**
    * @brief Overload of the string representation method for the object.
@@ -492,37 +550,6 @@ class CallExprAST : public ExprAST {
    */
   void accept(ASTVisitor& visitor) override { visitor.call_expr(*this); }
 
-  /**
-   * @brief Equality overload.
-   *
-   * Attempt to cast RHS to a CallExprAST and perform equality check. If we
-   * get a bad cast, then the other AST isn't a CallExprAST, and consequently
-   * not equal to the LHS.
-   * @param rhs The RHS of the equality condition.
-   * @return True if equal, false otherwise.
-   */
-  bool operator==(const AST& rhs) const override {
-    try {
-      auto recast_rhs = dynamic_cast<const CallExprAST&>(rhs);
-      return *this == recast_rhs;
-    } catch (std::bad_cast&) {
-      return false;
-    }
-  }
-
-  /**
-   * @brief Equality overload for two CallExprAST objects.
-   * @param The RHS CallExprAST of the equality condition.
-   * @return True if equal, false otherwise.
-   */
-  bool operator==(const CallExprAST& rhs) const {
-    bool result = callee_ == rhs.callee_;
-    if (args_.size() != rhs.args_.size()) return false;
-    for (std::size_t idx = 0; idx < args_.size(); ++idx)
-      result &= (*args_[idx] == *rhs.args_[idx]);
-    return result;
-  }
-
  private:
   std::string callee_;
   std::vector<std::shared_ptr<ExprAST>> args_;
@@ -538,7 +565,7 @@ class PrototypeAST : public AST {
   /**
    * @brief Default constructor.
    */
-  PrototypeAST() : name_{""}, args_{} {}
+  PrototypeAST() : AST{ASTKind::prototype}, name_{""}, args_{} {}
 
   /**
    * @brief Class constructor.
@@ -546,7 +573,7 @@ class PrototypeAST : public AST {
    * @param args Vector containing argument names.
    */
   PrototypeAST(const std::string& name, std::vector<std::string> args)
-      : name_{name}, args_{std::move(args)} {}
+      : AST{ASTKind::prototype}, name_{name}, args_{std::move(args)} {}
 
   /**
    * @brief Getter for the function name.
@@ -558,7 +585,7 @@ class PrototypeAST : public AST {
    * @brief Getter for the args.
    * @return Arguments.
    */
-  std::vector<std::string> args() const { return args_; }
+  const std::vector<std::string>& args() const { return args_; }
 
   /**
    * @brief Overload of the string representation method for the object.
@@ -580,26 +607,6 @@ class PrototypeAST : public AST {
    */
   void accept(ASTVisitor& visitor) override { visitor.prototype(*this); }
 
-  /**
-   * @brief Equality overload.
-   * @param rhs The RHS of the equality condition. If the LHS and RHS aren't
-   * of the same type, then we catch the resultant exception and return false.
-   * @return True if equal, false otherwise.
-   */
-  bool operator==(const AST& rhs) const override {
-    try {
-      auto rhs_recast = dynamic_cast<const PrototypeAST&>(rhs);
-      if (args_.size() != rhs_recast.args_.size()) return false;
-
-      bool result = name_ == rhs_recast.name_;
-      for (std::size_t idx = 0; idx < args_.size(); ++idx)
-        result &= args_[idx] == rhs_recast.args_[idx];
-      return result;
-    } catch (std::bad_cast&) {
-      return false;
-    }
-  }
-
  private:
   std::string name_;
   std::vector<std::string> args_;
@@ -614,7 +621,7 @@ class FunctionAST : public AST {
   /**
    * @brief Default constructor.
    */
-  FunctionAST() : proto_{nullptr}, body_{nullptr} {}
+  FunctionAST() : AST{ASTKind::function}, proto_{nullptr}, body_{nullptr} {}
 
   /**
    * @brief Class constructor.
@@ -623,19 +630,21 @@ class FunctionAST : public AST {
    */
   FunctionAST(std::shared_ptr<PrototypeAST> proto,
               std::shared_ptr<ExprAST> body)
-      : proto_{std::move(proto)}, body_{std::move(body)} {}
+      : AST{ASTKind::function},
+        proto_{std::move(proto)},
+        body_{std::move(body)} {}
 
   /**
    * @brief Getter for the prototype.
    * @return Prototype.
    */
-  std::shared_ptr<PrototypeAST> proto() const { return proto_; }
+  PrototypeAST* proto() const { return proto_.get(); }
 
   /**
    * @brief Getter for the function body.
    * @return Function body.
    */
-  std::shared_ptr<ExprAST> body() const { return body_; }
+  ExprAST* body() const { return body_.get(); }
 
   /**
    * @brief Overload of the string representation method for the object.
@@ -655,38 +664,31 @@ class FunctionAST : public AST {
    */
   void accept(ASTVisitor& visitor) override { visitor.function(*this); }
 
-  /**
-   * @brief Equality overload.
-   *
-   * Attempt to cast RHS to a FunctionAST and perform equality check. If we
-   * get a bad cast, then the other AST isn't a FunctionAST, and consequently
-   * not equal to the LHS.
-   * @param rhs The RHS of the equality condition.
-   * @return True if equal, false otherwise.
-   */
-  bool operator==(const AST& rhs) const override {
-    try {
-      auto recast_rhs = dynamic_cast<const FunctionAST&>(rhs);
-      return *this == recast_rhs;
-    } catch (std::bad_cast&) {
-      return false;
-    }
-  }
-
-  /**
-   * @brief Equality overload for two FunctionAST objects.
-   * @param The RHS FunctionAST of the equality condition.
-   * @return True if equal, false otherwise.
-   */
-  bool operator==(const FunctionAST& rhs) const {
-    return (*proto_ == *rhs.proto_) && (*body_ == *rhs.body_);
-  }
-
  private:
   std::shared_ptr<PrototypeAST> proto_;
   std::shared_ptr<ExprAST> body_;
 };
 
+/**
+ * @brief Hash function object for keying unordered containers on the structure
+ * of the ASTs pointed to.
+ */
+struct StructuralHash {
+  std::size_t operator()(const AST* ast) const {
+    return static_cast<std::size_t>(structural_hash(*ast));
+  }
+};
+
+/**
+ * @brief Equality function object for keying unordered containers on the
+ * structure of the ASTs pointed to.
+ */
+struct StructuralEqual {
+  bool operator()(const AST* lhs, const AST* rhs) const {
+    return structural_equal(*lhs, *rhs);
+  }
+};
+
 }  // namespace hls
 
 #endif /* #ifndef __HLS_AST_HPP */
@@ -0,0 +1,348 @@
+/**
+ * @file ast_factory.hpp
+ * @author Salvatore Cardamone
+ * @brief Construction of AST nodes on behalf of the Parser.
+ */
+#ifndef __HLS_AST_FACTORY_HPP
+#define __HLS_AST_FACTORY_HPP
+
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <memory>
+#include <string>
+#include <tuple>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include "arena.hpp"
+#include "ast.hpp"
+
+namespace hls {
+
+/**
+ * @brief Creates AST nodes, either individually on the heap or contiguously in
+ * an Arena.
+ *
+ * The Arena owns every node created in it and frees the whole tree at once, so
+ * nodes link to their children through std::shared_ptrs that alias an empty
+ * owner; with no control block, they're no more than raw pointers into the
+ * Arena, and the nodes hand them out as such. The children can't own the Arena
+ * in turn, since it would then never be freed, so only the root of a complete
+ * AST does: own() gives it a share of the Arena, which keeps the whole tree
+ * alive for as long as the root, or anything aliasing it, is held. The Parser
+ * does this for every AST it returns.
+ *
+ * The factory can also hash-cons the pure expression nodes (numbers, variables
+ * and binary expressions); asking for a node identical to one that's already
+ * been created returns the existing node, so repeated subexpressions are
+ * shared and the AST becomes a DAG. Since children are created before their
+ * parents and are themselves unique, nodes can be identified by their contents
+ * and the addresses of their children. Copies of a factory share the table of
+ * existing nodes. Only nodes without a SourceOffset are shared, since a node
+ * that's been located stands for one place in the source, e.g. in debug info
+ * or a diagnostic, and another occurrence elsewhere is a different place; so
+ * with locations being tracked, nothing is shared. The table only holds nodes
+ * on the heap weakly, so they're still freed along with the last AST that
+ * uses them.
+ */
+class ASTFactory {
+ public:
+  /**
+   * @brief Class constructor.
+   * @param arena Arena to allocate nodes in. If nullptr, nodes are allocated
+   * individually on the heap and are reference-counted.
+   * @param hash_cons Whether to share structurally identical pure expression
+   * nodes.
+   */
+  ASTFactory(std::shared_ptr<Arena> arena = nullptr, bool hash_cons = false)
+      : arena_{std::move(arena)},
+        nodes_{hash_cons ? std::make_shared<ConsTable>() : nullptr} {}
+
+  /**
+   * @brief Getter for the Arena that nodes are allocated in.
+   * @return The Arena, or nullptr if nodes are allocated on the heap.
+   */
+  const std::shared_ptr<Arena>& arena() const { return arena_; }
+
+  /**
+   * @brief Getter for the number of requests for a pure expression node that
+   * were satisfied by an existing node.
+   * @return Number of shared nodes handed out; zero if not hash-consing.
+   */
+  std::size_t shared_nodes() const { return nodes_ ? nodes_->hits : 0; }
+
+  /**
+   * @brief Make a node the owner of the AST beneath it, e.g. once it's the
+   * root of a complete AST that's about to be handed out.
+   * @param node The node.
+   * @return The node; if it's in an Arena, sharing ownership of the Arena, so
+   * that the node and everything beneath it stay alive as long as it's held.
+   */
+  template <typename T>
+  std::shared_ptr<T> own(std::shared_ptr<T> node) const {
+    if (!arena_ || !node) return node;
+    return std::shared_ptr<T>(arena_, node.get());
+  }
+
+  /**
+   * @brief Create a NumberExprAST.
+   * @param val The numeric value of the expression.
+   * @param offset Where the node was parsed from.
+   * @return The AST node.
+   */
+  std::shared_ptr<ExprAST> number(double val, SourceOffset offset = no_offset) {
+    if (!nodes_ || offset != no_offset)
+      return make<NumberExprAST>(offset, val);
+    // Keyed on the bit pattern since e.g. 0.0 and -0.0 aren't interchangeable
+    std::uint64_t bits;
+    std::memcpy(&bits, &val, sizeof(bits));
+    return cons(nodes_->numbers, bits,
+                [&] { return make<NumberExprAST>(offset, val); });
+  }
+
+  /**
+   * @brief Create a VariableExprAST.
+   * @param name Name of the variable.
+   * @param offset Where the node was parsed from.
+   * @return The AST node.
+   */
+  std::shared_ptr<ExprAST> variable(const std::string& name,
+                                    SourceOffset offset = no_offset) {
+    if (!nodes_ || offset != no_offset)
+      return make<VariableExprAST>(offset, name);
+    return cons(nodes_->variables, name,
+                [&] { return make<VariableExprAST>(offset, name); });
+  }
+
+  /**
+   * @brief Create a BinaryExprAST.
+   * @param op The binary operator.
+   * @param lhs Left-hand side expression.
+   * @param rhs Right-hand side expression.
+   * @param offset Where the node was parsed from, i.e. the operator.
+   * @return The AST node.
+   */
+  std::shared_ptr<ExprAST> binary(char op, std::shared_ptr<ExprAST> lhs,
+                                  std::shared_ptr<ExprAST> rhs,
+                                  SourceOffset offset = no_offset) {
+    if (!nodes_ || offset != no_offset)
+      return make<BinaryExprAST>(offset, op, std::move(lhs), std::move(rhs));
+    return cons(nodes_->binaries, BinaryKey{op, lhs.get(), rhs.get()}, [&] {
+      return make<BinaryExprAST>(offset, op, std::move(lhs), std::move(rhs));
+    });
+  }
+
+  /**
+   * @brief Create an IfExprAST.
+   * @param cond The condition expression.
+   * @param then_expr Expression when condition is true.
+   * @param else_expr Expression when condition is false.
+   * @param offset Where the node was parsed from.
+   * @return The AST node.
+   */
+  std::shared_ptr<ExprAST> if_expr(std::shared_ptr<ExprAST> cond,
+                                   std::shared_ptr<ExprAST> then_expr,
+                                   std::shared_ptr<ExprAST> else_expr,
+                                   SourceOffset offset = no_offset) {
+    return make<IfExprAST>(offset, std::move(cond), std::move(then_expr),
+                           std::move(else_expr));
+  }
+
+  /**
+   * @brief Create a ForExprAST.
+   * @param loop_var Name of the loop variable.
+   * @param start_expr Initial value of the loop variable.
+   * @param end_expr Loop termination condition.
+   * @param step_expr Loop variable increment; may be nullptr.
+   * @param body_expr Loop body.
+   * @param offset Where the node was parsed from.
+   * @return The AST node.
+   */
+  std::shared_ptr<ExprAST> for_expr(const std::string& loop_var,
+                                    std::shared_ptr<ExprAST> start_expr,
+                                    std::shared_ptr<ExprAST> end_expr,
+                                    std::shared_ptr<ExprAST> step_expr,
+                                    std::shared_ptr<ExprAST> body_expr,
+                                    SourceOffset offset = no_offset) {
+    return make<ForExprAST>(offset, loop_var, std::move(start_expr),
+                            std::move(end_expr), std::move(step_expr),
+                            std::move(body_expr));
+  }
+
+  /**
+   * @brief Create a CallExprAST.
+   * @param callee Name of the function being called.
+   * @param args Arguments to the function.
+   * @param offset Where the node was parsed from.
+   * @return The AST node.
+   */
+  std::shared_ptr<ExprAST> call(const std::string& callee,
+                                std::vector<std::shared_ptr<ExprAST>> args,
+                                SourceOffset offset = no_offset) {
+    return make<CallExprAST>(offset, callee, std::move(args));
+  }
+
+  /**
+   * @brief Create a PrototypeAST.
+   * @param name Name of the function.
+   * @param args Names of the function arguments.
+   * @param offset Where the node was parsed from.
+   * @return The AST node.
+   */
+  std::shared_ptr<PrototypeAST> prototype(const std::string& name,
+                                          std::vector<std::string> args,
+                                          SourceOffset offset = no_offset) {
+    return make<PrototypeAST>(offset, name, std::move(args));
+  }
+
+  /**
+   * @brief Create a FunctionAST.
+   * @param proto Function prototype.
+   * @param body Function body.
+   * @param offset Where the node was parsed from.
+   * @return The AST node.
+   */
+  std::shared_ptr<FunctionAST> function(std::shared_ptr<PrototypeAST> proto,
+                                        std::shared_ptr<ExprAST> body,
+                                        SourceOffset offset = no_offset) {
+    return make<FunctionAST>(offset, std::move(proto), std::move(body));
+  }
+
+ private:
+  /**
+   * @brief Identity of a binary expression whose children are already unique.
+   */
+  using BinaryKey = std::tuple<char, const ExprAST*, const ExprAST*>;
+
+  /**
+   * @brief Hash for BinaryKey.
+   */
+  struct BinaryKeyHash {
+    std::size_t operator()(const BinaryKey& key) const {
+      std::size_t hash = std::hash<const ExprAST*>()(std::get<1>(key));
+      hash = hash * 31 + std::hash<const ExprAST*>()(std::get<2>(key));
+      return hash * 31 + static_cast<unsigned char>(std::get<0>(key));
+    }
+  };
+
+  /**
+   * @brief An existing pure expression node. Nodes in an Arena live as long as
+   * the Arena does anyway, so are held as they are; nodes on the heap are only
+   * referred to weakly, so the table doesn't keep them alive.
+   */
+  struct ConsEntry {
+    std::shared_ptr<ExprAST> arena_node;
+    std::weak_ptr<ExprAST> heap_node;
+
+    /**
+     * @brief Getter for the node.
+     * @return The node, or nullptr if it's been freed.
+     */
+    std::shared_ptr<ExprAST> get() const {
+      return arena_node ? arena_node : heap_node.lock();
+    }
+  };
+
+  /**
+   * @brief Every pure expression node created so far, keyed on its identity.
+   */
+  struct ConsTable {
+    std::unordered_map<std::uint64_t, ConsEntry> numbers;
+    std::unordered_map<std::string, ConsEntry> variables;
+    std::unordered_map<BinaryKey, ConsEntry, BinaryKeyHash> binaries;
+    std::size_t hits = 0;
+    // Number of entries at which to next purge those of freed nodes
+    std::size_t purge_at = 1024;
+  };
+
+  std::shared_ptr<Arena> arena_;
+  std::shared_ptr<ConsTable> nodes_;
+
+  /**
+   * @brief Return the existing node with the given identity, creating it if
+   * there isn't one.
+   * @param table The table of existing nodes of this kind.
+   * @param key Identity of the node.
+   * @param create Creates the node if it doesn't exist yet.
+   * @return The unique node with the given identity.
+   */
+  template <typename Table, typename Key, typename Create>
+  std::shared_ptr<ExprAST> cons(Table& table, const Key& key, Create create) {
+    auto existing = table.find(key);
+    if (existing != table.end()) {
+      if (auto node = existing->second.get()) {
+        ++nodes_->hits;
+        return node;
+      }
+    }
+    // Either there's no such node, or it's been freed; a freed binary
+    // expression's key may even name children that now occupy its children's
+    // addresses, but they're new nodes so a new parent is needed too
+    auto node = create();
+    ConsEntry entry;
+    if (arena_) {
+      entry.arena_node = node;
+    } else {
+      entry.heap_node = node;
+    }
+    if (existing != table.end()) {
+      existing->second = std::move(entry);
+    } else {
+      table.emplace(key, std::move(entry));
+      purge();
+    }
+    return node;
+  }
+
+  /**
+   * @brief Drop the entries of nodes on the heap that have been freed, once
+   * the table has doubled in size since the last time, so that it grows with
+   * the nodes that are alive rather than with every node ever created.
+   */
+  void purge() {
+    auto& nodes = *nodes_;
+    if (arena_ || nodes.numbers.size() + nodes.variables.size() +
+                          nodes.binaries.size() <
+                      nodes.purge_at) {
+      return;
+    }
+    auto purge_table = [](auto& table) {
+      for (auto entry = table.begin(); entry != table.end();) {
+        if (entry->second.heap_node.expired()) {
+          entry = table.erase(entry);
+        } else {
+          ++entry;
+        }
+      }
+    };
+    purge_table(nodes.numbers);
+    purge_table(nodes.variables);
+    purge_table(nodes.binaries);
+    nodes.purge_at = std::max<std::size_t>(
+        1024, 2 * (nodes.numbers.size() + nodes.variables.size() +
+                   nodes.binaries.size()));
+  }
+
+  /**
+   * @brief Allocate a node according to the allocation mode of the factory.
+   * @param offset Where the node was parsed from.
+   * @param args Arguments forwarded to the node constructor.
+   * @return The node.
+   */
+  template <typename T, typename... Args>
+  std::shared_ptr<T> make(SourceOffset offset, Args&&... args) {
+    std::shared_ptr<T> node =
+        arena_ ? std::shared_ptr<T>(
+                     std::shared_ptr<void>(),
+                     arena_->create<T>(std::forward<Args>(args)...))
+               : std::make_shared<T>(std::forward<Args>(args)...);
+    node->set_offset(offset);
+    return node;
+  }
+};
+
+}  // namespace hls
+
+#endif /* #ifndef __HLS_AST_FACTORY_HPP */
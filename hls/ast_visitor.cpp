@@ -15,10 +15,34 @@
 #include "ast.hpp"
 // clang-format on
 
+#include <llvm/BinaryFormat/Dwarf.h>
+#include <llvm/IR/DebugInfoMetadata.h>
+#include <llvm/Linker/Linker.h>
+#include <llvm/Passes/OptimizationLevel.h>
+#include <llvm/Passes/PassBuilder.h>
+#include <llvm/Support/Error.h>
+#include <llvm/Support/Path.h>
+#include <llvm/Transforms/Scalar/LoopUnrollPass.h>
+#include <llvm/Transforms/Vectorize/SLPVectorizer.h>
+
+#include <stdexcept>
+#include <utility>
+
+#include "compile_cache.hpp"
+
 namespace hls {
 
 llvm::Value* ASTCodegen::value(ExprAST& ast) {
+  if (!debug_) {
+    ast.accept(*this);
+    return value_;
+  }
+  // Whatever's generated once the node is done (e.g. the operation combining
+  // it with its siblings) belongs to the enclosing node again
+  llvm::DebugLoc enclosing = builder_->getCurrentDebugLocation();
+  locate(ast);
   ast.accept(*this);
+  builder_->SetCurrentDebugLocation(enclosing);
   return value_;
 }
 
@@ -27,32 +51,151 @@ std::ostream& operator<<(std::ostream& os, ASTCodegen& ast_codegen) {
   return os;
 }
 
-ASTCodegen::ASTCodegen(std::string& name, bool incremental_print)
-    : incremental_print_{incremental_print},
-      context_{std::make_unique<llvm::LLVMContext>()},
-      builder_{std::make_unique<llvm::IRBuilder<>>(*context_)},
-      module_{std::make_unique<llvm::Module>(name, *context_)},
-      fpm_{std::make_unique<llvm::legacy::FunctionPassManager>(module_.get())} {
-  // Initialise the function pass manager to enable optimisations; you can find
-  // these listed at https://llvm.org/docs/Passes.html. As the name suggests,
-  // these optimisations are run per-function as opposed to the entire IR
-
-  // Instruction-combining pass to create simpler expressions, e.g.
-  // (y = x + 1); (z = y + 1) => (z = x + 2)
-  fpm_->add(llvm::createInstructionCombiningPass());
-
-  // Reassociate expressions to facilitate better constant propagation, etc.,
-  // e.g. 4 + (x + 5) => x + (4 + 5) Different expression types are ranked
-  // differently to do the reassociation, e.g. constants have rank 0, function
-  // calls rank 1, etc.
-  fpm_->add(llvm::createReassociatePass());
-
-  // Global-Value numbering pass eliminates redundant instructions
-  fpm_->add(llvm::createGVNPass());
-
-  // Control-Flow Graph simplication removes dead code and merges basic blocks
-  fpm_->add(llvm::createCFGSimplificationPass());
-  fpm_->doInitialization();
+struct ASTCodegen::Passes {
+  // Analysis managers refer to each other, so must be destroyed in the
+  // reverse of this order
+  llvm::PassBuilder builder;
+  llvm::LoopAnalysisManager lam;
+  llvm::FunctionAnalysisManager fam;
+  llvm::CGSCCAnalysisManager cgam;
+  llvm::ModuleAnalysisManager mam;
+  llvm::FunctionPassManager fpm;
+
+  Passes(const CodegenOptions& options) {
+    builder.registerModuleAnalyses(mam);
+    builder.registerCGSCCAnalyses(cgam);
+    builder.registerFunctionAnalyses(fam);
+    builder.registerLoopAnalyses(lam);
+    builder.crossRegisterProxies(lam, fam, cgam, mam);
+
+    if (!options.pipeline.empty()) {
+      if (auto error = builder.parsePassPipeline(fpm, options.pipeline)) {
+        throw std::runtime_error("Invalid pass pipeline '" + options.pipeline +
+                                 "': " + llvm::toString(std::move(error)));
+      }
+      return;
+    }
+
+    // The default per-function pipelines: at O1 these are (amongst others)
+    // instruction combining, reassociation, CFG simplification and LICM, and
+    // O2 adds GVN and full unrolling of loops. O0 doesn't touch the IR at all
+    if (options.opt_level == OptLevel::O0) return;
+    llvm::OptimizationLevel level = llvm::OptimizationLevel::O1;
+    if (options.opt_level == OptLevel::O2) level = llvm::OptimizationLevel::O2;
+    if (options.opt_level == OptLevel::O3) level = llvm::OptimizationLevel::O3;
+    fpm = builder.buildFunctionSimplificationPipeline(
+        level, llvm::ThinOrFullLTOPhase::None);
+
+    // Partial unrolling and vectorisation normally happen in the module
+    // optimisation pipeline, which we never run since we optimise one
+    // function at a time
+    if (options.opt_level != OptLevel::O1) {
+      fpm.addPass(llvm::LoopUnrollPass(llvm::LoopUnrollOptions(
+          level.getSpeedupLevel(), false, false)));
+      fpm.addPass(llvm::SLPVectorizerPass());
+    }
+  }
+};
+
+ASTCodegen::ASTCodegen(const std::string& name, bool incremental_print,
+                       CodegenOptions options,
+                       std::shared_ptr<const SourceManager> sources)
+    : name_{name},
+      incremental_print_{incremental_print},
+      options_{std::move(options)},
+      diagnostics_{options_.diagnostics, name},
+      sources_{std::move(sources)} {
+  initialise();
+}
+
+ASTCodegen::~ASTCodegen() {
+  // Cached analyses refer to the module, so go first
+  passes_.reset();
+}
+
+CodegenModule ASTCodegen::release_module() {
+  // The passes and builders refer to the module and context, so they go first
+  if (debug_) debug_->finalize();
+  debug_.reset();
+  passes_.reset();
+  builder_.reset();
+  named_values_.clear();
+  CodegenModule released{std::move(context_), std::move(module_)};
+  initialise();
+  return released;
+}
+
+void ASTCodegen::initialise() {
+  context_ = std::make_unique<llvm::LLVMContext>();
+  builder_ = std::make_unique<llvm::IRBuilder<>>(*context_);
+  module_ = std::make_unique<llvm::Module>(name_, *context_);
+  passes_ = std::make_unique<Passes>(options_);
+  unit_ = nullptr;
+  if (options_.debug_info && sources_) {
+    module_->addModuleFlag(llvm::Module::Warning, "Debug Info Version",
+                           llvm::DEBUG_METADATA_VERSION);
+    debug_ = std::make_unique<llvm::DIBuilder>(*module_);
+  }
+}
+
+llvm::DISubprogram* ASTCodegen::describe(FunctionAST& ast) {
+  if (!debug_) return nullptr;
+  SourceLocation location = sources_->location(ast.offset());
+  if (!location.valid()) return nullptr;
+
+  std::string path(sources_->name(ast.offset()));
+  llvm::StringRef directory = llvm::sys::path::parent_path(path);
+  llvm::DIFile* file = debug_->createFile(llvm::sys::path::filename(path),
+                                          directory.empty() ? "." : directory);
+  const bool optimised =
+      options_.opt_level != OptLevel::O0 || !options_.pipeline.empty();
+  if (!unit_) {
+    unit_ = debug_->createCompileUnit(llvm::dwarf::DW_LANG_C, file, "hls",
+                                      optimised, "", 0);
+  }
+
+  // Everything is a double
+  llvm::DIType* type =
+      debug_->createBasicType("double", 64, llvm::dwarf::DW_ATE_float);
+  llvm::SmallVector<llvm::Metadata*, 8> signature(
+      ast.proto()->args().size() + 1, type);
+  auto flags = llvm::DISubprogram::SPFlagDefinition;
+  if (optimised) flags |= llvm::DISubprogram::SPFlagOptimized;
+  llvm::DISubprogram* subprogram = debug_->createFunction(
+      file, function_->getName(), llvm::StringRef(), file, location.line,
+      debug_->createSubroutineType(debug_->getOrCreateTypeArray(signature)),
+      location.line, llvm::DINode::FlagPrototyped, flags);
+  function_->setSubprogram(subprogram);
+  return subprogram;
+}
+
+SourceLocation ASTCodegen::where(const AST& ast) const {
+  return sources_ ? sources_->location(ast.offset()) : SourceLocation();
+}
+
+void ASTCodegen::locate(const AST& ast) {
+  llvm::DISubprogram* scope =
+      builder_->GetInsertBlock()->getParent()->getSubprogram();
+  if (!scope) return;
+  SourceLocation location = sources_->location(ast.offset());
+  if (!location.valid()) return;
+  builder_->SetCurrentDebugLocation(
+      llvm::DILocation::get(*context_, location.line, location.column, scope));
+}
+
+llvm::Function* ASTCodegen::get_function(const std::string& name) {
+  if (auto* function = module_->getFunction(name)) return function;
+
+  // Functions generated into earlier modules just need declaring in this one
+  auto proto = prototypes_.find(name);
+  if (proto == prototypes_.end()) return nullptr;
+  // Declaring goes through the function cache, which may be in use by the
+  // function whose body we're generating
+  llvm::Function* current = function_;
+  PrototypeAST(name, proto->second).accept(*this);
+  llvm::Function* declared = function_;
+  function_ = current;
+  return declared;
 }
 
 void ASTCodegen::number_expr(NumberExprAST& ast) {
@@ -68,9 +211,11 @@ void ASTCodegen::number_expr(NumberExprAST& ast) {
 void ASTCodegen::variable_expr(VariableExprAST& ast) {
   // Lookup whether the variable exists or not in the symbol table;
   // if it's not there, we return a nullptr
-  auto val = named_values_[ast.name()];
-  value_ = val ? val : nullptr;
-  if (!value_) std::cerr << "Variable not in symbol table.\n";
+  auto val = named_values_.find(ast.name());
+  if (val == named_values_.end()) {
+    return value_error("Variable " + ast.name() + " not in symbol table.", ast);
+  }
+  value_ = val->second;
   if (incremental_print_) {
     value_->print(llvm::errs());
     std::cout << std::endl;
@@ -81,10 +226,10 @@ void ASTCodegen::binary_expr(BinaryExprAST& ast) {
   // Need to retrieve the LHS and RHS codegen from the ASTCodegen value
   // cache one at a time
   llvm::Value* lhs = value(*ast.lhs());
-  llvm::Value* rhs = value(*ast.lhs());
+  llvm::Value* rhs = value(*ast.rhs());
 
-  if (!(lhs || rhs)) {
-    return value_error("Neither LHS nor RHS could be found.\n");
+  if (!lhs || !rhs) {
+    return value_error("Couldn't generate IR for binary operand.", ast);
   }
   // Create the appropriate IR depending on the binary operator
   switch (ast.op()) {
@@ -109,7 +254,13 @@ void ASTCodegen::binary_expr(BinaryExprAST& ast) {
       break;
     }
     default: {
-      return value_error("Unrecognised binary operator.\n");
+      // Anything else is a user-defined operator, implemented by a function
+      // named after it
+      llvm::Function* function = get_function(std::string("binary") + ast.op());
+      if (!function || function->arg_size() != 2)
+        return value_error("Unrecognised binary operator.", ast);
+      value_ = builder_->CreateCall(function, {lhs, rhs}, "binop");
+      break;
     }
   }
   if (incremental_print_) {
@@ -122,7 +273,7 @@ void ASTCodegen::if_expr(IfExprAST& ast) {
   // First of all we generate the IR for the condition of the if expression
   llvm::Value* cond = value(*ast.cond());
   if (!cond) {
-    return value_error("Couldn't generate IR for if-condition.\n");
+    return value_error("Couldn't generate IR for if-condition.", ast);
   }
 
   // Check whether condition is not-equal to zero
@@ -152,7 +303,7 @@ void ASTCodegen::if_expr(IfExprAST& ast) {
   // Then block codegen
   llvm::Value* then_expr = value(*ast.then_expr());
   if (!then_expr) {
-    return value_error("Couldn't generate IR for then expression.\n");
+    return value_error("Couldn't generate IR for then expression.", ast);
   }
   // Unconditional branch to the merge block at the end of the "then"
   builder_->CreateBr(merge_bb);
@@ -171,7 +322,7 @@ void ASTCodegen::if_expr(IfExprAST& ast) {
   // Else block codegen
   llvm::Value* else_expr = value(*ast.else_expr());
   if (!else_expr) {
-    return value_error("Couldn't generate IR for else expression.\n");
+    return value_error("Couldn't generate IR for else expression.", ast);
   }
   // Unconditional branch to the merge block at the end of the "else"
   builder_->CreateBr(merge_bb);
@@ -193,15 +344,16 @@ void ASTCodegen::if_expr(IfExprAST& ast) {
   // Add the edges to the phi node
   phi_node->addIncoming(then_expr, then_bb);
   phi_node->addIncoming(else_expr, else_bb);
-  // Cache the phi
+  // Cache the phi, which is the value of the whole expression
   phi_ = phi_node;
+  value_ = phi_node;
 }
 
 void ASTCodegen::for_expr(ForExprAST& ast) {
   // Start value expression for the loop variable
   llvm::Value* start_val = value(*ast.start_expr());
   if (!start_val)
-    return value_error("Couldn't generate code for for-loop start.");
+    return value_error("Couldn't generate code for for-loop start.", ast);
 
   // Get the function that we're evaluating this control flow in
   llvm::Function* function = builder_->GetInsertBlock()->getParent();
@@ -230,14 +382,15 @@ void ASTCodegen::for_expr(ForExprAST& ast) {
   named_values_[ast.loop_var()] = loop_var_phi;
 
   if (!value(*ast.body_expr()))
-    return value_error("Couldn't generate code for loop body.");
+    return value_error("Couldn't generate code for loop body.", ast);
 
   // Handle the loop step; recall that this is an optional argument in the
   // for-loop, and defaults to 1
   llvm::Value* step_val = nullptr;
   if (ast.step_expr()) {
     step_val = value(*ast.step_expr());
-    if (!step_val) return value_error("Couldn't generate code for loop step.");
+    if (!step_val)
+      return value_error("Couldn't generate code for loop step.", ast);
   } else {
     step_val = llvm::ConstantFP::get(*context_, llvm::APFloat(1.0));
   }
@@ -250,7 +403,7 @@ void ASTCodegen::for_expr(ForExprAST& ast) {
   // we're at the end of the loop or not
   llvm::Value* end_cond = value(*ast.end_expr());
   if (!end_cond)
-    return value_error("Couldn't generate code for loop end expression.");
+    return value_error("Couldn't generate code for loop end expression.", ast);
   end_cond = builder_->CreateFCmpONE(
       end_cond, llvm::ConstantFP::get(*context_, llvm::APFloat(0.0)),
       "loop_condition");
@@ -284,20 +437,23 @@ void ASTCodegen::for_expr(ForExprAST& ast) {
 void ASTCodegen::call_expr(CallExprAST& ast) {
   // Check whether the function name exists or not in our symbol table
   // (should already be there from function definition or extern)
-  llvm::Function* callee = module_->getFunction(ast.callee());
+  llvm::Function* callee = get_function(ast.callee());
   if (!callee) {
-    return function_error("Function was not found in symbol table.\n");
+    return value_error(
+        "Function " + ast.callee() + " was not found in symbol table.", ast);
   }
-  if (callee->arg_size() != ast.args().size()) {
-    return function_error(
+  if (callee->arg_size() != ast.arg_count()) {
+    return value_error(
         "Number of arguments in CallExprAST does not match those in "
-        "symbol table.\n");
+        "symbol table.",
+        ast);
   }
 
   std::vector<llvm::Value*> args;
-  for (auto arg : ast.args()) {
-    arg->accept(*this);
-    args.push_back(value_);
+  for (std::size_t idx = 0; idx < ast.arg_count(); ++idx) {
+    args.push_back(value(*ast.arg(idx)));
+    if (!args.back())
+      return value_error("Couldn't generate IR for argument.", ast);
   }
 
   value_ = builder_->CreateCall(callee, args, "calltmp");
@@ -326,15 +482,69 @@ void ASTCodegen::prototype(PrototypeAST& ast) {
   unsigned int arg_idx = 0;
   for (auto& arg : function_->args()) arg.setName(ast.args()[arg_idx++]);
 
+  // Remember the signature, so that later modules can declare the function
+  if (!ast.name().empty()) prototypes_[ast.name()] = ast.args();
+
   if (incremental_print_) {
     function_->print(llvm::errs());
     std::cout << std::endl;
   }
 }
 
+bool ASTCodegen::load_cached(FunctionAST& ast, const std::string& key) {
+  // Leave redefinitions for the usual path to report
+  const std::string& name = ast.proto()->name();
+  auto* existing = module_->getFunction(name);
+  if (existing && !existing->isDeclaration()) return false;
+
+  // The entry was generated against the signatures that the function and its
+  // callees had then; if any of them has changed, or is no longer declared,
+  // it's a miss, and generating the function afresh reports the error
+  auto usable = [this](const llvm::Module& cached) {
+    for (const auto& function : cached) {
+      if (function.isIntrinsic()) continue;
+      // Every function takes and returns doubles, so a signature is just an
+      // argument count
+      const std::string name = function.getName().str();
+      auto proto = prototypes_.find(name);
+      if (auto* known = module_->getFunction(name)) {
+        if (known->getFunctionType() != function.getFunctionType())
+          return false;
+      } else if (proto != prototypes_.end()) {
+        if (proto->second.size() != function.arg_size()) return false;
+      } else if (function.isDeclaration()) {
+        return false;
+      }
+    }
+    return true;
+  };
+  auto cached = options_.cache->load(key, *context_, usable);
+  if (!cached) return false;
+  // Resolves any existing declaration against the cached definition
+  if (llvm::Linker::linkModules(*module_, std::move(cached))) return false;
+
+  function_ = module_->getFunction(name);
+  prototypes_[name] = ast.proto()->args();
+  if (incremental_print_) {
+    function_->print(llvm::errs());
+    std::cout << std::endl;
+  }
+  return true;
+}
+
 void ASTCodegen::function(FunctionAST& ast) {
-  // Check whether the function name is in the symbol table
-  function_ = module_->getFunction(ast.proto()->name());
+  // Anonymous functions can't be found again once they're linked in, so are
+  // never cached, and nor are functions with debug info, since that depends
+  // on where the function is as well as what it is
+  std::string cache_key;
+  if (options_.cache && !ast.proto()->name().empty() && !debug_) {
+    cache_key = CompileCache::key(ast, options_);
+    if (load_cached(ast, cache_key)) return;
+  }
+
+  // Check whether the function has already been declared, either in this
+  // module or an earlier one
+  function_ = get_function(ast.proto()->name());
 
   // If not, then we need to do the codegen for the prototype (this is a
   // function definition)
@@ -343,26 +553,43 @@ void ASTCodegen::function(FunctionAST& ast) {
   // Function shouldn't have been defined yet if we've gotten this far; we
   // can't redefine
   if (!function_->empty()) {
-    return function_error("Function redefinition.\n");
+    return function_error(
+        "Redefinition of function " + ast.proto()->name() + ".", ast);
+  }
+  if (function_->arg_size() != ast.proto()->args().size()) {
+    return function_error("Definition doesn't match declaration.", ast);
   }
+  // The body refers to the arguments by the definition's names, which needn't
+  // be those of the declaration
+  unsigned int arg_idx = 0;
+  for (auto& arg : function_->args())
+    arg.setName(ast.proto()->args()[arg_idx++]);
+  if (!ast.proto()->name().empty())
+    prototypes_[ast.proto()->name()] = ast.proto()->args();
 
   // Create the function basic block
   llvm::BasicBlock* bb =
       llvm::BasicBlock::Create(*context_, "entry", function_);
   builder_->SetInsertPoint(bb);
+  // Anything not attributed to a node of the body, e.g. the return, is
+  // attributed to the definition
+  llvm::DISubprogram* subprogram = describe(ast);
+  builder_->SetCurrentDebugLocation(llvm::DebugLoc());
+  locate(ast);
 
   // Clear out the list of in-scope variables
   named_values_.clear();
   for (auto& arg : function_->args())
     named_values_[arg.getName().data()] = &arg;
 
-  ast.body()->accept(*this);
+  value(*ast.body());
   if (value_) {
     builder_->CreateRet(value_);
+    if (subprogram) debug_->finalizeSubprogram(subprogram);
     llvm::verifyFunction(*function_);
-    // Run the function-pass manager for optimisations we set up in the
-    // class constructor
-    fpm_->run(*function_);
+    // Run the function pass pipeline we set up in the class constructor
+    passes_->fpm.run(*function_, passes_->fam);
+    if (!cache_key.empty()) options_.cache->store(cache_key, *function_);
     if (incremental_print_) {
       function_->print(llvm::errs());
       std::cout << std::endl;
@@ -371,7 +598,7 @@ void ASTCodegen::function(FunctionAST& ast) {
   }
 
   function_->eraseFromParent();
-  function_error("Function body could not be built.\n");
+  function_error("Function body could not be built.", ast);
 }
 
 }  // namespace hls
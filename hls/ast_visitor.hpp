@@ -6,23 +6,29 @@
 #ifndef __HLS_AST_VISITOR_HPP
 #define __HLS_AST_VISITOR_HPP
 
+#include <llvm/IR/DIBuilder.h>
 #include <llvm/IR/IRBuilder.h>
 #include <llvm/IR/LLVMContext.h>
-#include <llvm/IR/LegacyPassManager.h>
 #include <llvm/IR/Module.h>
 #include <llvm/IR/Verifier.h>
-#include <llvm/Pass.h>
-#include <llvm/Transforms/InstCombine/InstCombine.h>
-#include <llvm/Transforms/Scalar.h>
-#include <llvm/Transforms/Scalar/GVN.h>
 
+#include <iostream>
 #include <map>
+#include <memory>
 #include <ostream>
+#include <string>
+#include <vector>
+
+#include "diagnostics.hpp"
+#include "source_manager.hpp"
 
 namespace hls {
 
+class CompileCache;
+
 // Forward-declarations of all the AST nodes that our visitors need to
 // manipulate
+class AST;
 class ExprAST;
 class NumberExprAST;
 class VariableExprAST;
@@ -80,6 +86,47 @@ class ASTVisitor {
   virtual void function(FunctionAST&) = 0;
 };
 
+/**
+ * @brief Optimisation levels, mirroring those of clang.
+ */
+enum class OptLevel { O0, O1, O2, O3 };
+
+/**
+ * @brief Options controlling how ASTCodegen optimises the IR it generates.
+ * Each function is optimised as soon as it has been generated.
+ */
+struct CodegenOptions {
+  /// Level of LLVM's default function simplification pipeline to run. O0 runs
+  /// no passes at all.
+  OptLevel opt_level = OptLevel::O2;
+  /// Textual function pass pipeline, in the syntax of opt's -passes, e.g.
+  /// "instcombine,gvn,loop-mssa(licm)". Takes precedence over opt_level when
+  /// not empty.
+  std::string pipeline;
+  /// Cache of previously optimised functions, consulted before generating a
+  /// named function and updated afterwards. May be shared between threads.
+  std::shared_ptr<CompileCache> cache;
+  /// Where to report problems with the code, e.g. calls to undefined
+  /// functions; if nullptr, they're discarded. May be shared between threads.
+  std::shared_ptr<DiagnosticSink> diagnostics;
+  /// Whether to attach debug info to the generated IR, locating every
+  /// instruction at the line and column of the AST node it was generated
+  /// from. Needs the SourceManager that the nodes' offsets refer to; functions
+  /// with debug info bypass the cache.
+  bool debug_info = false;
+};
+
+/**
+ * @brief An IR module along with the LLVMContext that owns its types and
+ * constants. The context must outlive the module (so reset the module first
+ * rather than assigning over both), and neither may be touched by two threads
+ * at once.
+ */
+struct CodegenModule {
+  std::unique_ptr<llvm::LLVMContext> context;
+  std::unique_ptr<llvm::Module> module;
+};
+
 class ASTCodegen : public ASTVisitor {
  public:
   /**
@@ -87,8 +134,40 @@ class ASTCodegen : public ASTVisitor {
    * @param name Name of the IR module.
    * @param incremental_print Whether to incrementally print the IR generation
    * of each AST when processed. Default is false. Will be dumped to std::cerr.
+   * @param options How to optimise the generated functions, and where to
+   * report errors. Throws std::runtime_error if the pipeline can't be parsed.
+   * @param sources Resolves the SourceOffsets of the AST nodes, for debug
+   * info and the locations of diagnostics; neither is available without it.
+   */
+  ASTCodegen(const std::string& name, bool incremental_print = false,
+             CodegenOptions options = CodegenOptions(),
+             std::shared_ptr<const SourceManager> sources = nullptr);
+
+  /**
+   * @brief Class destructor. Out of line since the pass machinery is only
+   * defined in the implementation.
    */
-  ASTCodegen(std::string& name, bool incremental_print = false);
+  ~ASTCodegen();
+
+  /**
+   * @brief Getter for the IR module generated so far.
+   * @return The IR module.
+   */
+  const llvm::Module& module() const { return *module_; }
+
+  /**
+   * @brief Getter for the engine that problems with the code are reported
+   * through, e.g. to count the errors so far.
+   * @return The DiagnosticEngine.
+   */
+  const DiagnosticEngine& diagnostics() const { return diagnostics_; }
+
+  /**
+   * @brief Hand over the IR module generated so far, along with its context.
+   * Codegen continues into a fresh, empty module in a new context.
+   * @return The IR module and its context.
+   */
+  CodegenModule release_module();
 
   /**
    * @brief Generate the LLVM IR for a NumberExprAST node.
@@ -139,18 +218,70 @@ class ASTCodegen : public ASTVisitor {
   void function(FunctionAST& ast) override;
 
  private:
+  // Pass builder, pass manager and the analysis managers caching results
+  // between passes; these are bulky, so are kept out of the header
+  struct Passes;
+
+  std::string name_;
   bool incremental_print_;
+  CodegenOptions options_;
+  DiagnosticEngine diagnostics_;
+  std::shared_ptr<const SourceManager> sources_;
   std::unique_ptr<llvm::LLVMContext> context_;
   std::unique_ptr<llvm::IRBuilder<>> builder_;
   std::unique_ptr<llvm::Module> module_;
-  std::unique_ptr<llvm::legacy::FunctionPassManager> fpm_;
+  std::unique_ptr<Passes> passes_;
+  // Debug info for the current module; nullptr unless it's being generated.
+  // The compile unit is created along with the first function to need it
+  std::unique_ptr<llvm::DIBuilder> debug_;
+  llvm::DICompileUnit* unit_;
   std::map<std::string, llvm::Value*> named_values_;
+  // Argument names of every named function seen, across modules
+  std::map<std::string, std::vector<std::string>> prototypes_;
   // Caches since the return type of a visitor must be void
   llvm::Value* value_;
   llvm::Function* function_;
   llvm::PHINode* phi_;
   friend std::ostream& operator<<(std::ostream& os, ASTCodegen& ast_codegen);
 
+  /**
+   * @brief Create a new context and an empty module in it, along with the
+   * builder and optimisation passes that target them.
+   */
+  void initialise();
+
+  /**
+   * @brief Describe a function being defined to the debugger.
+   * @param ast The function definition.
+   * @return The function's debug info, which is now attached to it; nullptr
+   * if debug info isn't being generated or the function has no location.
+   */
+  llvm::DISubprogram* describe(FunctionAST& ast);
+
+  /**
+   * @brief Attribute the instructions generated from here on to an AST node,
+   * if debug info is being generated and the node has a location.
+   * @param ast The AST node.
+   */
+  void locate(const AST& ast);
+
+  /**
+   * @brief Try to satisfy a function definition from the cache.
+   * @param ast The function definition.
+   * @param key Cache key of the function.
+   * @return Whether the function was found in the cache and is now defined in
+   * the current module.
+   */
+  bool load_cached(FunctionAST& ast, const std::string& key);
+
+  /**
+   * @brief Look up a function in the current module, declaring it if it was
+   * declared or defined in a module that has since been released.
+   * @param name Name of the function.
+   * @return The function, or nullptr if it has never been seen.
+   */
+  llvm::Function* get_function(const std::string& name);
+
   /**
    * @brief Helper function to visit the AST and return the cached llvm::Value.
    * @param ast The AST to visit.
@@ -158,22 +289,31 @@ class ASTCodegen : public ASTVisitor {
    */
   llvm::Value* value(ExprAST& ast);
 
+  /**
+   * @brief Work out where a node was parsed from, for diagnostics.
+   * @param ast The node.
+   * @return Line and column of the node; unknown without a SourceManager.
+   */
+  SourceLocation where(const AST& ast) const;
+
   /**
    * @brief Flush the llvm::Value cache and report an error.
-   * @param msg The message to print to std::cerr.
+   * @param msg The message to report.
+   * @param ast The node the error arose at.
    */
-  void value_error(std::string&& msg) {
+  void value_error(std::string&& msg, const AST& ast) {
     value_ = nullptr;
-    std::cerr << msg;
+    diagnostics_.error(std::move(msg), where(ast));
   }
 
   /**
-   * @brief Flush the llvm::Value cache and report an error.
-   * @param msg The message to print to std::cerr.
+   * @brief Flush the llvm::Function cache and report an error.
+   * @param msg The message to report.
+   * @param ast The node the error arose at.
    */
-  void function_error(std::string&& msg) {
+  void function_error(std::string&& msg, const AST& ast) {
     function_ = nullptr;
-    std::cerr << msg;
+    diagnostics_.error(std::move(msg), where(ast));
   }
 };
 
@@ -0,0 +1,257 @@
+/**
+ * @file bounded_queue.hpp
+ * @author Salvatore Cardamone
+ * @brief Bounded lock-free queue for handing work between threads.
+ */
+#ifndef __HLS_BOUNDED_QUEUE_HPP
+#define __HLS_BOUNDED_QUEUE_HPP
+
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <utility>
+
+namespace hls {
+
+/**
+ * @brief Fixed-capacity FIFO queue that any number of threads may push onto
+ * and pop from concurrently, without locks.
+ *
+ * The queue is a ring of cells, each stamped with a sequence number saying
+ * which lap of the ring it's ready for, and whether it's ready to be written
+ * or read on that lap. Pushing or popping claims a position with a single
+ * compare-and-swap on the tail or head and then waits on nothing but the
+ * cell's own sequence number; producers and consumers only contend with each
+ * other when the queue is (nearly) empty or full. Cells are cache-line
+ * aligned so that neighbouring cells don't falsely share.
+ *
+ * The try_ operations never wait. push and pop wait for room or for an
+ * element; once the queue has been closed and drained, pop gives up rather
+ * than waiting, which is how consumers learn that the producers are done.
+ * Waiting threads first yield the processor for a while, in case the other end
+ * catches up quickly, and then block, so that e.g. consumers idling on a slow
+ * producer don't take the processor from it. Blocking uses an eventcount per
+ * end: a successful push or pop only takes the lock, to wake the other end, if
+ * a thread there is actually blocked, so the fast path stays lock-free.
+ *
+ * Elements must be default-constructible and move-assignable.
+ */
+template <typename T>
+class BoundedQueue {
+ public:
+  /**
+   * @brief Class constructor.
+   * @param capacity Maximum number of elements held at once; rounded up to a
+   * power of two, and at least two.
+   */
+  BoundedQueue(std::size_t capacity) {
+    capacity_ = 2;
+    while (capacity_ < capacity) capacity_ *= 2;
+    cells_ = std::make_unique<Cell[]>(capacity_);
+    for (std::size_t i = 0; i < capacity_; ++i)
+      cells_[i].sequence.store(i, std::memory_order_relaxed);
+  }
+
+  // Threads refer to the queue by address
+  BoundedQueue(const BoundedQueue&) = delete;
+  BoundedQueue& operator=(const BoundedQueue&) = delete;
+
+  /**
+   * @brief Push an element if there's room for it.
+   * @param value The element; only moved from if it was pushed.
+   * @return True if the element was pushed, false if the queue was full.
+   */
+  bool try_push(T& value) {
+    std::size_t position = tail_.load(std::memory_order_relaxed);
+    while (true) {
+      Cell& cell = cells_[position & (capacity_ - 1)];
+      std::size_t sequence = cell.sequence.load(std::memory_order_acquire);
+      // Ready to be written on this lap, not yet read on the last lap, or
+      // already claimed by another producer
+      auto lag = static_cast<std::ptrdiff_t>(sequence - position);
+      if (lag == 0) {
+        if (tail_.compare_exchange_weak(position, position + 1,
+                                        std::memory_order_relaxed)) {
+          cell.value = std::move(value);
+          cell.sequence.store(position + 1, std::memory_order_release);
+          wake(not_empty_);
+          return true;
+        }
+      } else if (lag < 0) {
+        return false;
+      } else {
+        position = tail_.load(std::memory_order_relaxed);
+      }
+    }
+  }
+
+  /**
+   * @brief Pop the oldest element, if there is one.
+   * @param value Receives the element.
+   * @return True if an element was popped, false if the queue was empty.
+   */
+  bool try_pop(T& value) {
+    std::size_t position = head_.load(std::memory_order_relaxed);
+    while (true) {
+      Cell& cell = cells_[position & (capacity_ - 1)];
+      std::size_t sequence = cell.sequence.load(std::memory_order_acquire);
+      // Written on this lap, not yet written, or already claimed by another
+      // consumer
+      auto lag = static_cast<std::ptrdiff_t>(sequence - (position + 1));
+      if (lag == 0) {
+        if (head_.compare_exchange_weak(position, position + 1,
+                                        std::memory_order_relaxed)) {
+          value = std::move(cell.value);
+          // Ready to be written on the next lap
+          cell.sequence.store(position + capacity_, std::memory_order_release);
+          wake(not_full_);
+          return true;
+        }
+      } else if (lag < 0) {
+        return false;
+      } else {
+        position = head_.load(std::memory_order_relaxed);
+      }
+    }
+  }
+
+  /**
+   * @brief Push an element, waiting for room if the queue is full. Mustn't be
+   * called once the queue has been closed.
+   * @param value The element.
+   */
+  void push(T value) {
+    auto ready = [&] { return try_push(value); };
+    for (int spin = 0; !ready(); ++spin) {
+      if (spin < spins) {
+        std::this_thread::yield();
+      } else if (block(not_full_, ready)) {
+        break;
+      }
+    }
+  }
+
+  /**
+   * @brief Pop the oldest element, waiting for one if the queue is empty.
+   * @param value Receives the element.
+   * @return True if an element was popped, false if the queue has been closed
+   * and every element pushed before then has been popped.
+   */
+  bool pop(T& value) {
+    bool popped = false;
+    auto ready = [&] {
+      popped = try_pop(value);
+      return popped || closed();
+    };
+    for (int spin = 0; !ready(); ++spin) {
+      if (spin < spins) {
+        std::this_thread::yield();
+      } else if (block(not_empty_, ready)) {
+        break;
+      }
+    }
+    // Anything pushed before the queue was closed is visible once the close
+    // is, so one last look settles whether the queue has drained
+    return popped || try_pop(value);
+  }
+
+  /**
+   * @brief Mark the queue as finished with, once every element has been
+   * pushed, so that consumers stop waiting once it's drained.
+   */
+  void close() {
+    closed_.store(true, std::memory_order_release);
+    wake(not_empty_);
+  }
+
+  /**
+   * @brief Whether the queue has been closed.
+   * @return True if there's nothing more to come.
+   */
+  bool closed() const { return closed_.load(std::memory_order_acquire); }
+
+  /**
+   * @brief Getter for the capacity of the queue.
+   * @return Maximum number of elements held at once.
+   */
+  std::size_t capacity() const { return capacity_; }
+
+ private:
+  /**
+   * @brief A slot in the ring.
+   */
+  struct alignas(64) Cell {
+    std::atomic<std::size_t> sequence;
+    T value;
+  };
+
+  /**
+   * @brief Threads blocked at one end of the queue, waiting for the other.
+   */
+  struct Waiters {
+    std::atomic<std::size_t> blocked{0};
+    // Bumped to wake the blocked threads
+    std::atomic<std::size_t> epoch{0};
+    std::condition_variable woken;
+  };
+
+  // Times a waiting thread yields before blocking
+  static constexpr int spins = 64;
+
+  std::size_t capacity_;
+  std::unique_ptr<Cell[]> cells_;
+  // Producers and consumers each hammer their own end, so keep them apart
+  alignas(64) std::atomic<std::size_t> tail_{0};
+  alignas(64) std::atomic<std::size_t> head_{0};
+  std::atomic<bool> closed_{false};
+  std::mutex mutex_;
+  Waiters not_empty_, not_full_;
+
+  /**
+   * @brief Block until woken, unless the thread turns out not to need to.
+   * @param waiters The end of the queue the thread is waiting at.
+   * @param ready Tries once more to do what the thread is waiting to do;
+   * returns true if it's done, or there's no longer any point waiting.
+   * @return True if ready() succeeded, false if the thread was woken and
+   * should try again.
+   */
+  template <typename Ready>
+  bool block(Waiters& waiters, Ready& ready) {
+    const std::size_t epoch = waiters.epoch.load();
+    ++waiters.blocked;
+    // Pairs with the fence in wake(): either the other end sees that we're
+    // blocked, or we see what it's just done
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    const bool done = ready();
+    if (!done) {
+      std::unique_lock<std::mutex> lock(mutex_);
+      waiters.woken.wait(lock, [&] { return waiters.epoch.load() != epoch; });
+    }
+    --waiters.blocked;
+    return done;
+  }
+
+  /**
+   * @brief Wake every thread blocked at one end of the queue, if there are
+   * any, since the other end has done something they may be waiting for.
+   * @param waiters The end of the queue to wake.
+   */
+  void wake(Waiters& waiters) {
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    if (waiters.blocked.load(std::memory_order_relaxed) == 0) return;
+    {
+      // Under the lock, so that a thread can't miss the bump between checking
+      // the epoch and waiting
+      std::lock_guard<std::mutex> lock(mutex_);
+      ++waiters.epoch;
+    }
+    waiters.woken.notify_all();
+  }
+};
+
+}  // namespace hls
+
+#endif /* #ifndef __HLS_BOUNDED_QUEUE_HPP */
@@ -0,0 +1,191 @@
+/**
+ * @file compile_cache.cpp
+ * @author Salvatore Cardamone
+ * @brief Persistent, content-addressed cache of compiled functions.
+ */
+#include "compile_cache.hpp"
+
+#include <llvm/ADT/SmallString.h>
+#include <llvm/Bitcode/BitcodeReader.h>
+#include <llvm/Bitcode/BitcodeWriter.h>
+#include <llvm/Config/llvm-config.h>
+#include <llvm/Support/Error.h>
+#include <llvm/Support/FileSystem.h>
+#include <llvm/Support/raw_ostream.h>
+#include <llvm/Support/xxhash.h>
+#include <llvm/Transforms/Utils/Cloning.h>
+
+#include <cinttypes>
+#include <cstdio>
+#include <filesystem>
+#include <stdexcept>
+#include <system_error>
+#include <utility>
+#include <vector>
+
+#include "ast.hpp"
+#include "ast_visitor.hpp"
+
+namespace hls {
+
+namespace {
+
+// Bump whenever the way we generate IR changes, so stale entries are ignored
+constexpr int cache_version = 1;
+
+/**
+ * @brief Format a 64-bit hash as hexadecimal.
+ * @param hash The hash.
+ * @return Sixteen hex digits.
+ */
+std::string hex(std::uint64_t hash) {
+  char digits[17];
+  std::snprintf(digits, sizeof(digits), "%016" PRIx64, hash);
+  return digits;
+}
+
+}  // namespace
+
+CompileCache::CompileCache(std::string directory)
+    : directory_{std::move(directory)} {
+  std::error_code error;
+  std::filesystem::create_directories(directory_, error);
+  if (error) {
+    throw std::runtime_error("Couldn't create cache directory " + directory_ +
+                             ": " + error.message());
+  }
+}
+
+std::string CompileCache::key(const FunctionAST& function,
+                              const CodegenOptions& options) {
+  // Everything other than the AST that decides what IR we end up with
+  std::string config = std::to_string(cache_version) + "|" +
+                       LLVM_VERSION_STRING + "|" +
+                       std::to_string(static_cast<int>(options.opt_level)) +
+                       "|" + options.pipeline;
+  return hex(structural_hash(function)) + "-" +
+         hex(llvm::xxHash64(llvm::StringRef(config)));
+}
+
+std::unique_ptr<llvm::Module> CompileCache::load(
+    const std::string& key, llvm::LLVMContext& context,
+    const std::function<bool(const llvm::Module&)>& usable) {
+  auto buffer = llvm::MemoryBuffer::getFile(path(key, ".bc"));
+  if (buffer) {
+    auto module = llvm::parseBitcodeFile((*buffer)->getMemBufferRef(), context);
+    if (module) {
+      if (!usable || usable(**module)) {
+        ++hits_;
+        return std::move(*module);
+      }
+    } else {
+      // A corrupt entry is just a miss, and will be overwritten
+      llvm::consumeError(module.takeError());
+    }
+  }
+  ++misses_;
+  return nullptr;
+}
+
+void CompileCache::store(const std::string& key,
+                         const llvm::Function& function) {
+  // Everything else in the module is cloned as a declaration, and anything the
+  // function doesn't refer to is dropped
+  llvm::ValueToValueMapTy map;
+  auto module = llvm::CloneModule(
+      *function.getParent(), map, [&function](const llvm::GlobalValue* value) {
+        return value == &function;
+      });
+  std::vector<llvm::Function*> unused;
+  for (auto& declaration : *module) {
+    if (declaration.isDeclaration() && declaration.use_empty())
+      unused.push_back(&declaration);
+  }
+  for (auto* declaration : unused) declaration->eraseFromParent();
+
+  llvm::SmallVector<char, 0> bitcode;
+  llvm::raw_svector_ostream os(bitcode);
+  llvm::WriteBitcodeToFile(*module, os);
+  write(path(key, ".bc"), bitcode.data(), bitcode.size());
+}
+
+CompileCacheStats CompileCache::stats() const {
+  return {hits_, misses_, object_hits_, object_misses_};
+}
+
+void CompileCache::store_object(const std::string& key,
+                                llvm::MemoryBufferRef object) {
+  write(path(key, ".o"), object.getBufferStart(), object.getBufferSize());
+}
+
+std::unique_ptr<llvm::MemoryBuffer> CompileCache::load_object(
+    const std::string& key) {
+  auto buffer = llvm::MemoryBuffer::getFile(path(key, ".o"));
+  if (!buffer) {
+    ++object_misses_;
+    return nullptr;
+  }
+  ++object_hits_;
+  return std::move(*buffer);
+}
+
+std::string CompileCache::path(const std::string& key,
+                               const char* extension) const {
+  return directory_ + "/" + key + extension;
+}
+
+void CompileCache::write(const std::string& path, const char* data,
+                         std::size_t size) {
+  // Readers must never see a partially-written entry, so write it under a
+  // unique name and rename it into place. Failing to write just means a miss
+  // next time, so errors are ignored
+  int fd;
+  llvm::SmallString<128> temporary;
+  if (llvm::sys::fs::createUniqueFile(directory_ + "/tmp-%%%%%%%%", fd,
+                                      temporary)) {
+    return;
+  }
+  {
+    llvm::raw_fd_ostream os(fd, true);
+    os.write(data, size);
+    if (os.has_error()) {
+      os.clear_error();
+      llvm::sys::fs::remove(temporary);
+      return;
+    }
+  }
+  if (llvm::sys::fs::rename(temporary, path)) llvm::sys::fs::remove(temporary);
+}
+
+TargetObjectCache::TargetObjectCache(std::shared_ptr<CompileCache> cache,
+                                     const std::string& triple,
+                                     const std::string& cpu,
+                                     const std::string& features)
+    : cache_{std::move(cache)} {
+  std::string config = std::to_string(cache_version) + "|" +
+                       LLVM_VERSION_STRING + "|" + triple + "|" + cpu + "|" +
+                       features;
+  target_ = hex(llvm::xxHash64(llvm::StringRef(config)));
+}
+
+void TargetObjectCache::notifyObjectCompiled(const llvm::Module* module,
+                                             llvm::MemoryBufferRef object) {
+  cache_->store_object(key(*module), object);
+}
+
+std::unique_ptr<llvm::MemoryBuffer> TargetObjectCache::getObject(
+    const llvm::Module* module) {
+  return cache_->load_object(key(*module));
+}
+
+std::string TargetObjectCache::key(const llvm::Module& module) const {
+  // Keyed on the module's contents, which are only final once it's about to
+  // be compiled
+  llvm::SmallVector<char, 0> bitcode;
+  llvm::raw_svector_ostream os(bitcode);
+  llvm::WriteBitcodeToFile(module, os);
+  return hex(llvm::xxHash64(llvm::StringRef(bitcode.data(), bitcode.size()))) +
+         "-" + target_;
+}
+
+}  // namespace hls
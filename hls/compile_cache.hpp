@@ -0,0 +1,192 @@
+/**
+ * @file compile_cache.hpp
+ * @author Salvatore Cardamone
+ * @brief Persistent, content-addressed cache of compiled functions.
+ */
+#ifndef __HLS_COMPILE_CACHE_HPP
+#define __HLS_COMPILE_CACHE_HPP
+
+#include <llvm/ExecutionEngine/ObjectCache.h>
+#include <llvm/IR/Function.h>
+#include <llvm/IR/LLVMContext.h>
+#include <llvm/IR/Module.h>
+#include <llvm/Support/MemoryBuffer.h>
+
+#include <atomic>
+#include <cstddef>
+#include <functional>
+#include <memory>
+#include <string>
+
+namespace hls {
+
+class FunctionAST;
+struct CodegenOptions;
+
+/**
+ * @brief Snapshot of how effective a CompileCache has been.
+ */
+struct CompileCacheStats {
+  std::size_t hits = 0;
+  std::size_t misses = 0;
+  std::size_t object_hits = 0;
+  std::size_t object_misses = 0;
+};
+
+/**
+ * @brief Cache of optimised functions in a local directory, which persists
+ * between runs.
+ *
+ * Functions are stored as bitcode, keyed on a structural hash of their AST
+ * along with the optimisation pipeline and LLVM version that produced them, so
+ * an unchanged function is never generated or optimised twice. Since the key
+ * is derived from the contents of the function rather than where it came from,
+ * identical functions in different files share an entry.
+ *
+ * The cache also stores the machine code the JIT compiles for each module,
+ * through a TargetObjectCache, keyed on a hash of the module's bitcode along
+ * with the target it was compiled for.
+ *
+ * Entries are written to a temporary file and renamed into place, so a cache
+ * can be shared between threads and between concurrent processes.
+ */
+class CompileCache {
+ public:
+  /**
+   * @brief Class constructor. Throws std::runtime_error if the cache directory
+   * doesn't exist and can't be created.
+   * @param directory Directory to keep the cache in.
+   */
+  CompileCache(std::string directory);
+
+  /**
+   * @brief Compute the cache key for a function.
+   * @param function The function definition.
+   * @param options How the function is to be optimised.
+   * @return The key, which is also usable as a filename.
+   */
+  static std::string key(const FunctionAST& function,
+                         const CodegenOptions& options);
+
+  /**
+   * @brief Retrieve a cached function.
+   *
+   * The key only covers the function itself, not the functions it calls, so
+   * the caller should check that the declarations in the entry still agree
+   * with its own; an entry that doesn't is counted as a miss.
+   * @param key Cache key of the function.
+   * @param context Context to load the function into.
+   * @param usable Decides whether the entry can be used; by default any entry
+   * can.
+   * @return Module defining the function (and declaring anything it refers
+   * to), or nullptr on a miss.
+   */
+  std::unique_ptr<llvm::Module> load(
+      const std::string& key, llvm::LLVMContext& context,
+      const std::function<bool(const llvm::Module&)>& usable = nullptr);
+
+  /**
+   * @brief Add a function to the cache.
+   * @param key Cache key of the function.
+   * @param function The optimised function. Only this function's definition
+   * is stored; anything else in its module is just declared.
+   */
+  void store(const std::string& key, const llvm::Function& function);
+
+  /**
+   * @brief Getter for the cache's hit and miss counts since construction.
+   * @return The statistics.
+   */
+  CompileCacheStats stats() const;
+
+  /**
+   * @brief Add machine code to the cache.
+   * @param key Cache key of the machine code.
+   * @param object The machine code.
+   */
+  void store_object(const std::string& key, llvm::MemoryBufferRef object);
+
+  /**
+   * @brief Retrieve cached machine code.
+   * @param key Cache key of the machine code.
+   * @return The machine code, or nullptr on a miss.
+   */
+  std::unique_ptr<llvm::MemoryBuffer> load_object(const std::string& key);
+
+ private:
+  std::string directory_;
+  std::atomic<std::size_t> hits_{0};
+  std::atomic<std::size_t> misses_{0};
+  std::atomic<std::size_t> object_hits_{0};
+  std::atomic<std::size_t> object_misses_{0};
+
+  /**
+   * @brief Path of a cache entry.
+   * @param key Key of the entry.
+   * @param extension Extension distinguishing the kind of entry.
+   * @return Path of the entry's file.
+   */
+  std::string path(const std::string& key, const char* extension) const;
+
+  /**
+   * @brief Atomically write a cache entry.
+   * @param path Path of the entry's file.
+   * @param data Contents of the entry.
+   * @param size Size of the contents in bytes.
+   */
+  void write(const std::string& path, const char* data, std::size_t size);
+};
+
+/**
+ * @brief llvm::ObjectCache keeping a JIT's machine code in a CompileCache.
+ *
+ * Machine code is only reusable on the target it was compiled for, so it's
+ * keyed on the target triple, CPU and features, and the LLVM version, as well
+ * as on a hash of the module's bitcode. A cache directory can then be shared
+ * between machines, or kept across an LLVM upgrade.
+ */
+class TargetObjectCache : public llvm::ObjectCache {
+ public:
+  /**
+   * @brief Class constructor.
+   * @param cache The cache to keep machine code in.
+   * @param triple Target triple the JIT compiles for.
+   * @param cpu Target CPU the JIT compiles for.
+   * @param features Target features the JIT compiles with.
+   */
+  TargetObjectCache(std::shared_ptr<CompileCache> cache,
+                    const std::string& triple, const std::string& cpu,
+                    const std::string& features);
+
+  /**
+   * @brief Add a module's machine code to the cache. Called by the JIT.
+   * @param module The module that was compiled.
+   * @param object The machine code.
+   */
+  void notifyObjectCompiled(const llvm::Module* module,
+                            llvm::MemoryBufferRef object) override;
+
+  /**
+   * @brief Retrieve a module's machine code. Called by the JIT.
+   * @param module The module to be compiled.
+   * @return The machine code, or nullptr on a miss.
+   */
+  std::unique_ptr<llvm::MemoryBuffer> getObject(
+      const llvm::Module* module) override;
+
+ private:
+  std::shared_ptr<CompileCache> cache_;
+  // Hash of everything other than the module that decides the machine code
+  std::string target_;
+
+  /**
+   * @brief Compute the cache key for a module's machine code.
+   * @param module The module.
+   * @return The key.
+   */
+  std::string key(const llvm::Module& module) const;
+};
+
+}  // namespace hls
+
+#endif /* #ifndef __HLS_COMPILE_CACHE_HPP */
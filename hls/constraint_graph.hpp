@@ -6,6 +6,12 @@
 #ifndef __HLS_CONSTRAINT_GRAPH_HPP
 #define __HLS_CONSTRAINT_GRAPH_HPP
 
+#include <algorithm>
+#include <map>
+#include <memory>
+#include <stdexcept>
+#include <string>
+
 #include "graph.hpp"
 
 namespace hls {
@@ -18,9 +24,9 @@ class ConstraintExpr {
  public:
   /**
    * @brief Class constructor.
-   * @param var_a Name of variable in the constraint expression.
-   * @param var_b Name of variable in the constraint expression.
-   * @param leq_than Value that the variable difference is less-than
+   * @param xa Name of variable in the constraint expression.
+   * @param xb Name of variable in the constraint expression.
+   * @param b Value that the variable difference is less-than
    * or equal to.
    */
   ConstraintExpr(const std::string& xa, const std::string& xb, const int& b)
@@ -61,15 +67,26 @@ class ConstraintVertex : public Vertex {
    */
   ConstraintVertex(const std::string& name) : name_{name} {}
 
+  /**
+   * @brief Getter for the name of the variable.
+   * @return Name of the variable.
+   */
+  const std::string& name() const { return name_; }
+
  private:
   std::string name_;
 };
 
-  /**
-   * @brief Specialisation of the Graph class. Wraps an adjacency list, but
-   * provides some convenience methods to construct the Graph from constraint
-   * expressions (via the ConstraintExpr class).
-   */
+/**
+ * @brief Specialisation of the Graph class. Wraps an adjacency list, but
+ * provides some convenience methods to construct the Graph from constraint
+ * expressions (via the ConstraintExpr class).
+ *
+ * Each variable is a single ConstraintVertex, however many constraints it
+ * appears in. Unlike a plain Graph, a pair of vertices may be joined by an
+ * edge in each direction, since a difference can be bounded both above and
+ * below.
+ */
 class ConstraintGraph : public Graph {
  public:
   /** 
@@ -80,12 +97,79 @@ class ConstraintGraph : public Graph {
   /**
    * @brief Add a constraint to the graph. Inequalities of the form
    * x_a - x_b <= b results in a pair of vertices, x_a and x_b, with
-   * an edge from x_b to x_a of weight b.
+   * an edge from x_b to x_a of weight b. If the difference is already
+   * constrained, only the tighter of the two constraints is kept.
+   *
+   * A variable constrained against itself, x_a - x_a <= b, holds trivially
+   * if b is non-negative, so only the variable is added. Otherwise it can
+   * never hold, and is added as an edge from x_a to itself: a cycle of
+   * negative weight, which GraphBellmanFord reports like any other.
    * @param expr The constraint expression we're adding to the Graph.
    */
   void add_constraint(const ConstraintExpr& expr) {
-    add_edge(std::make_shared<ConstraintVertex>(expr.var_b()),
-             std::make_shared<ConstraintVertex>(expr.var_a()), expr.leq_than());
+    vptr src = variable(expr.xb());
+    vptr dest = variable(expr.xa());
+    if (src == dest && expr.b() >= 0) return;
+
+    Edge edge(src, dest, expr.b());
+    auto& outputs = edges_[src];
+    auto existing = std::find(outputs.begin(), outputs.end(), edge);
+    if (existing == outputs.end()) {
+      // Edge belongs to both the source and destination, which for an edge
+      // from a variable to itself means it's listed twice
+      outputs.push_back(edge);
+      edges_[dest].push_back(edge);
+    } else if (expr.b() < existing->weight()) {
+      for (auto* listing : {&outputs, &edges_[dest]}) {
+        for (auto& listed : *listing) {
+          if (listed == edge) listed = edge;
+        }
+      }
+    }
+  }
+
+  /**
+   * @brief Look up the Vertex of a variable.
+   * @param name Name of the variable.
+   * @return The variable's Vertex.
+   * @throw std::runtime_error If no constraint involves the variable.
+   */
+  std::shared_ptr<ConstraintVertex> vertex(const std::string& name) const {
+    auto found = variables_.find(name);
+    if (found == variables_.end()) {
+      throw std::runtime_error("Variable isn't in the ConstraintGraph.");
+    }
+    return found->second;
+  }
+
+  /**
+   * @brief Recover the constraint an edge of a ConstraintGraph encodes, e.g. to
+   * report a cycle of infeasible constraints.
+   * @param edge The edge.
+   * @return The constraint.
+   */
+  static ConstraintExpr constraint(const Edge& edge) {
+    return ConstraintExpr(
+        std::static_pointer_cast<ConstraintVertex>(edge.dest())->name(),
+        std::static_pointer_cast<ConstraintVertex>(edge.src())->name(),
+        edge.weight());
+  }
+
+ private:
+  std::map<std::string, std::shared_ptr<ConstraintVertex>> variables_;
+
+  /**
+   * @brief Find the Vertex of a variable, adding one if it hasn't been seen.
+   * @param name Name of the variable.
+   * @return The variable's Vertex.
+   */
+  std::shared_ptr<ConstraintVertex> variable(const std::string& name) {
+    auto& vertex = variables_[name];
+    if (!vertex) {
+      vertex = std::make_shared<ConstraintVertex>(name);
+      add_vertex(vertex);
+    }
+    return vertex;
   }
 };
 
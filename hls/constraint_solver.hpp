@@ -0,0 +1,320 @@
+/**
+ * @file constraint_solver.hpp
+ * @author Salvatore Cardamone
+ * @brief Incremental solving of systems of difference constraints.
+ */
+#ifndef __HLS_CONSTRAINT_SOLVER_HPP
+#define __HLS_CONSTRAINT_SOLVER_HPP
+
+#include <algorithm>
+#include <cstdint>
+#include <functional>
+#include <queue>
+#include <stdexcept>
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include "constraint_graph.hpp"
+
+namespace hls {
+
+/**
+ * @brief Keeps a satisfying assignment of a system of difference constraints
+ * up to date as constraints are added and removed, e.g. by a scheduler
+ * exploring alternatives, without solving the whole system afresh each time.
+ *
+ * As in a ConstraintGraph, x_a - x_b <= b is an edge from x_b to x_a of
+ * weight b, and the value of each variable is a potential that keeps every
+ * edge's reduced weight, b + x_b - x_a, non-negative. Removing a constraint
+ * can't make the assignment violate the others, so costs nothing beyond
+ * updating the graph. Adding a constraint that the assignment violates
+ * lowers x_a by just enough to satisfy it, then lowers each of its
+ * successors in turn by just enough to satisfy the constraints that the
+ * lowering violated, nearest first (in the manner of Dijkstra's algorithm,
+ * using the reduced weights). Only the variables that have to change are
+ * visited, and each of them only once. If the lowering comes back round to
+ * x_b, the new constraint closes a cycle of negative weight; the system
+ * would be unsatisfiable, so the constraint is rejected and the assignment
+ * left as it was.
+ *
+ * The same difference may be constrained several times; only the tightest
+ * bound has any effect, but the others take over as it's removed.
+ *
+ * A variable constrained against itself, x_a - x_a <= b, holds whatever its
+ * value if b is non-negative, so is kept without an edge. Otherwise it's a
+ * negative cycle on its own, and is rejected.
+ */
+class IncrementalConstraintSolver {
+ public:
+  /**
+   * @brief Class constructor.
+   */
+  IncrementalConstraintSolver() {}
+
+  /**
+   * @brief Add a constraint, updating the assignment to satisfy it.
+   * @param expr The constraint expression.
+   * @return True if the constraint was added. False if it conflicts with the
+   * constraints already added, in which case it's discarded, and conflict()
+   * describes why.
+   */
+  bool add_constraint(const ConstraintExpr& expr) {
+    conflict_.clear();
+    const vertex_id src = variable(expr.xb());
+    const vertex_id dest = variable(expr.xa());
+    if (src == dest && expr.b() < 0) {
+      // Can't hold whatever the variable's value: a cycle on its own
+      conflict_.push_back(expr);
+      return false;
+    }
+    auto& bounds = bounds_[key(src, dest)];
+    const bool tighter = bounds.empty() || expr.b() < bounds.front();
+
+    if (tighter && !propagate(src, dest, expr.b())) {
+      if (bounds.empty()) bounds_.erase(key(src, dest));
+      return false;
+    }
+    bounds.insert(std::upper_bound(bounds.begin(), bounds.end(), expr.b()),
+                  expr.b());
+    if (tighter && src != dest) set_weight(src, dest, expr.b());
+    ++constraints_;
+    return true;
+  }
+
+  /**
+   * @brief Remove a constraint previously added. The assignment still
+   * satisfies those that remain, so isn't changed.
+   * @param expr The constraint expression; the variables and bound must match
+   * those of an added constraint.
+   * @throw std::runtime_error If there's no such constraint.
+   */
+  void remove_constraint(const ConstraintExpr& expr) {
+    auto src = ids_.find(expr.xb());
+    auto dest = ids_.find(expr.xa());
+    auto bounds = src == ids_.end() || dest == ids_.end()
+                      ? bounds_.end()
+                      : bounds_.find(key(src->second, dest->second));
+    if (bounds == bounds_.end()) {
+      throw std::runtime_error("Constraint isn't in the solver.");
+    }
+    auto& values = bounds->second;
+    auto bound = std::lower_bound(values.begin(), values.end(), expr.b());
+    if (bound == values.end() || *bound != expr.b()) {
+      throw std::runtime_error("Constraint isn't in the solver.");
+    }
+    values.erase(bound);
+    --constraints_;
+    // A variable constrained against itself has no edge
+    const bool edge = src->second != dest->second;
+    if (values.empty()) {
+      if (edge) remove_edge(src->second, dest->second);
+      bounds_.erase(bounds);
+    } else if (edge) {
+      set_weight(src->second, dest->second, values.front());
+    }
+  }
+
+  /**
+   * @brief Getter for the value of a variable in the current assignment. The
+   * values satisfy every constraint added and not since removed.
+   * @param name Name of the variable.
+   * @return Value of the variable; zero if no constraint has involved it.
+   */
+  int value(const std::string& name) const {
+    auto found = ids_.find(name);
+    return found == ids_.end() ? 0 : potentials_[found->second];
+  }
+
+  /**
+   * @brief Getter for the reason the last constraint rejected by
+   * add_constraint() was rejected.
+   * @return The constraints forming a cycle of negative weight, beginning
+   * with the rejected one; empty if the last constraint added was accepted.
+   */
+  const std::vector<ConstraintExpr>& conflict() const { return conflict_; }
+
+  /**
+   * @brief Getter for the number of constraints in the system.
+   * @return Number of constraints.
+   */
+  std::size_t size() const { return constraints_; }
+
+  /**
+   * @brief Getter for the number of variables that have been constrained.
+   * @return Number of variables.
+   */
+  std::size_t num_variables() const { return names_.size(); }
+
+ private:
+  using vertex_id = std::uint32_t;
+
+  /**
+   * @brief An edge out of a vertex, i.e. a constraint on the difference
+   * between its destination and the vertex.
+   */
+  struct Arc {
+    vertex_id dest;
+    int weight;  //< Tightest bound on the difference
+  };
+
+  std::unordered_map<std::string, vertex_id> ids_;
+  std::vector<std::string> names_;
+  std::vector<int> potentials_;
+  std::vector<std::vector<Arc>> arcs_;
+  // Every bound on each constrained difference, in ascending order
+  std::unordered_map<std::uint64_t, std::vector<int>> bounds_;
+  std::size_t constraints_ = 0;
+  std::vector<ConstraintExpr> conflict_;
+
+  // Scratch space for propagate(), kept between calls so that an edit costs
+  // time in proportion to the variables it changes rather than to them all
+  std::vector<int> lowering_;
+  std::vector<vertex_id> previous_;
+  std::vector<bool> settled_;
+  std::vector<vertex_id> touched_;
+
+  /**
+   * @brief Find the vertex of a variable, adding one if it hasn't been seen.
+   * @param name Name of the variable.
+   * @return Number of the variable's vertex.
+   */
+  vertex_id variable(const std::string& name) {
+    auto [found, added] =
+        ids_.emplace(name, static_cast<vertex_id>(names_.size()));
+    if (added) {
+      names_.push_back(name);
+      potentials_.push_back(0);
+      arcs_.emplace_back();
+      lowering_.push_back(0);
+      previous_.push_back(0);
+      settled_.push_back(false);
+    }
+    return found->second;
+  }
+
+  /**
+   * @brief Key of the bounds on the difference between two variables.
+   * @param src Vertex of x_b.
+   * @param dest Vertex of x_a.
+   * @return The key.
+   */
+  static std::uint64_t key(vertex_id src, vertex_id dest) {
+    return static_cast<std::uint64_t>(src) << 32 | dest;
+  }
+
+  /**
+   * @brief Find the edge between two vertices.
+   * @param src Source vertex.
+   * @param dest Destination vertex.
+   * @return The edge, or the end of the source's edges if there isn't one.
+   */
+  std::vector<Arc>::iterator find_arc(vertex_id src, vertex_id dest) {
+    return std::find_if(arcs_[src].begin(), arcs_[src].end(),
+                        [dest](const Arc& arc) { return arc.dest == dest; });
+  }
+
+  /**
+   * @brief Set the weight of the edge between two vertices, adding the edge if
+   * there isn't one.
+   * @param src Source vertex.
+   * @param dest Destination vertex.
+   * @param weight Weight of the edge.
+   */
+  void set_weight(vertex_id src, vertex_id dest, int weight) {
+    auto& arcs = arcs_[src];
+    auto arc = find_arc(src, dest);
+    if (arc == arcs.end()) {
+      arcs.push_back({dest, weight});
+    } else {
+      arc->weight = weight;
+    }
+  }
+
+  /**
+   * @brief Remove the edge between two vertices.
+   * @param src Source vertex.
+   * @param dest Destination vertex.
+   */
+  void remove_edge(vertex_id src, vertex_id dest) {
+    auto& arcs = arcs_[src];
+    *find_arc(src, dest) = arcs.back();
+    arcs.pop_back();
+  }
+
+  /**
+   * @brief Update the potentials to satisfy a new edge, if that's possible.
+   * @param src Source of the edge.
+   * @param dest Destination of the edge.
+   * @param weight Weight of the edge.
+   * @return True if the potentials were updated, false if the edge closes a
+   * negative cycle, in which case the potentials are left alone and the cycle
+   * is recorded in conflict_.
+   */
+  bool propagate(vertex_id src, vertex_id dest, int weight) {
+    // Work in terms of how far each potential has to be lowered, which is
+    // never positive
+    const int first = potentials_[src] + weight - potentials_[dest];
+    if (first >= 0) return true;
+
+    using Entry = std::pair<int, vertex_id>;
+    std::priority_queue<Entry, std::vector<Entry>, std::greater<Entry>> heap;
+    auto lower = [&](vertex_id v, int amount, vertex_id from) {
+      if (lowering_[v] == 0) touched_.push_back(v);
+      lowering_[v] = amount;
+      previous_[v] = from;
+      heap.emplace(amount, v);
+    };
+    lower(dest, first, src);
+
+    bool feasible = true;
+    while (!heap.empty() && feasible) {
+      auto [amount, current] = heap.top();
+      heap.pop();
+      if (settled_[current] || amount != lowering_[current]) continue;
+      settled_[current] = true;
+
+      // Lowering the current vertex lowers the reduced weights of its
+      // outputs by as much; any that go negative take their destination
+      // down with them
+      const int potential = potentials_[current] + amount;
+      for (const Arc& arc : arcs_[current]) {
+        if (settled_[arc.dest]) continue;
+        const int needed = potential + arc.weight - potentials_[arc.dest];
+        if (needed >= lowering_[arc.dest]) continue;
+        if (arc.dest == src) {
+          // Back where we started: the new edge closes a negative cycle
+          previous_[src] = current;
+          feasible = false;
+          break;
+        }
+        lower(arc.dest, needed, current);
+      }
+    }
+
+    if (feasible) {
+      for (vertex_id v : touched_) potentials_[v] += lowering_[v];
+    } else {
+      // Retrace the cycle from the new edge, which entered dest
+      conflict_.emplace_back(names_[dest], names_[src], weight);
+      std::vector<ConstraintExpr> path;
+      for (vertex_id v = src; v != dest; v = previous_[v]) {
+        path.emplace_back(names_[v], names_[previous_[v]],
+                          bounds_.at(key(previous_[v], v)).front());
+      }
+      conflict_.insert(conflict_.end(), path.rbegin(), path.rend());
+    }
+
+    for (vertex_id v : touched_) {
+      lowering_[v] = 0;
+      settled_[v] = false;
+    }
+    touched_.clear();
+    return feasible;
+  }
+};
+
+}  // namespace hls
+
+#endif /* #ifndef __HLS_CONSTRAINT_SOLVER_HPP */
@@ -0,0 +1,291 @@
+/**
+ * @file csr_graph.hpp
+ * @author Salvatore Cardamone
+ * @brief Compact, immutable representation of a scheduling Graph.
+ */
+#ifndef __HLS_CSR_GRAPH_HPP
+#define __HLS_CSR_GRAPH_HPP
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <limits>
+#include <memory>
+#include <stdexcept>
+#include <unordered_map>
+#include <vector>
+
+#include "graph.hpp"
+
+namespace hls {
+
+/**
+ * @brief Immutable Graph in compressed sparse row form, for running
+ * algorithms over large graphs.
+ *
+ * Vertices are numbered 0 to num_vertices() - 1, in the order they were added
+ * to the Graph, and edges are numbered 0 to num_edges() - 1, grouped by their
+ * source vertex. The destinations and weights of a vertex's output edges then
+ * lie contiguously in a pair of flat arrays, found through an array of offsets
+ * indexed by vertex, so walking a vertex's outputs touches a couple of cache
+ * lines rather than chasing pointers. Its input edges are laid out the same
+ * way in a second pair of arrays, holding the source vertex and the number of
+ * each edge. Every edge costs 16 bytes across the four arrays and nothing is
+ * allocated by a query.
+ *
+ * Unlike Graph::outputs() and Graph::inputs(), an edge from a vertex to itself
+ * is kept, so that e.g. one of negative weight is seen as a cycle.
+ */
+class CSRGraph {
+ public:
+  using vptr = std::shared_ptr<Vertex>;
+  using vertex_id = std::uint32_t;
+  using edge_id = std::uint32_t;
+
+  /**
+   * @brief Contiguous, read-only run of elements of one of the graph's arrays.
+   */
+  template <typename T>
+  class Span {
+   public:
+    Span(const T* begin, const T* end) : begin_{begin}, end_{end} {}
+
+    const T* begin() const { return begin_; }
+    const T* end() const { return end_; }
+    std::size_t size() const { return end_ - begin_; }
+    bool empty() const { return begin_ == end_; }
+    const T& operator[](std::size_t i) const { return begin_[i]; }
+
+   private:
+    const T* begin_;
+    const T* end_;
+  };
+
+  /**
+   * @brief Class constructor. Lays out a snapshot of a Graph; later changes to
+   * the Graph aren't reflected.
+   * @param graph The Graph.
+   * @throw std::length_error If the Graph has too many vertices or edges to be
+   * numbered.
+   */
+  CSRGraph(const Graph& graph) {
+    if (graph.vertices_.size() >= std::numeric_limits<vertex_id>::max())
+      throw std::length_error("Graph has too many vertices to compress.");
+    vertices_ = graph.vertices_;
+    ids_.reserve(vertices_.size());
+    for (vertex_id v = 0; v < vertices_.size(); ++v)
+      ids_.emplace(vertices_[v].get(), v);
+
+    // Count the edges into and out of each vertex, then turn the counts into
+    // offsets. Each Edge is listed under both of its vertices, so only look
+    // at it from its source.
+    out_offsets_.assign(vertices_.size() + 1, 0);
+    in_offsets_.assign(vertices_.size() + 1, 0);
+    std::size_t edges = 0;
+    for (vertex_id v = 0; v < vertices_.size(); ++v) {
+      bool looped = false;
+      for (const auto& edge : graph.edges_.at(vertices_[v])) {
+        if (!output(edge, vertices_[v], looped)) continue;
+        ++out_offsets_[v + 1];
+        ++in_offsets_[ids_.at(edge.dest().get()) + 1];
+        ++edges;
+      }
+    }
+    if (edges >= std::numeric_limits<edge_id>::max())
+      throw std::length_error("Graph has too many edges to compress.");
+    for (vertex_id v = 0; v < vertices_.size(); ++v) {
+      out_offsets_[v + 1] += out_offsets_[v];
+      in_offsets_[v + 1] += in_offsets_[v];
+    }
+
+    destinations_.resize(edges);
+    weights_.resize(edges);
+    sources_.resize(edges);
+    in_edges_.resize(edges);
+    // Next free slot in each vertex's run of input edges
+    std::vector<edge_id> next_in(in_offsets_.begin(), in_offsets_.end() - 1);
+    edge_id e = 0;
+    for (vertex_id v = 0; v < vertices_.size(); ++v) {
+      bool looped = false;
+      for (const auto& edge : graph.edges_.at(vertices_[v])) {
+        if (!output(edge, vertices_[v], looped)) continue;
+        vertex_id dest = ids_.at(edge.dest().get());
+        destinations_[e] = dest;
+        weights_[e] = edge.weight();
+        sources_[next_in[dest]] = v;
+        in_edges_[next_in[dest]++] = e++;
+      }
+    }
+  }
+
+  /**
+   * @brief Accept a GraphVisitor instance to analyse the graph.
+   * @param visitor The GraphVisitor object.
+   */
+  void accept(GraphVisitor& visitor) const { visitor.visit(*this); }
+
+  /**
+   * @brief Getter for the number of vertices.
+   * @return Number of vertices.
+   */
+  std::size_t num_vertices() const { return vertices_.size(); }
+
+  /**
+   * @brief Getter for the number of edges.
+   * @return Number of edges.
+   */
+  std::size_t num_edges() const { return destinations_.size(); }
+
+  /**
+   * @brief Look up the number of a Vertex.
+   * @param vertex The Vertex.
+   * @return Its number.
+   * @throw std::runtime_error If the Vertex isn't in the graph.
+   */
+  vertex_id id(const vptr& vertex) const {
+    auto found = ids_.find(vertex.get());
+    if (found == ids_.end()) {
+      throw std::runtime_error("Vertex isn't in the Graph.");
+    }
+    return found->second;
+  }
+
+  /**
+   * @brief Look up a Vertex by its number.
+   * @param v Number of the Vertex.
+   * @return The Vertex.
+   */
+  const vptr& vertex(vertex_id v) const { return vertices_[v]; }
+
+  /**
+   * @brief Getter for the number of the first output edge of a vertex. Its
+   * output edges are numbered out_begin(v) to out_end(v) - 1.
+   * @param v Number of the vertex.
+   * @return Number of the edge.
+   */
+  edge_id out_begin(vertex_id v) const { return out_offsets_[v]; }
+
+  /**
+   * @brief Getter for the number one past the last output edge of a vertex.
+   * @param v Number of the vertex.
+   * @return Number of the edge.
+   */
+  edge_id out_end(vertex_id v) const { return out_offsets_[v + 1]; }
+
+  /**
+   * @brief Getter for the number of edges out of a vertex.
+   * @param v Number of the vertex.
+   * @return Number of output edges.
+   */
+  std::size_t out_degree(vertex_id v) const {
+    return out_end(v) - out_begin(v);
+  }
+
+  /**
+   * @brief Getter for the number of edges into a vertex.
+   * @param v Number of the vertex.
+   * @return Number of input edges.
+   */
+  std::size_t in_degree(vertex_id v) const {
+    return in_offsets_[v + 1] - in_offsets_[v];
+  }
+
+  /**
+   * @brief Getter for the vertices fed by a vertex.
+   * @param v Number of the vertex.
+   * @return Destinations of its output edges, in order of edge number.
+   */
+  Span<vertex_id> destinations(vertex_id v) const {
+    return {destinations_.data() + out_begin(v),
+            destinations_.data() + out_end(v)};
+  }
+
+  /**
+   * @brief Getter for the weights of the edges out of a vertex.
+   * @param v Number of the vertex.
+   * @return Weights of its output edges, in the same order as destinations().
+   */
+  Span<int> weights(vertex_id v) const {
+    return {weights_.data() + out_begin(v), weights_.data() + out_end(v)};
+  }
+
+  /**
+   * @brief Getter for the vertices feeding into a vertex.
+   * @param v Number of the vertex.
+   * @return Sources of its input edges.
+   */
+  Span<vertex_id> sources(vertex_id v) const {
+    return {sources_.data() + in_offsets_[v],
+            sources_.data() + in_offsets_[v + 1]};
+  }
+
+  /**
+   * @brief Getter for the edges into a vertex.
+   * @param v Number of the vertex.
+   * @return Numbers of its input edges, in the same order as sources().
+   */
+  Span<edge_id> in_edges(vertex_id v) const {
+    return {in_edges_.data() + in_offsets_[v],
+            in_edges_.data() + in_offsets_[v + 1]};
+  }
+
+  /**
+   * @brief Getter for the source of an edge. Takes a binary search, so prefer
+   * keeping track of the source while walking a vertex's outputs.
+   * @param e Number of the edge.
+   * @return Number of the vertex the edge leaves.
+   */
+  vertex_id source(edge_id e) const {
+    auto after =
+        std::upper_bound(out_offsets_.begin(), out_offsets_.end(), e);
+    return static_cast<vertex_id>(after - out_offsets_.begin()) - 1;
+  }
+
+  /**
+   * @brief Getter for the destination of an edge.
+   * @param e Number of the edge.
+   * @return Number of the vertex the edge enters.
+   */
+  vertex_id destination(edge_id e) const { return destinations_[e]; }
+
+  /**
+   * @brief Getter for the weight of an edge.
+   * @param e Number of the edge.
+   * @return The edge weight.
+   */
+  int weight(edge_id e) const { return weights_[e]; }
+
+ private:
+  /**
+   * @brief Whether an edge listed under a vertex is one of the vertex's
+   * outputs. Every edge is listed under both its source and its destination,
+   * so an edge from the vertex to itself is listed twice; only the first
+   * listing counts.
+   * @param edge The edge.
+   * @param vertex The vertex it's listed under.
+   * @param looped Whether the vertex's edge to itself has been counted;
+   * updated.
+   * @return True if the edge is an output to count.
+   */
+  static bool output(const Edge& edge, const vptr& vertex, bool& looped) {
+    if (edge.src() != vertex) return false;
+    if (edge.dest() != vertex) return true;
+    looped = !looped;
+    return looped;
+  }
+
+  std::vector<vptr> vertices_;
+  std::unordered_map<const Vertex*, vertex_id> ids_;
+  // Output edges, by edge number
+  std::vector<edge_id> out_offsets_;
+  std::vector<vertex_id> destinations_;
+  std::vector<int> weights_;
+  // Input edges, grouped by destination
+  std::vector<edge_id> in_offsets_;
+  std::vector<vertex_id> sources_;
+  std::vector<edge_id> in_edges_;
+};
+
+}  // namespace hls
+
+#endif /* #ifndef __HLS_CSR_GRAPH_HPP */
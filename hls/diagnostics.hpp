@@ -0,0 +1,243 @@
+/**
+ * @file diagnostics.hpp
+ * @author Salvatore Cardamone
+ * @brief Reporting of errors and warnings in Kaleidoscope code.
+ */
+#ifndef __HLS_DIAGNOSTICS_HPP
+#define __HLS_DIAGNOSTICS_HPP
+
+#include <cstddef>
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <ostream>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "source_manager.hpp"
+
+namespace hls {
+
+/**
+ * @brief How serious a diagnostic is.
+ */
+enum class Severity {
+  note,     //< Additional information, e.g. about an earlier diagnostic
+  warning,  //< Suspicious, but the code can still be compiled
+  error     //< The code can't be compiled as written
+};
+
+/**
+ * @brief Output stream operator overload for printing of Severity.
+ * @param os Output stream.
+ * @param severity Severity to print.
+ * @return The output stream we've printed to.
+ */
+static std::ostream& operator<<(std::ostream& os, Severity severity) {
+  switch (severity) {
+    case Severity::note:
+      return os << "note";
+    case Severity::warning:
+      return os << "warning";
+    case Severity::error:
+      return os << "error";
+  }
+  return os;
+}
+
+/**
+ * @brief A single error, warning or note, along with where it arose.
+ */
+struct Diagnostic {
+  Severity severity = Severity::error;
+  std::string source;  //< Name of the source buffer, e.g. the file name
+  SourceLocation location;
+  std::string message;
+};
+
+/**
+ * @brief Output stream operator overload for printing of Diagnostic, in the
+ * usual source:line:column: severity: message form.
+ * @param os Output stream.
+ * @param diagnostic Diagnostic to print.
+ * @return The output stream we've printed to.
+ */
+static std::ostream& operator<<(std::ostream& os,
+                                const Diagnostic& diagnostic) {
+  if (!diagnostic.source.empty()) os << diagnostic.source << ":";
+  if (diagnostic.location.valid()) {
+    os << diagnostic.location.line << ":" << diagnostic.location.column
+       << ":";
+  }
+  if (!diagnostic.source.empty() || diagnostic.location.valid()) os << " ";
+  return os << diagnostic.severity << ": " << diagnostic.message;
+}
+
+/**
+ * @brief Destination for diagnostics. Sinks may be shared between threads, so
+ * must be safe to report to concurrently.
+ */
+class DiagnosticSink {
+ public:
+  virtual ~DiagnosticSink() = default;
+
+  /**
+   * @brief Handle a diagnostic.
+   * @param diagnostic The diagnostic.
+   */
+  virtual void report(const Diagnostic& diagnostic) = 0;
+};
+
+/**
+ * @brief Sink that discards every diagnostic.
+ */
+class NullDiagnosticSink : public DiagnosticSink {
+ public:
+  void report(const Diagnostic&) override {}
+};
+
+/**
+ * @brief Sink that keeps every diagnostic, for inspection afterwards.
+ */
+class BufferedDiagnosticSink : public DiagnosticSink {
+ public:
+  void report(const Diagnostic& diagnostic) override {
+    std::lock_guard<std::mutex> lock(mutex_);
+    diagnostics_.push_back(diagnostic);
+  }
+
+  /**
+   * @brief Getter for the diagnostics reported so far.
+   * @return Copies of the diagnostics, in the order they were reported.
+   */
+  std::vector<Diagnostic> diagnostics() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return diagnostics_;
+  }
+
+  /**
+   * @brief Discard the diagnostics reported so far.
+   */
+  void clear() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    diagnostics_.clear();
+  }
+
+ private:
+  mutable std::mutex mutex_;
+  std::vector<Diagnostic> diagnostics_;
+};
+
+/**
+ * @brief Sink that prints each diagnostic on a line of its own. The stream
+ * isn't flushed, so a buffered stream stays buffered.
+ */
+class StreamDiagnosticSink : public DiagnosticSink {
+ public:
+  /**
+   * @brief Class constructor.
+   * @param os Stream to print to, which must outlive the sink.
+   */
+  StreamDiagnosticSink(std::ostream& os = std::cerr) : os_{os} {}
+
+  void report(const Diagnostic& diagnostic) override {
+    std::lock_guard<std::mutex> lock(mutex_);
+    os_ << diagnostic << '\n';
+  }
+
+ private:
+  std::mutex mutex_;
+  std::ostream& os_;
+};
+
+/**
+ * @brief Front end through which the stages of compilation report diagnostics
+ * about a single source buffer.
+ *
+ * The engine stamps each diagnostic with the name of the buffer, counts them
+ * by severity and hands them on to a sink. By default the sink discards them,
+ * so nothing is printed unless a caller asks for it. One engine serves one
+ * buffer and may only be used by one thread at a time, but the engines of
+ * different buffers (e.g. files being compiled in parallel) can share a sink.
+ */
+class DiagnosticEngine {
+ public:
+  /**
+   * @brief Class constructor.
+   * @param sink Where to send diagnostics; if nullptr, they're discarded.
+   * @param source Name of the source buffer, e.g. the file name.
+   */
+  DiagnosticEngine(std::shared_ptr<DiagnosticSink> sink = nullptr,
+                   std::string source = "")
+      : sink_{sink ? std::move(sink) : std::make_shared<NullDiagnosticSink>()},
+        source_{std::move(source)} {}
+
+  /**
+   * @brief Report a diagnostic.
+   * @param severity How serious it is.
+   * @param message Description of the problem, without a trailing newline.
+   * @param location Where in the buffer it arose, if known.
+   */
+  void report(Severity severity, std::string message,
+              SourceLocation location = SourceLocation()) {
+    ++counts_[static_cast<std::size_t>(severity)];
+    sink_->report(Diagnostic{severity, source_, location, std::move(message)});
+  }
+
+  /**
+   * @brief Report an error.
+   * @param message Description of the problem, without a trailing newline.
+   * @param location Where in the buffer it arose, if known.
+   */
+  void error(std::string message, SourceLocation location = SourceLocation()) {
+    report(Severity::error, std::move(message), location);
+  }
+
+  /**
+   * @brief Report a warning.
+   * @param message Description of the problem, without a trailing newline.
+   * @param location Where in the buffer it arose, if known.
+   */
+  void warning(std::string message,
+               SourceLocation location = SourceLocation()) {
+    report(Severity::warning, std::move(message), location);
+  }
+
+  /**
+   * @brief Getter for the number of diagnostics reported so far with a given
+   * severity.
+   * @param severity The severity.
+   * @return Number of diagnostics.
+   */
+  std::size_t count(Severity severity) const {
+    return counts_[static_cast<std::size_t>(severity)];
+  }
+
+  /**
+   * @brief Getter for the number of errors reported so far.
+   * @return Number of errors.
+   */
+  std::size_t errors() const { return count(Severity::error); }
+
+  /**
+   * @brief Getter for the sink that diagnostics are sent to.
+   * @return The sink.
+   */
+  const std::shared_ptr<DiagnosticSink>& sink() const { return sink_; }
+
+  /**
+   * @brief Getter for the name of the source buffer.
+   * @return The name.
+   */
+  const std::string& source() const { return source_; }
+
+ private:
+  std::shared_ptr<DiagnosticSink> sink_;
+  std::string source_;
+  std::size_t counts_[3] = {0, 0, 0};
+};
+
+}  // namespace hls
+
+#endif /* #ifndef __HLS_DIAGNOSTICS_HPP */
@@ -0,0 +1,325 @@
+/**
+ * @file driver.cpp
+ * @author Salvatore Cardamone
+ * @brief Compilation of many source files in parallel.
+ *
+ * Kept out of the header so that users of the Driver don't need the LLVM
+ * bitcode and linker headers.
+ */
+#include "driver.hpp"
+
+#include <llvm/Bitcode/BitcodeReader.h>
+#include <llvm/Bitcode/BitcodeWriter.h>
+#include <llvm/IR/DiagnosticInfo.h>
+#include <llvm/IR/DiagnosticPrinter.h>
+#include <llvm/Linker/Linker.h>
+#include <llvm/Support/Error.h>
+#include <llvm/Support/MemoryBuffer.h>
+#include <llvm/Support/raw_ostream.h>
+
+#include <algorithm>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <set>
+#include <stdexcept>
+#include <tuple>
+#include <utility>
+
+#include "arena.hpp"
+#include "ast.hpp"
+#include "ast_factory.hpp"
+#include "bounded_queue.hpp"
+#include "diagnostics.hpp"
+#include "lexer.hpp"
+#include "mapped_file.hpp"
+#include "parser.hpp"
+#include "source_manager.hpp"
+
+namespace hls {
+
+namespace {
+
+// Functions parsed ahead of the codegen workers; enough to keep them busy
+// without holding much of a large file's AST at once
+constexpr std::size_t stream_capacity = 256;
+
+/**
+ * @brief Register a source buffer for locating its AST nodes, if debug info
+ * or diagnostics are wanted.
+ * @param source The source code.
+ * @param name Name of the source.
+ * @param options How the source is being compiled.
+ * @return A SourceManager holding just the buffer, and the buffer's offset in
+ * it; nullptr and no_offset if neither is wanted.
+ */
+std::pair<std::shared_ptr<SourceManager>, SourceOffset> register_source(
+    std::string_view source, const std::string& name,
+    const CodegenOptions& options) {
+  if (!options.debug_info && !options.diagnostics) return {nullptr, no_offset};
+  // One manager per buffer, since the buffer only lives as long as its
+  // compilation
+  auto sources = std::make_shared<SourceManager>();
+  SourceOffset base = sources->add(name, source);
+  return {std::move(sources), base};
+}
+
+}  // namespace
+
+std::vector<CodegenModule> Driver::compile(
+    const std::vector<std::string>& paths) {
+  std::vector<std::future<CodegenModule>> pending;
+  pending.reserve(paths.size());
+  for (const auto& path : paths)
+    pending.push_back(
+        pool_.submit([this, &path] { return compile_file(path, options_); }));
+
+  // Wait on everything before rethrowing, since the tasks refer to the paths
+  return wait_all(pending);
+}
+
+CodegenModule Driver::compile_file(const std::string& path,
+                                   const CodegenOptions& options) {
+  MappedFile file(path);
+  return compile_source(file.contents(), path, options);
+}
+
+CodegenModule Driver::compile_source(std::string_view source,
+                                     const std::string& name,
+                                     const CodegenOptions& options) {
+  auto [sources, base] = register_source(source, name, options);
+  Lexer lexer(source, nullptr,
+              std::make_shared<DiagnosticEngine>(options.diagnostics, name),
+              base);
+  // Each AST is discarded as soon as its IR is generated, so there's no point
+  // allocating and freeing nodes one at a time
+  Parser parser(lexer, ASTFactory(std::make_shared<Arena>()));
+  ASTCodegen codegen(name, false, options, sources);
+  while (!parser.eof()) {
+    if (auto ast = parser.step()) ast->accept(codegen);
+  }
+  return codegen.release_module();
+}
+
+CodegenModule Driver::compile_functions(const std::string& path) {
+  MappedFile file(path);
+  return compile_source_functions(file.contents(), path);
+}
+
+CodegenModule Driver::compile_source_functions(std::string_view source,
+                                               const std::string& name) {
+  // Parse the whole translation unit first; the shards all read the same ASTs,
+  // which live until every shard has been generated
+  auto diagnostics =
+      std::make_shared<DiagnosticEngine>(options_.diagnostics, name);
+  // Not a structured binding, since the shards capture the sources
+  std::shared_ptr<SourceManager> sources;
+  SourceOffset base;
+  std::tie(sources, base) = register_source(source, name, options_);
+  Lexer lexer(source, nullptr, diagnostics, base);
+  Parser parser(lexer, ASTFactory(std::make_shared<Arena>()));
+  // Declarations in source order, along with each function and how many of
+  // them come before it. As in serial codegen, a function can only call what's
+  // been declared by then, and is checked against any earlier extern.
+  std::vector<std::shared_ptr<PrototypeAST>> declarations;
+  std::set<std::string> declared;
+  std::set<std::string> defined;
+  std::vector<std::pair<std::shared_ptr<FunctionAST>, std::size_t>> functions;
+  auto declare = [&](std::shared_ptr<PrototypeAST> proto) {
+    if (declared.insert(proto->name()).second)
+      declarations.push_back(std::move(proto));
+  };
+  while (!parser.eof()) {
+    auto ast = parser.step();
+    if (!ast) continue;
+
+    if (ast->kind() == ASTKind::prototype) {
+      declare(std::static_pointer_cast<PrototypeAST>(std::move(ast)));
+      continue;
+    }
+    auto function = std::static_pointer_cast<FunctionAST>(std::move(ast));
+    // Shares ownership of the whole AST, which holds the prototype's Arena
+    std::shared_ptr<PrototypeAST> proto(function, function->proto());
+    // Top-level expressions are anonymous, so can't be called from another
+    // shard and don't need declaring
+    if (!proto->name().empty()) {
+      if (!defined.insert(proto->name()).second) {
+        // Same as serial codegen; the first definition wins
+        diagnostics->error("Redefinition of function " + proto->name() + ".");
+        continue;
+      }
+      declare(proto);
+    }
+    functions.emplace_back(std::move(function), declarations.size());
+  }
+
+  // Contiguous shards keep the functions in roughly their source order once
+  // the shards are linked back together
+  std::size_t shards = std::max<std::size_t>(
+      1, std::min<std::size_t>(threads(), functions.size()));
+  std::vector<std::future<CodegenModule>> pending;
+  pending.reserve(shards);
+  for (std::size_t shard = 0; shard < shards; ++shard) {
+    std::size_t begin = functions.size() * shard / shards;
+    std::size_t end = functions.size() * (shard + 1) / shards;
+    pending.push_back(pool_.submit([&, begin, end] {
+      ASTCodegen codegen(name, false, options_, sources);
+      std::size_t known = 0;
+      for (std::size_t i = begin; i < end; ++i) {
+        const auto& [function, declared_before] = functions[i];
+        for (; known < declared_before; ++known)
+          declarations[known]->accept(codegen);
+        function->accept(codegen);
+      }
+      return codegen.release_module();
+    }));
+  }
+  return link(wait_all(pending), name);
+}
+
+CodegenModule Driver::compile_streaming(const std::string& path) {
+  MappedFile file(path);
+  return compile_source_streaming(file.contents(), path);
+}
+
+CodegenModule Driver::compile_source_streaming(std::string_view source,
+                                               const std::string& name) {
+  // A function waiting to be generated, along with how many of the
+  // declarations need to be known to generate it
+  struct Pending {
+    std::shared_ptr<FunctionAST> function;
+    std::size_t declared = 0;
+  };
+  BoundedQueue<Pending> queue(stream_capacity);
+  // Only ever appended to, by the parser
+  std::vector<std::shared_ptr<PrototypeAST>> declarations;
+  std::mutex declarations_mutex;
+
+  std::shared_ptr<SourceManager> sources;
+  SourceOffset base;
+  std::tie(sources, base) = register_source(source, name, options_);
+
+  std::vector<std::future<CodegenModule>> pending;
+  pending.reserve(threads());
+  for (std::size_t worker = 0; worker < threads(); ++worker) {
+    pending.push_back(pool_.submit([&] {
+      ASTCodegen codegen(name, false, options_, sources);
+      std::size_t known = 0;
+      Pending next;
+      try {
+        while (queue.pop(next)) {
+          if (known < next.declared) {
+            std::vector<std::shared_ptr<PrototypeAST>> catch_up;
+            {
+              std::lock_guard<std::mutex> lock(declarations_mutex);
+              catch_up.assign(declarations.begin() + known,
+                              declarations.begin() + next.declared);
+            }
+            for (const auto& proto : catch_up) proto->accept(codegen);
+            known = next.declared;
+          }
+          next.function->accept(codegen);
+        }
+      } catch (...) {
+        // Keep the parser from waiting forever on a full queue
+        while (queue.pop(next)) {
+        }
+        throw;
+      }
+      return codegen.release_module();
+    }));
+  }
+
+  // The ASTs are freed as the workers finish with them, so are allocated
+  // individually rather than in an Arena that would grow with the file
+  auto diagnostics =
+      std::make_shared<DiagnosticEngine>(options_.diagnostics, name);
+  Lexer lexer(source, nullptr, diagnostics, base);
+  Parser parser(lexer);
+  std::set<std::string> declared;
+  std::set<std::string> defined;
+  auto declare = [&](std::shared_ptr<PrototypeAST> proto) {
+    if (!declared.insert(proto->name()).second) return;
+    std::lock_guard<std::mutex> lock(declarations_mutex);
+    declarations.push_back(std::move(proto));
+  };
+  try {
+    parser.parse([&](std::shared_ptr<AST> ast) {
+      if (ast->kind() == ASTKind::prototype) {
+        declare(std::static_pointer_cast<PrototypeAST>(std::move(ast)));
+        return;
+      }
+      auto function = std::static_pointer_cast<FunctionAST>(std::move(ast));
+      std::shared_ptr<PrototypeAST> proto(function, function->proto());
+      // Top-level expressions are anonymous, so can't be called from
+      // another worker and don't need declaring
+      if (!proto->name().empty()) {
+        if (!defined.insert(proto->name()).second) {
+          // Same as serial codegen; the first definition wins
+          diagnostics->error("Redefinition of function " + proto->name() +
+                             ".");
+          return;
+        }
+        declare(proto);
+      }
+      queue.push(Pending{std::move(function), declarations.size()});
+    });
+  } catch (...) {
+    queue.close();
+    // The workers refer to the queue, so have to finish before it goes
+    for (auto& result : pending) result.wait();
+    throw;
+  }
+  queue.close();
+  return link(wait_all(pending), name);
+}
+
+CodegenModule Driver::link(std::vector<CodegenModule> modules,
+                           const std::string& name) {
+  CodegenModule linked;
+  linked.context = std::make_unique<llvm::LLVMContext>();
+  linked.module = std::make_unique<llvm::Module>(name, *linked.context);
+
+  // By default the context exits the process on an error, so collect the
+  // linker's complaints instead
+  std::string diagnostics;
+  linked.context->setDiagnosticHandlerCallBack(
+      [](const llvm::DiagnosticInfo& info, void* messages) {
+        llvm::raw_string_ostream os(*static_cast<std::string*>(messages));
+        llvm::DiagnosticPrinterRawOStream printer(os);
+        info.print(printer);
+        os << "\n";
+      },
+      &diagnostics);
+
+  llvm::Linker linker(*linked.module);
+  for (auto& module : modules) {
+    // The linker only works within a single context, so move each module into
+    // ours by round-tripping it through bitcode
+    llvm::SmallVector<char, 0> bitcode;
+    llvm::raw_svector_ostream os(bitcode);
+    llvm::WriteBitcodeToFile(*module.module, os);
+    std::string id = module.module->getModuleIdentifier();
+    // Free the original as we go; the module has to go before its context
+    module.module.reset();
+    module.context.reset();
+
+    auto parsed = llvm::parseBitcodeFile(
+        llvm::MemoryBufferRef(llvm::StringRef(bitcode.data(), bitcode.size()),
+                              id),
+        *linked.context);
+    if (!parsed) {
+      throw std::runtime_error("Couldn't read back module " + id + ": " +
+                               llvm::toString(parsed.takeError()));
+    }
+    if (linker.linkInModule(std::move(*parsed))) {
+      throw std::runtime_error("Couldn't link module " + id + ": " +
+                               diagnostics);
+    }
+  }
+
+  linked.context->setDiagnosticHandlerCallBack(nullptr);
+  return linked;
+}
+
+}  // namespace hls
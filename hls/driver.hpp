@@ -0,0 +1,172 @@
+/**
+ * @file driver.hpp
+ * @author Salvatore Cardamone
+ * @brief Compilation of many source files in parallel.
+ */
+#ifndef __HLS_DRIVER_HPP
+#define __HLS_DRIVER_HPP
+
+#include <exception>
+#include <future>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+#include "ast_visitor.hpp"
+#include "thread_pool.hpp"
+
+namespace hls {
+
+/**
+ * @brief Lexes, parses and generates IR for a collection of source files on a
+ * pool of worker threads, and links the results together.
+ *
+ * Every file is compiled by its own ASTCodegen, and so into its own
+ * LLVMContext; nothing is shared between files, so the workers never contend
+ * on anything but the task queue.
+ */
+class Driver {
+ public:
+  /**
+   * @brief Class constructor.
+   * @param threads Number of worker threads. If zero, one per hardware thread.
+   * @param options How to optimise the generated IR, and where to report
+   * errors.
+   */
+  Driver(unsigned threads = 0, CodegenOptions options = CodegenOptions())
+      : pool_{threads}, options_{std::move(options)} {}
+
+  /**
+   * @brief Getter for the number of worker threads.
+   * @return Number of workers.
+   */
+  std::size_t threads() const { return pool_.size(); }
+
+  /**
+   * @brief Compile source files in parallel.
+   * @param paths Paths of the source files.
+   * @return One IR module per source file, in the same order as the paths.
+   * Throws std::runtime_error if any of the files can't be read.
+   */
+  std::vector<CodegenModule> compile(const std::vector<std::string>& paths);
+
+  /**
+   * @brief Compile a single source file, generating and optimising its
+   * functions in parallel.
+   * @param path Path of the source file, which is also used as the module name.
+   * @return The IR module. Throws std::runtime_error if the file can't be read.
+   */
+  CodegenModule compile_functions(const std::string& path);
+
+  /**
+   * @brief Compile source code, generating and optimising its functions in
+   * parallel.
+   *
+   * The whole translation unit is parsed up front and its function
+   * definitions are split into contiguous shards, one per worker. Each shard
+   * is compiled into a module of its own, in its own context, with every
+   * function in the translation unit declared so that calls resolve; the
+   * shards are then linked back together.
+   * @param source The source code.
+   * @param name Name of the IR module.
+   * @return The IR module.
+   */
+  CodegenModule compile_source_functions(std::string_view source,
+                                         const std::string& name);
+
+  /**
+   * @brief Compile a single source file, generating and optimising its
+   * functions while it's still being parsed.
+   * @param path Path of the source file, which is also used as the module name.
+   * @return The IR module. Throws std::runtime_error if the file can't be read.
+   */
+  CodegenModule compile_streaming(const std::string& path);
+
+  /**
+   * @brief Compile source code, generating and optimising its functions while
+   * it's still being parsed.
+   *
+   * The calling thread lexes and parses, pushing each function definition and
+   * top-level expression onto a bounded queue as soon as it's complete. Every
+   * worker pops functions off the queue and generates them into a module of
+   * its own, so parsing overlaps with codegen and optimisation, and the
+   * workers balance the load between them however uneven the functions are.
+   * If the workers fall behind, the queue fills and parsing waits for them,
+   * so memory is bounded however large the source.
+   *
+   * Before generating a function, a worker declares every extern and function
+   * parsed before it, so that calls resolve; the modules are then linked. The
+   * functions end up in the order the workers took them rather than source
+   * order.
+   * @param source The source code.
+   * @param name Name of the IR module.
+   * @return The IR module.
+   */
+  CodegenModule compile_source_streaming(std::string_view source,
+                                         const std::string& name);
+
+  /**
+   * @brief Compile a single source file on the calling thread.
+   * @param path Path of the source file, which is also used as the module name.
+   * @param options How to optimise the generated IR, and where to report
+   * errors.
+   * @return The IR module.
+   */
+  static CodegenModule compile_file(
+      const std::string& path,
+      const CodegenOptions& options = CodegenOptions());
+
+  /**
+   * @brief Compile source code on the calling thread.
+   * @param source The source code.
+   * @param name Name of the IR module.
+   * @param options How to optimise the generated IR, and where to report
+   * errors.
+   * @return The IR module.
+   */
+  static CodegenModule compile_source(
+      std::string_view source, const std::string& name,
+      const CodegenOptions& options = CodegenOptions());
+
+  /**
+   * @brief Link IR modules into a single module. The modules may live in
+   * different contexts; the result lives in a context of its own.
+   * @param modules Modules to link. These are consumed.
+   * @param name Name of the linked module.
+   * @return The linked module. Throws std::runtime_error if the modules can't
+   * be linked, e.g. because two of them define the same function.
+   */
+  static CodegenModule link(std::vector<CodegenModule> modules,
+                            const std::string& name);
+
+ private:
+  ThreadPool pool_;
+  CodegenOptions options_;
+
+  /**
+   * @brief Wait for every one of a collection of tasks to finish.
+   * @param pending Futures for the tasks.
+   * @return Results of the tasks, in order. If any of the tasks threw, the
+   * first exception is rethrown once they've all finished.
+   */
+  template <typename T>
+  static std::vector<T> wait_all(std::vector<std::future<T>>& pending) {
+    std::vector<T> results;
+    results.reserve(pending.size());
+    std::exception_ptr error;
+    for (auto& result : pending) {
+      try {
+        results.push_back(result.get());
+      } catch (...) {
+        if (!error) error = std::current_exception();
+      }
+    }
+    if (error) std::rethrow_exception(error);
+    return results;
+  }
+};
+
+}  // namespace hls
+
+#endif /* #ifndef __HLS_DRIVER_HPP */
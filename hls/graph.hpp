@@ -83,7 +83,7 @@ class GraphVisitor;
  */
 class Graph {
  public:
-  friend class GraphShortestPath;
+  friend class CSRGraph;
   using vptr = std::shared_ptr<Vertex>;
 
   /**
@@ -206,7 +206,7 @@ class Graph {
     return result;
   }
 
- private:
+ protected:
   std::vector<vptr> vertices_;
   std::map<vptr, std::vector<Edge>> edges_;
 
@@ -216,11 +216,8 @@ class Graph {
    * @return False if the Vertex hasn't been added to the Graph, true otherwise.
    */
   bool vertex_exists(vptr vertex) {
-    auto result = std::find(vertices_.begin(), vertices_.end(), vertex);
-    if (result == vertices_.end()) {
-      return false;
-    }
-    return true;
+    // Every Vertex has an entry in the edges map, which is quicker to search
+    return edges_.find(vertex) != edges_.end();
   }
 
   /**
@@ -4,59 +4,553 @@
  * @brief Implementation of GraphVisitor methods.
  */
 
+#include <algorithm>
+#include <atomic>
+#include <deque>
+#include <functional>
+#include <future>
 #include <limits>
+#include <queue>
 #include <set>
+#include <stdexcept>
+#include <utility>
+#include <vector>
 
 // clang-format off
 #include "graph_visitor.hpp"
+#include "csr_graph.hpp"
 #include "graph.hpp"
+#include "thread_pool.hpp"
 // clang-format on
 
 namespace hls {
 
-void GraphShortestPath::dijkstra(Graph& graph) {
-  // All vertices begin as unvisited
-  std::set<vptr> unvisited(graph.vertices_.begin(), graph.vertices_.end());
+void GraphShortestPath::visit(Graph& graph) { dijkstra(CSRGraph(graph)); }
+
+void GraphShortestPath::dijkstra(const CSRGraph& graph) {
+  using vertex_id = CSRGraph::vertex_id;
+  constexpr int infinity = std::numeric_limits<int>::max();
+  constexpr vertex_id none = std::numeric_limits<vertex_id>::max();
+  const vertex_id start = graph.id(start_);
+  const vertex_id end = graph.id(end_);
 
   // All distances are initially infinite, with the exception of the start
-  // Vertex, which we initialise with a distance of zero
-  std::map<vptr, int> distances;
-  for (auto& vertex : graph.vertices_) {
-    distances[vertex] = std::numeric_limits<int>::max();
+  // Vertex, which we initialise with a distance of zero. Each Vertex
+  // remembers the one it was reached from, to retrace the route.
+  std::vector<int> distances(graph.num_vertices(), infinity);
+  std::vector<vertex_id> previous(graph.num_vertices(), none);
+  distances[start] = 0;
+
+  // Min-heap of tentative distances. Rather than moving a Vertex up the heap
+  // when its distance improves, it's pushed again, and the stale entry is
+  // skipped when it surfaces.
+  using Entry = std::pair<int, vertex_id>;
+  std::vector<Entry> storage;
+  storage.reserve(graph.num_vertices());
+  std::priority_queue<Entry, std::vector<Entry>, std::greater<Entry>> heap(
+      std::greater<Entry>(), std::move(storage));
+  heap.emplace(0, start);
+
+  // Iterate until we arrive at our final destination Vertex, or run out of
+  // vertices we can reach
+  while (!heap.empty()) {
+    auto [distance, current] = heap.top();
+    heap.pop();
+    if (distance != distances[current]) continue;
+    if (current == end) break;
+
+    // Update neighbour distances if going via the current improves upon
+    // their previous best distance
+    auto destinations = graph.destinations(current);
+    auto weights = graph.weights(current);
+    for (std::size_t i = 0; i < destinations.size(); ++i) {
+      if (weights[i] < 0) {
+        throw std::runtime_error(
+            "Dijkstra's algorithm can't handle negative edge weights.");
+      }
+      int candidate = distance + weights[i];
+      vertex_id neighbour = destinations[i];
+      if (candidate < distances[neighbour]) {
+        distances[neighbour] = candidate;
+        previous[neighbour] = current;
+        heap.emplace(candidate, neighbour);
+      }
+    }
+  }
+
+  path_.distance = distances[end];
+  path_.route.clear();
+  if (distances[end] == infinity) return;
+  for (vertex_id v = end; v != none; v = previous[v]) {
+    path_.route.push_back(graph.vertex(v));
   }
-  distances[start_] = 0;
+  std::reverse(path_.route.begin(), path_.route.end());
+}
+
+void GraphBellmanFord::visit(Graph& graph) { solve(CSRGraph(graph)); }
 
-  auto current = start_;
-  // Iterate until we arrive at our final destination Vertex
-  while (current != end_) {
-    // Loop over all neighbours to the current Vertex
-    for (auto& edge : graph.outputs(current)) {
-      // If the neighbour has already been visited, ignore it
-      if (unvisited.find(edge.dest()) == unvisited.end()) {
-        continue;
+int GraphBellmanFord::distance(const vptr& vertex) const {
+  auto found = distances_.find(vertex.get());
+  if (found == distances_.end()) {
+    throw std::runtime_error("Vertex isn't in the Graph.");
+  }
+  return found->second;
+}
+
+void GraphBellmanFord::solve(const CSRGraph& graph) {
+  using vertex_id = CSRGraph::vertex_id;
+  using edge_id = CSRGraph::edge_id;
+  constexpr int infinity = std::numeric_limits<int>::max();
+  constexpr vertex_id none = std::numeric_limits<vertex_id>::max();
+  const vertex_id n = static_cast<vertex_id>(graph.num_vertices());
+  cycle_.clear();
+  distances_.clear();
+
+  // Without a source, every Vertex is reached from the virtual source by a
+  // zero-weight edge. Each Vertex remembers the edge it was last reached by,
+  // and the Vertex that edge left.
+  std::vector<int> distances(n, source_ ? infinity : 0);
+  std::vector<edge_id> via(n, none);
+  std::vector<vertex_id> previous(n, none);
+
+  // The tree of shortest paths, threaded in preorder through a doubly-linked
+  // list so that a Vertex's descendants are the ones following it that are
+  // deeper than it. The list is circular through an extra root node, which
+  // stands for the (possibly virtual) source.
+  const vertex_id root = n;
+  std::vector<vertex_id> after(n + 1, none), before(n + 1, none);
+  std::vector<vertex_id> depth(n + 1, 0);
+  after[root] = before[root] = root;
+  auto insert = [&](vertex_id v, vertex_id parent) {
+    depth[v] = depth[parent] + 1;
+    after[v] = after[parent];
+    before[v] = parent;
+    before[after[parent]] = v;
+    after[parent] = v;
+  };
+
+  // Vertices whose distances have improved since they were last scanned, in
+  // the order they improved. A Vertex taken out of the tree is left in the
+  // queue, but marked so that it's skipped.
+  std::deque<vertex_id> queue;
+  std::vector<bool> queued(n, false);
+  auto enqueue = [&](vertex_id v) {
+    if (!queued[v]) queue.push_back(v);
+    queued[v] = true;
+  };
+  if (source_) {
+    vertex_id source = graph.id(source_);
+    distances[source] = 0;
+    insert(source, root);
+    enqueue(source);
+  } else {
+    for (vertex_id v = n; v-- > 0;) {
+      insert(v, root);
+      enqueue(v);
+    }
+  }
+
+  vertex_id on_cycle = none;
+  while (!queue.empty() && on_cycle == none) {
+    vertex_id current = queue.front();
+    queue.pop_front();
+    if (!queued[current]) continue;
+    queued[current] = false;
+
+    for (edge_id e = graph.out_begin(current); e != graph.out_end(current);
+         ++e) {
+      int candidate = distances[current] + graph.weight(e);
+      vertex_id next = graph.destination(e);
+      if (candidate >= distances[next]) continue;
+      distances[next] = candidate;
+      via[next] = e;
+      previous[next] = current;
+      // An edge of negative weight from the Vertex to itself is a cycle alone
+      if (next == current) {
+        on_cycle = current;
+        break;
       }
 
-      // Update Vertex distances if going via the current improves
-      // upon its previous best distance
-      int temp_dist = distances[current] + edge.weight();
-      if (temp_dist <= distances[edge.dest()]) {
-        distances[edge.dest()] = temp_dist;
+      // Take the Vertex and everything below it out of the tree. If the
+      // current Vertex is below it, the edge has closed a negative cycle.
+      if (after[next] != none) {
+        vertex_id below = after[next];
+        while (depth[below] > depth[next]) {
+          if (below == current) on_cycle = current;
+          queued[below] = false;
+          vertex_id following = after[below];
+          after[below] = none;
+          below = following;
+        }
+        after[before[next]] = below;
+        before[below] = before[next];
+        after[next] = none;
+        if (on_cycle != none) break;
       }
+      insert(next, current);
+      enqueue(next);
     }
+  }
+
+  if (on_cycle != none) {
+    // Predecessors lead backwards around the cycle
+    vertex_id v = on_cycle;
+    do {
+      cycle_.emplace_back(graph.vertex(previous[v]), graph.vertex(v),
+                          graph.weight(via[v]));
+      v = previous[v];
+    } while (v != on_cycle);
+    std::reverse(cycle_.begin(), cycle_.end());
+  }
+
+  distances_.reserve(n);
+  for (vertex_id v = 0; v < n; ++v) {
+    distances_.emplace(graph.vertex(v).get(), distances[v]);
+  }
+}
+
+GraphAllPairs::GraphAllPairs(Method method, unsigned threads)
+    : method_{method}, used_{method}, threads_{threads} {}
+
+GraphAllPairs::GraphAllPairs(ThreadPool& pool, Method method)
+    : method_{method}, used_{method}, pool_{&pool} {}
 
-    // We've now visited the Vertex that was current
-    unvisited.erase(current);
+GraphAllPairs::~GraphAllPairs() = default;
 
-    // Find our next current from the unvisited Vertex set
-    int shortest = std::numeric_limits<int>::max();
-    for (auto& vertex : unvisited) {
-      if (distances[vertex] < shortest) {
-        shortest = distances[vertex];
-        current = vertex;
+void GraphAllPairs::visit(Graph& graph) { visit(CSRGraph(graph)); }
+
+void GraphAllPairs::visit(const CSRGraph& graph) {
+  size_ = graph.num_vertices();
+  ids_.clear();
+  ids_.reserve(size_);
+  for (std::size_t v = 0; v < size_; ++v) {
+    ids_.emplace(graph.vertex(static_cast<CSRGraph::vertex_id>(v)).get(), v);
+  }
+  distances_.assign(size_ * size_, std::numeric_limits<int>::max());
+
+  // Johnson's algorithm does work in proportion to V E log V, Floyd-Warshall
+  // to V^3, though with a far smaller constant
+  used_ = method_;
+  if (used_ == Method::automatic) {
+    used_ = graph.num_edges() * 16 > size_ * size_ ? Method::floyd_warshall
+                                                    : Method::johnson;
+  }
+  // Starting threads costs more than many a small graph takes to search, so
+  // they're kept for later visits
+  if (!pool_) {
+    owned_ = std::make_unique<ThreadPool>(threads_);
+    pool_ = owned_.get();
+  }
+  if (used_ == Method::floyd_warshall) {
+    floyd_warshall(graph, *pool_);
+  } else {
+    johnson(graph, *pool_);
+  }
+}
+
+int GraphAllPairs::distance(const vptr& from, const vptr& to) const {
+  auto source = ids_.find(from.get());
+  auto destination = ids_.find(to.get());
+  if (source == ids_.end() || destination == ids_.end()) {
+    throw std::runtime_error("Vertex isn't in the Graph.");
+  }
+  return distance(source->second, destination->second);
+}
+
+void GraphAllPairs::floyd_warshall(const CSRGraph& graph, ThreadPool& pool) {
+  constexpr int infinity = std::numeric_limits<int>::max();
+  // 64x64 ints is 16KiB, so the three blocks an update touches fit in L1
+  constexpr std::size_t block = 64;
+  const std::size_t n = size_;
+  int* d = distances_.data();
+
+  for (std::size_t v = 0; v < n; ++v) {
+    d[v * n + v] = 0;
+    auto destinations = graph.destinations(static_cast<CSRGraph::vertex_id>(v));
+    auto weights = graph.weights(static_cast<CSRGraph::vertex_id>(v));
+    for (std::size_t i = 0; i < destinations.size(); ++i) {
+      int& entry = d[v * n + destinations[i]];
+      entry = std::min(entry, weights[i]);
+    }
+  }
+
+  // Shorten the paths in one block of the matrix by going through the
+  // vertices of another. Written so that the inner loop vectorises.
+  auto relax = [n, d](std::size_t rows, std::size_t columns,
+                      std::size_t through) {
+    const std::size_t row_end = std::min(rows + block, n);
+    const std::size_t column_end = std::min(columns + block, n);
+    const std::size_t through_end = std::min(through + block, n);
+    for (std::size_t k = through; k < through_end; ++k) {
+      const int* dk = d + k * n;
+      for (std::size_t i = rows; i < row_end; ++i) {
+        const int ik = d[i * n + k];
+        if (ik == infinity) continue;
+        int* di = d + i * n;
+        for (std::size_t j = columns; j < column_end; ++j) {
+          const int via = dk[j] == infinity ? infinity : ik + dk[j];
+          di[j] = std::min(di[j], via);
+        }
       }
     }
+  };
+
+  // For each block of intermediate vertices, first the block on the
+  // diagonal depends only on itself; then the other blocks in its row and
+  // column depend only on themselves and the diagonal; then the rest depend
+  // only on those
+  std::vector<std::future<void>> pending;
+  auto wait = [&pending]() {
+    for (auto& future : pending) future.get();
+    pending.clear();
+  };
+  for (std::size_t k = 0; k < n; k += block) {
+    relax(k, k, k);
+    for (std::size_t other = 0; other < n; other += block) {
+      if (other == k) continue;
+      pending.push_back(pool.submit([=] {
+        relax(k, other, k);
+        relax(other, k, k);
+      }));
+    }
+    wait();
+    for (std::size_t rows = 0; rows < n; rows += block) {
+      if (rows == k) continue;
+      pending.push_back(pool.submit([=] {
+        for (std::size_t columns = 0; columns < n; columns += block) {
+          if (columns != k) relax(rows, columns, k);
+        }
+      }));
+    }
+    wait();
+  }
+
+  for (std::size_t v = 0; v < n; ++v) {
+    if (d[v * n + v] < 0) {
+      throw std::runtime_error("Graph has a cycle of negative weight.");
+    }
+  }
+}
+
+void GraphAllPairs::johnson(const CSRGraph& graph, ThreadPool& pool) {
+  using vertex_id = CSRGraph::vertex_id;
+  constexpr int infinity = std::numeric_limits<int>::max();
+  const std::size_t n = size_;
+
+  // Distances from the virtual source make every reduced weight,
+  // w(u, v) + h(u) - h(v), non-negative; the reduced length of a path is its
+  // length plus h of its start, less h of its end
+  GraphBellmanFord potentials;
+  graph.accept(potentials);
+  if (!potentials.feasible()) {
+    throw std::runtime_error("Graph has a cycle of negative weight.");
+  }
+  std::vector<int> h(n);
+  for (vertex_id v = 0; v < n; ++v) {
+    h[v] = potentials.distance(graph.vertex(v));
+  }
+  std::vector<int> reduced(graph.num_edges());
+  for (vertex_id v = 0; v < n; ++v) {
+    for (auto e = graph.out_begin(v); e != graph.out_end(v); ++e) {
+      reduced[e] = graph.weight(e) + h[v] - h[graph.destination(e)];
+    }
+  }
+
+  // Each task runs Dijkstra's algorithm from a contiguous range of sources,
+  // straight into their rows of the matrix. The heap is kept as a plain
+  // vector so that its storage is reused from one source to the next.
+  auto rows = [this, &graph, &h, &reduced, n](vertex_id first,
+                                              vertex_id last) {
+    using Entry = std::pair<int, vertex_id>;
+    std::vector<Entry> heap;
+    const std::greater<Entry> later;
+    for (vertex_id source = first; source < last; ++source) {
+      int* row = distances_.data() + source * n;
+      row[source] = 0;
+      heap.emplace_back(0, source);
+      while (!heap.empty()) {
+        std::pop_heap(heap.begin(), heap.end(), later);
+        auto [distance, current] = heap.back();
+        heap.pop_back();
+        if (distance != row[current]) continue;
+        for (auto e = graph.out_begin(current); e != graph.out_end(current);
+             ++e) {
+          int candidate = distance + reduced[e];
+          vertex_id neighbour = graph.destination(e);
+          if (candidate < row[neighbour]) {
+            row[neighbour] = candidate;
+            heap.emplace_back(candidate, neighbour);
+            std::push_heap(heap.begin(), heap.end(), later);
+          }
+        }
+      }
+      // Undo the reweighting
+      for (vertex_id v = 0; v < n; ++v) {
+        if (row[v] != infinity) row[v] += h[v] - h[source];
+      }
+    }
+  };
+
+  // A few chunks per thread, so that a chunk of sources that reach further
+  // than the rest doesn't hold everything up
+  const std::size_t chunk = std::max<std::size_t>(1, n / (pool.size() * 4));
+  std::vector<std::future<void>> pending;
+  for (std::size_t first = 0; first < n; first += chunk) {
+    auto last = static_cast<vertex_id>(std::min(first + chunk, n));
+    pending.push_back(pool.submit(
+        [&rows, first, last] { rows(static_cast<vertex_id>(first), last); }));
+  }
+  for (auto& future : pending) future.get();
+}
+
+GraphDeltaStepping::GraphDeltaStepping(const vptr source, int delta,
+                                       unsigned threads)
+    : source_{source}, delta_{delta}, used_{delta}, threads_{threads} {}
+
+GraphDeltaStepping::GraphDeltaStepping(ThreadPool& pool, const vptr source,
+                                       int delta)
+    : source_{source}, delta_{delta}, used_{delta}, pool_{&pool} {}
+
+GraphDeltaStepping::~GraphDeltaStepping() = default;
+
+void GraphDeltaStepping::visit(Graph& graph) { visit(CSRGraph(graph)); }
+
+void GraphDeltaStepping::visit(const CSRGraph& graph) {
+  using vertex_id = CSRGraph::vertex_id;
+  constexpr int infinity = std::numeric_limits<int>::max();
+  const vertex_id n = static_cast<vertex_id>(graph.num_vertices());
+  const vertex_id source = graph.id(source_);
+
+  int heaviest = 0;
+  for (std::size_t e = 0; e < graph.num_edges(); ++e) {
+    const int weight = graph.weight(static_cast<CSRGraph::edge_id>(e));
+    if (weight < 0) {
+      throw std::runtime_error(
+          "Delta-stepping can't handle negative edge weights.");
+    }
+    heaviest = std::max(heaviest, weight);
+  }
+  used_ = delta_;
+  if (used_ <= 0) {
+    const std::size_t degree = std::max<std::size_t>(1, graph.num_edges() / n);
+    used_ = std::max(1, static_cast<int>(heaviest / degree));
+  }
+  const int delta = used_;
+
+  std::vector<std::atomic<int>> distances(n);
+  for (auto& distance : distances) {
+    distance.store(infinity, std::memory_order_relaxed);
+  }
+  distances[source].store(0, std::memory_order_relaxed);
+
+  // Relaxing the edges out of bucket b can only reach buckets b to
+  // b + heaviest / delta + 1, so the buckets yet to be settled fit in a cyclic
+  // array, with bucket b in slot b % slots. Buckets may hold a Vertex more
+  // than once, or after it has moved to an earlier bucket; such entries are
+  // skipped when the bucket is emptied.
+  const std::size_t slots = static_cast<std::size_t>(heaviest / delta) + 2;
+  std::vector<std::vector<vertex_id>> buckets(slots);
+  buckets[0].push_back(source);
+  // Numbers of the non-empty buckets, so that runs of empty ones are skipped
+  std::set<std::size_t> filled{0};
+  auto bucket_of = [&distances, delta](vertex_id v) {
+    return static_cast<std::size_t>(
+        distances[v].load(std::memory_order_relaxed) / delta);
+  };
+
+  if (!pool_) {
+    owned_ = std::make_unique<ThreadPool>(threads_);
+    pool_ = owned_.get();
+  }
+  ThreadPool& pool = *pool_;
+  const std::size_t workers = pool.size();
+  // Vertices improved by each worker in the current round
+  std::vector<std::vector<vertex_id>> improved(workers);
+
+  // Relax the light or the heavy edges out of a set of vertices, sharing
+  // them between the workers in chunks. Small sets aren't worth waking the
+  // pool for.
+  constexpr std::size_t chunk = 64;
+  auto relax = [&](const std::vector<vertex_id>& vertices, bool light) {
+    std::atomic<std::size_t> next{0};
+    auto work = [&](std::size_t worker) {
+      auto& lowered = improved[worker];
+      for (std::size_t first = next.fetch_add(chunk);
+           first < vertices.size(); first = next.fetch_add(chunk)) {
+        const std::size_t last = std::min(first + chunk, vertices.size());
+        for (std::size_t i = first; i < last; ++i) {
+          const vertex_id v = vertices[i];
+          const int base = distances[v].load(std::memory_order_relaxed);
+          for (auto e = graph.out_begin(v); e != graph.out_end(v); ++e) {
+            const int weight = graph.weight(e);
+            if ((weight <= delta) != light) continue;
+            const int candidate = base + weight;
+            auto& distance = distances[graph.destination(e)];
+            int current = distance.load(std::memory_order_relaxed);
+            while (candidate < current) {
+              if (distance.compare_exchange_weak(current, candidate,
+                                                 std::memory_order_relaxed)) {
+                lowered.push_back(graph.destination(e));
+                break;
+              }
+            }
+          }
+        }
+      }
+    };
+    if (vertices.size() <= chunk || workers == 1) {
+      work(0);
+    } else {
+      std::vector<std::future<void>> pending;
+      for (std::size_t worker = 0; worker < workers; ++worker) {
+        pending.push_back(pool.submit([&work, worker] { work(worker); }));
+      }
+      for (auto& future : pending) future.get();
+    }
+
+    // The futures order the workers' writes before the reads here
+    for (auto& lowered : improved) {
+      for (vertex_id v : lowered) {
+        const std::size_t bucket = bucket_of(v);
+        auto& entries = buckets[bucket % slots];
+        if (entries.empty()) filled.insert(bucket);
+        entries.push_back(v);
+      }
+      lowered.clear();
+    }
+  };
+
+  // Marks for the round a Vertex was last taken from a bucket in, and the
+  // bucket it was settled in, to weed out repeated entries
+  std::vector<std::size_t> taken(n, 0), settled(n, 0);
+  std::size_t round = 0;
+  std::vector<vertex_id> frontier, done;
+  while (!filled.empty()) {
+    const std::size_t current = *filled.begin();
+    auto& bucket = buckets[current % slots];
+    done.clear();
+    while (!bucket.empty()) {
+      ++round;
+      frontier.clear();
+      for (vertex_id v : bucket) {
+        if (bucket_of(v) != current || taken[v] == round) continue;
+        taken[v] = round;
+        frontier.push_back(v);
+        if (settled[v] != current + 1) done.push_back(v);
+        settled[v] = current + 1;
+      }
+      bucket.clear();
+      relax(frontier, true);
+    }
+    // Heavy edges lead to later buckets only
+    filled.erase(current);
+    relax(done, false);
+  }
+
+  distances_.resize(n);
+  for (vertex_id v = 0; v < n; ++v) {
+    distances_[v] = distances[v].load(std::memory_order_relaxed);
   }
-  path_.distance = distances[end_];
 }
 
 }  // namespace hls
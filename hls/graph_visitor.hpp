@@ -7,12 +7,16 @@
 #define __HLS_GRAPH_VISITOR_HPP
 
 #include <memory>
+#include <unordered_map>
 #include <vector>
 
 namespace hls {
 
 // Forward-declaration of quantities the visitor needs to operate on
+class CSRGraph;
+class Edge;
 class Graph;
+class ThreadPool;
 class Vertex;
 
 /**
@@ -25,6 +29,12 @@ class GraphVisitor {
    * @param graph The Graph object to operate on.
    */
   virtual void visit(Graph& graph) = 0;
+
+  /**
+   * @brief Process a compressed Graph in some way.
+   * @param graph The CSRGraph object to operate on.
+   */
+  virtual void visit(const CSRGraph& graph) = 0;
 };
 
 /**
@@ -49,26 +59,368 @@ class GraphShortestPath : public GraphVisitor {
 
   /**
    * @brief Defer to the requested shortest-path algorithm to operate on the
-   * Graph.
+   * Graph. The Graph is compressed first; visit a CSRGraph directly to search
+   * the same Graph more than once.
    * @param graph The Graph to operate on.
    */
-  void visit(Graph& graph) override {
+  void visit(Graph& graph) override;
+
+  /**
+   * @brief Defer to the requested shortest-path algorithm to operate on the
+   * compressed Graph.
+   * @param graph The CSRGraph to operate on.
+   */
+  void visit(const CSRGraph& graph) override {
     return dijkstra(graph);
   };
 
+  /**
+   * @brief Getter for the length of the shortest path found.
+   * @return Sum of the weights along the path; std::numeric_limits<int>::max()
+   * if there's no path.
+   */
   int path_length() {
     return path_.distance;
   }
+
+  /**
+   * @brief Getter for the shortest path found.
+   * @return The vertices along the path, from the start to the end Vertex
+   * inclusive; empty if there's no path.
+   */
+  const std::vector<vptr>& route() const { return path_.route; }
   
  private:
   vptr start_, end_;
   Result path_;
   
   /**
-   * @brief Implement the Dijkstra shortest-path algorithm on an input Graph.
-   *
+   * @brief Implement the Dijkstra shortest-path algorithm on an input Graph,
+   * using a binary heap of tentative distances.
+   * @param graph The Graph to search.
+   * @throw std::runtime_error If the start or end Vertex isn't in the Graph, or
+   * the search comes across an edge with a negative weight.
+   */
+  void dijkstra(const CSRGraph& graph);
+};
+
+/**
+ * @brief Visitor for Graph class that finds the shortest paths from a source
+ * to every other Vertex, when edges may have negative weights, or shows that
+ * there's a cycle of negative weight that makes them meaningless.
+ *
+ * Solves systems of difference constraints, as encoded by a ConstraintGraph:
+ * without a source Vertex, every Vertex starts at a distance of zero, as
+ * though reached from a virtual source, and the distances found satisfy every
+ * constraint at once. If they can't be satisfied, the negative cycle found is
+ * the set of constraints that conflict.
+ *
+ * Uses the queue-based variant of the Bellman-Ford algorithm, which only
+ * revisits the vertices whose distances have just improved and stops as soon
+ * as none have, with Tarjan's subtree disassembly. The shortest paths found
+ * so far form a tree; when a Vertex's distance improves, the vertices below
+ * it in the tree are bound to improve too, so they're taken out of the tree
+ * and the queue rather than being scanned with distances already known to be
+ * stale. On the long chains of a schedule, this saves scanning each Vertex
+ * once for every Vertex above it. It also finds negative cycles as they
+ * close: a Vertex whose distance improves via one of its own descendants is on
+ * one.
+ */
+class GraphBellmanFord : public GraphVisitor {
+ public:
+  using vptr = std::shared_ptr<Vertex>;
+
+  /**
+   * @brief Class constructor.
+   * @param source Vertex to find the shortest paths from. If nullptr, the paths
+   * from a virtual source with a zero-weight edge to every Vertex.
+   */
+  GraphBellmanFord(const vptr source = nullptr) : source_{source} {}
+
+  /**
+   * @brief Find the shortest paths in the Graph. The Graph is compressed
+   * first.
+   * @param graph The Graph to operate on.
+   */
+  void visit(Graph& graph) override;
+
+  /**
+   * @brief Find the shortest paths in the compressed Graph.
+   * @param graph The CSRGraph to operate on.
+   */
+  void visit(const CSRGraph& graph) override { return solve(graph); }
+
+  /**
+   * @brief Whether the shortest paths exist, i.e. there's no negative cycle
+   * (reachable from the source). For a ConstraintGraph, whether the
+   * constraints can be satisfied.
+   * @return True if there's no negative cycle.
+   */
+  bool feasible() const { return cycle_.empty(); }
+
+  /**
+   * @brief Getter for the length of the shortest path to a Vertex. For a
+   * ConstraintGraph, a value of the Vertex's variable that satisfies every
+   * constraint. Only meaningful if feasible().
+   * @param vertex The Vertex.
+   * @return Sum of the weights along the shortest path;
+   * std::numeric_limits<int>::max() if there's no path.
+   * @throw std::runtime_error If the Vertex wasn't in the Graph.
+   */
+  int distance(const vptr& vertex) const;
+
+  /**
+   * @brief Getter for the negative cycle found.
+   * @return The edges of the cycle, in order, each one leaving the Vertex the
+   * last one entered; empty if feasible().
+   */
+  const std::vector<Edge>& cycle() const { return cycle_; }
+
+ private:
+  vptr source_;
+  std::unordered_map<const Vertex*, int> distances_;
+  std::vector<Edge> cycle_;
+
+  /**
+   * @brief Implement the queue-based Bellman-Ford algorithm on an input
+   * Graph.
+   * @param graph The Graph to search.
+   * @throw std::runtime_error If the source Vertex isn't in the Graph.
+   */
+  void solve(const CSRGraph& graph);
+};
+
+/**
+ * @brief Visitor for Graph class that finds the shortest paths between every
+ * pair of vertices, e.g. to find the combinational delay between every pair
+ * of operations. Edges may have negative weights, but there mustn't be a
+ * cycle of negative weight.
+ *
+ * Two algorithms are available, run in parallel on a pool of threads, which
+ * is either the caller's or one the visitor starts on its first visit and
+ * keeps for the rest:
+ * - Floyd-Warshall, which costs O(V^3) however many edges there are, so suits
+ *   dense graphs. The matrix is updated a block at a time, with each block
+ *   small enough to stay in cache while it's worked on; for each block of
+ *   intermediate vertices, the blocks of the matrix that don't depend on one
+ *   another are shared between the threads.
+ * - Johnson's algorithm, which costs O(VE log V), so suits sparse graphs. The
+ *   weights are made non-negative, without changing which paths are
+ *   shortest, using the distances found by GraphBellmanFord, then Dijkstra's
+ *   algorithm is run from every Vertex, with the sources shared between the
+ *   threads.
+ *
+ * The distances are kept in a single row-major matrix of ints, indexed by the
+ * numbers the vertices have in a CSRGraph.
+ */
+class GraphAllPairs : public GraphVisitor {
+ public:
+  using vptr = std::shared_ptr<Vertex>;
+
+  /**
+   * @brief Algorithm used to find the shortest paths.
+   */
+  enum class Method {
+    automatic,       //< Whichever of the others suits the graph's density
+    floyd_warshall,  //< Blocked Floyd-Warshall
+    johnson          //< Johnson's algorithm
+  };
+
+  /**
+   * @brief Class constructor.
+   * @param method Algorithm to use.
+   * @param threads Number of threads to use. If zero, one per hardware thread.
+   */
+  GraphAllPairs(Method method = Method::automatic, unsigned threads = 0);
+
+  /**
+   * @brief Class constructor, for a visitor using threads shared with others.
+   * @param pool Threads to share the work between; must outlive the visitor.
+   * @param method Algorithm to use.
+   */
+  GraphAllPairs(ThreadPool& pool, Method method = Method::automatic);
+
+  /**
+   * @brief Class destructor. Stops the visitor's own threads, if it has any.
    */
-  void dijkstra(Graph& graph);
+  ~GraphAllPairs();
+
+  /**
+   * @brief Find the shortest paths in the Graph. The Graph is compressed
+   * first.
+   * @param graph The Graph to operate on.
+   */
+  void visit(Graph& graph) override;
+
+  /**
+   * @brief Find the shortest paths in the compressed Graph.
+   * @param graph The CSRGraph to operate on.
+   * @throw std::runtime_error If the graph has a cycle of negative weight.
+   */
+  void visit(const CSRGraph& graph) override;
+
+  /**
+   * @brief Getter for the length of the shortest path between two vertices.
+   * @param from The Vertex the path starts at.
+   * @param to The Vertex the path ends at.
+   * @return Sum of the weights along the path; std::numeric_limits<int>::max()
+   * if there's no path.
+   * @throw std::runtime_error If either Vertex wasn't in the Graph.
+   */
+  int distance(const vptr& from, const vptr& to) const;
+
+  /**
+   * @brief Getter for the length of the shortest path between two vertices,
+   * by number.
+   * @param from Number of the Vertex the path starts at.
+   * @param to Number of the Vertex the path ends at.
+   * @return Sum of the weights along the path; std::numeric_limits<int>::max()
+   * if there's no path.
+   */
+  int distance(std::size_t from, std::size_t to) const {
+    return distances_[from * size_ + to];
+  }
+
+  /**
+   * @brief Getter for the number of vertices, i.e. the number of rows and
+   * columns of the matrix.
+   * @return Number of vertices.
+   */
+  std::size_t size() const { return size_; }
+
+  /**
+   * @brief Getter for the distance matrix.
+   * @return The distances, with the row for each source Vertex in turn.
+   */
+  const std::vector<int>& matrix() const { return distances_; }
+
+  /**
+   * @brief Getter for the algorithm used by the last visit. After a visit,
+   * never Method::automatic.
+   * @return The algorithm.
+   */
+  Method method() const { return used_; }
+
+ private:
+  Method method_;
+  Method used_;
+  unsigned threads_ = 0;
+  std::unique_ptr<ThreadPool> owned_;
+  ThreadPool* pool_ = nullptr;
+  std::size_t size_ = 0;
+  std::vector<int> distances_;
+  std::unordered_map<const Vertex*, std::size_t> ids_;
+
+  /**
+   * @brief Implement the blocked Floyd-Warshall algorithm on an input Graph.
+   * @param graph The Graph to search.
+   * @param pool Threads to share the work between.
+   */
+  void floyd_warshall(const CSRGraph& graph, ThreadPool& pool);
+
+  /**
+   * @brief Implement Johnson's algorithm on an input Graph.
+   * @param graph The Graph to search.
+   * @param pool Threads to share the work between.
+   */
+  void johnson(const CSRGraph& graph, ThreadPool& pool);
+};
+
+/**
+ * @brief Visitor for Graph class that finds the shortest paths from a source
+ * to every other Vertex in parallel, for very large graphs with non-negative
+ * weights.
+ *
+ * Uses the delta-stepping algorithm. Tentative distances are sorted into
+ * buckets of width delta, and the buckets are settled in order. Within a
+ * bucket, the light edges (of weight at most delta) out of every Vertex in
+ * it are relaxed at once, in parallel, until the bucket stops refilling; the
+ * heavy edges can't lead back into the bucket, so are relaxed just once from
+ * each Vertex settled in it. A small delta makes this close to Dijkstra's
+ * algorithm, with little parallelism; a large one makes it close to
+ * Bellman-Ford, with plenty of parallelism but wasted relaxations. Only the
+ * buckets that relaxations can still reach are kept, in a cyclic array whose
+ * size depends on the largest weight rather than the longest path, and empty
+ * buckets are skipped over rather than visited in turn.
+ *
+ * Each round of relaxations is shared between the threads of a pool, the
+ * caller's or one the visitor keeps from its first visit on, in small
+ * chunks that idle threads claim as they finish their last, so that threads
+ * given vertices of high degree don't hold up the others. Distances are
+ * lowered with atomic compare-and-swap, so no locks are taken.
+ */
+class GraphDeltaStepping : public GraphVisitor {
+ public:
+  using vptr = std::shared_ptr<Vertex>;
+
+  /**
+   * @brief Class constructor.
+   * @param source Vertex to find the shortest paths from.
+   * @param delta Width of the buckets. If zero, the largest weight divided by
+   * the average degree, which suits graphs with random weights.
+   * @param threads Number of threads to use. If zero, one per hardware thread.
+   */
+  GraphDeltaStepping(const vptr source, int delta = 0, unsigned threads = 0);
+
+  /**
+   * @brief Class constructor, for a visitor using threads shared with others.
+   * @param pool Threads to share the work between; must outlive the visitor.
+   * @param source Vertex to find the shortest paths from.
+   * @param delta Width of the buckets. If zero, the largest weight divided by
+   * the average degree.
+   */
+  GraphDeltaStepping(ThreadPool& pool, const vptr source, int delta = 0);
+
+  /**
+   * @brief Class destructor. Stops the visitor's own threads, if it has any.
+   */
+  ~GraphDeltaStepping();
+
+  /**
+   * @brief Find the shortest paths in the Graph. The Graph is compressed
+   * first.
+   * @param graph The Graph to operate on.
+   */
+  void visit(Graph& graph) override;
+
+  /**
+   * @brief Find the shortest paths in the compressed Graph.
+   * @param graph The CSRGraph to operate on.
+   * @throw std::runtime_error If the source Vertex isn't in the graph, or an
+   * edge has a negative weight.
+   */
+  void visit(const CSRGraph& graph) override;
+
+  /**
+   * @brief Getter for the length of the shortest path to a Vertex.
+   * @param v Number of the Vertex in the CSRGraph; for a Graph, the order in
+   * which it was added.
+   * @return Sum of the weights along the path; std::numeric_limits<int>::max()
+   * if there's no path.
+   */
+  int distance(std::size_t v) const { return distances_[v]; }
+
+  /**
+   * @brief Getter for the lengths of the shortest paths to every Vertex.
+   * @return The distances, indexed by the number of each Vertex.
+   */
+  const std::vector<int>& distances() const { return distances_; }
+
+  /**
+   * @brief Getter for the width of the buckets used by the last visit. After a
+   * visit, never zero.
+   * @return The width.
+   */
+  int delta() const { return used_; }
+
+ private:
+  vptr source_;
+  int delta_;
+  int used_;
+  unsigned threads_ = 0;
+  std::unique_ptr<ThreadPool> owned_;
+  ThreadPool* pool_ = nullptr;
+  std::vector<int> distances_;
 };
 
 }  // namespace hls
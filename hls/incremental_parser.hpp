@@ -0,0 +1,189 @@
+/**
+ * @file incremental_parser.hpp
+ * @author Salvatore Cardamone
+ * @brief Incremental reparsing of an edited Kaleidoscope source buffer.
+ */
+#ifndef __HLS_INCREMENTAL_PARSER_HPP
+#define __HLS_INCREMENTAL_PARSER_HPP
+
+#include <algorithm>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "ast.hpp"
+#include "ast_factory.hpp"
+#include "lexer.hpp"
+#include "parser.hpp"
+#include "symbol_table.hpp"
+
+namespace hls {
+
+/**
+ * @brief Keeps the ASTs of a source buffer up to date as it's edited, e.g. by
+ * an editor, without reparsing the whole buffer on every change.
+ *
+ * The parser records where each of its steps (a top-level definition, extern
+ * or expression, a stray ; or a construct it couldn't parse) begins, and the
+ * end of the token it was left looking at afterwards. A step's outcome depends
+ * on nothing outside that range, and the Lexer can be restarted at the start of
+ * any token. So on an edit, every step whose range ends before the edit is kept
+ * as it is, and lexing and parsing restart at the first step that could have
+ * seen the edit. As soon as the parser arrives at a token past the edit where
+ * an old step began, the parse is back in step with the old one, and that step
+ * and every later one are reused rather than reparsed; only their offsets
+ * shift. The cost of an edit is then proportional to the top-level constructs
+ * it touches, rather than to the size of the buffer.
+ *
+ * A step's outcome also depends on the binary operators defined before it, so
+ * each step records the OperatorTable in effect when it began. Parsing
+ * restarts with the table the first redone step began with, and an old step
+ * is only reused if the table is the same as it was; editing an operator
+ * definition therefore reparses the code that follows it.
+ *
+ * Reused steps keep their original FunctionAST and PrototypeAST nodes, so
+ * anything keyed on them (e.g. generated code) stays valid. Identifiers from
+ * every parse are interned into the same SymbolTable.
+ */
+class IncrementalParser {
+ public:
+  /**
+   * @brief Class constructor. Parses the initial contents of the buffer.
+   * @param source Initial contents of the buffer.
+   * @param factory Factory used to create the AST nodes. An Arena backing it
+   * keeps the nodes of every parse, including those that have since been
+   * replaced.
+   */
+  IncrementalParser(std::string source = "", ASTFactory factory = ASTFactory())
+      : source_{std::move(source)},
+        factory_{std::move(factory)},
+        symbols_{std::make_shared<SymbolTable>()} {
+    reparse(0, 0, 0, 0);
+  }
+
+  /**
+   * @brief Replace part of the buffer and bring the ASTs up to date. Throws
+   * std::out_of_range if the replaced range isn't within the buffer.
+   * @param offset Offset of the first character to replace.
+   * @param length Number of characters to replace; zero for an insertion.
+   * @param text Text to replace them with; empty for a deletion.
+   * @return Number of top-level ASTs that had to be parsed afresh.
+   */
+  std::size_t edit(std::size_t offset, std::size_t length,
+                   std::string_view text) {
+    if (offset > source_.size() || length > source_.size() - offset)
+      throw std::out_of_range("Edit lies outside the source buffer.");
+    source_.replace(offset, length, text);
+
+    // Steps are in order and their ranges only grow, so the first one to reach
+    // the edit is the first one that has to be redone. An edit preceding the
+    // first token (e.g. commenting it out) is only seen from the very start.
+    auto first = std::lower_bound(
+        steps_.begin(), steps_.end(), offset,
+        [](const Step& step, std::size_t offset) { return step.end < offset; });
+    std::size_t index = first - steps_.begin();
+    std::size_t restart =
+        index == 0 || first == steps_.end() ? 0 : first->begin;
+    if (restart == 0) index = 0;
+    return reparse(index, restart, offset + length, offset + text.size());
+  }
+
+  /**
+   * @brief Getter for the current contents of the buffer.
+   * @return The source.
+   */
+  const std::string& source() const { return source_; }
+
+  /**
+   * @brief Getter for the ASTs of the buffer's definitions, externs and
+   * top-level expressions, in order. Constructs that couldn't be parsed are
+   * omitted.
+   * @return The ASTs.
+   */
+  std::vector<std::shared_ptr<AST>> asts() const {
+    std::vector<std::shared_ptr<AST>> asts;
+    for (const auto& step : steps_) {
+      if (step.ast) asts.push_back(step.ast);
+    }
+    return asts;
+  }
+
+ private:
+  /**
+   * @brief A single step of the parser through the buffer.
+   */
+  struct Step {
+    std::size_t begin;         //< Offset of the step's first token
+    std::size_t end;           //< End of the token following the step
+    std::shared_ptr<AST> ast;  //< What was parsed; nullptr if nothing was
+    // Operators in effect at the start of the step; shared between steps
+    // until an operator is defined
+    std::shared_ptr<const OperatorTable> operators;
+  };
+
+  std::string source_;
+  ASTFactory factory_;
+  std::shared_ptr<SymbolTable> symbols_;
+  std::vector<Step> steps_;
+
+  /**
+   * @brief Parse from a step onwards until the parse is back in step with the
+   * previous one, following a replacement in the buffer.
+   * @param index Index of the first step to redo.
+   * @param restart Offset in the buffer to restart at; the beginning of the
+   * step, unless that's the first step.
+   * @param old_end End of the replaced range, before the replacement.
+   * @param new_end End of the replacement.
+   * @return Number of ASTs that were parsed.
+   */
+  std::size_t reparse(std::size_t index, std::size_t restart,
+                      std::size_t old_end, std::size_t new_end) {
+    std::vector<Step> steps(steps_.begin(), steps_.begin() + index);
+    auto candidate = steps_.begin() + index;
+    std::size_t parsed = 0;
+
+    auto operators = index < steps_.size()
+                         ? steps_[index].operators
+                         : std::make_shared<const OperatorTable>();
+    Lexer lexer(std::string_view(source_).substr(restart), symbols_);
+    Parser parser(lexer, factory_, *operators);
+    while (true) {
+      const std::size_t begin = restart + parser.lexer().token_begin();
+      if (parser.operators() != *operators)
+        operators = std::make_shared<const OperatorTable>(parser.operators());
+      if (begin >= new_end) {
+        // Old steps entirely after the edit are only shifted by it
+        auto shifted = [&](std::size_t offset) {
+          return offset - old_end + new_end;
+        };
+        while (candidate != steps_.end() &&
+               (candidate->begin < old_end ||
+                shifted(candidate->begin) < begin)) {
+          ++candidate;
+        }
+        if (candidate != steps_.end() && shifted(candidate->begin) == begin &&
+            *candidate->operators == *operators) {
+          for (; candidate != steps_.end(); ++candidate) {
+            steps.push_back({shifted(candidate->begin), shifted(candidate->end),
+                             candidate->ast, candidate->operators});
+          }
+          break;
+        }
+      }
+      if (parser.eof()) break;
+
+      auto ast = parser.step();
+      if (ast) ++parsed;
+      steps.push_back({begin, restart + parser.lexer().token_end(),
+                       std::move(ast), operators});
+    }
+    steps_ = std::move(steps);
+    return parsed;
+  }
+};
+
+}  // namespace hls
+
+#endif /* #ifndef __HLS_INCREMENTAL_PARSER_HPP */
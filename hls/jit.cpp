@@ -0,0 +1,256 @@
+/**
+ * @file jit.cpp
+ * @author Salvatore Cardamone
+ * @brief Just-in-time execution of Kaleidoscope code.
+ */
+#include "jit.hpp"
+
+#include <llvm/ExecutionEngine/Orc/CompileUtils.h>
+#include <llvm/ExecutionEngine/Orc/ExecutionUtils.h>
+#include <llvm/ExecutionEngine/Orc/LLJIT.h>
+#include <llvm/ExecutionEngine/Orc/ThreadSafeModule.h>
+#include <llvm/Support/Error.h>
+#include <llvm/Support/TargetSelect.h>
+
+#include <mutex>
+#include <stdexcept>
+#include <utility>
+
+#include "arena.hpp"
+#include "ast.hpp"
+#include "ast_factory.hpp"
+#include "compile_cache.hpp"
+#include "lexer.hpp"
+#include "parser.hpp"
+
+namespace hls {
+
+namespace {
+
+/**
+ * @brief Unwrap an llvm::Expected, converting any error into an exception.
+ * @param expected The value or error.
+ * @param what Description of what was being attempted, for the exception.
+ * @return The value.
+ */
+template <typename T>
+T unwrap(llvm::Expected<T> expected, const std::string& what) {
+  if (!expected) {
+    throw std::runtime_error(what + ": " +
+                             llvm::toString(expected.takeError()));
+  }
+  return std::move(*expected);
+}
+
+/**
+ * @brief Convert an llvm::Error into an exception, if it's an error at all.
+ * @param error The error.
+ * @param what Description of what was being attempted, for the exception.
+ */
+void check(llvm::Error error, const std::string& what) {
+  if (error)
+    throw std::runtime_error(what + ": " + llvm::toString(std::move(error)));
+}
+
+/**
+ * @brief Hand a module over to the JIT.
+ * @param jit The JIT.
+ * @param module The module and its context.
+ * @param tracker Tracker to add the module under, so that it can be removed
+ * later; if nullptr, the module stays resident for good.
+ */
+void add_module(llvm::orc::LLJIT& jit, CodegenModule module,
+                llvm::orc::ResourceTrackerSP tracker = nullptr) {
+  llvm::orc::ThreadSafeModule tsm(std::move(module.module),
+                                  std::move(module.context));
+  if (!tracker) tracker = jit.getMainJITDylib().getDefaultResourceTracker();
+  check(jit.addIRModule(tracker, std::move(tsm)), "Couldn't add module to JIT");
+}
+
+}  // namespace
+
+class JIT::FunctionUnit : public llvm::orc::MaterializationUnit {
+ public:
+  /**
+   * @brief Class constructor.
+   * @param jit The JIT that the function is being defined in.
+   * @param function The function definition.
+   */
+  FunctionUnit(JIT& jit, std::shared_ptr<FunctionAST> function)
+      : MaterializationUnit(Interface(
+            llvm::orc::SymbolFlagsMap{
+                {jit.jit_->mangleAndIntern(function->proto()->name()),
+                 llvm::JITSymbolFlags::Exported |
+                     llvm::JITSymbolFlags::Callable}},
+            nullptr)),
+        jit_{jit},
+        function_{std::move(function)} {}
+
+  llvm::StringRef getName() const override { return "FunctionUnit"; }
+
+  /**
+   * @brief Generate the function and hand it on to be compiled. Called by ORC
+   * the first time the function's symbol is looked up.
+   * @param responsibility The symbols we're responsible for providing.
+   */
+  void materialize(std::unique_ptr<llvm::orc::MaterializationResponsibility>
+                       responsibility) override {
+    CodegenModule module;
+    try {
+      module = jit_.generate(*function_, function_->proto()->name());
+      ++jit_.functions_generated_;
+    } catch (const std::runtime_error& e) {
+      jit_.jit_->getExecutionSession().reportError(
+          llvm::make_error<llvm::StringError>(e.what(),
+                                              llvm::inconvertibleErrorCode()));
+      responsibility->failMaterialization();
+      return;
+    }
+    // We're past the JIT's usual entry point for modules, so have to apply
+    // the target's data layout ourselves
+    module.module->setDataLayout(jit_.jit_->getDataLayout());
+    jit_.jit_->getIRTransformLayer().emit(
+        std::move(responsibility),
+        llvm::orc::ThreadSafeModule(std::move(module.module),
+                                    std::move(module.context)));
+    // Nobody else will need the AST now
+    function_.reset();
+  }
+
+ private:
+  JIT& jit_;
+  std::shared_ptr<FunctionAST> function_;
+
+  /**
+   * @brief Called if the function is overridden before it's materialised,
+   * which can't happen since duplicate definitions are rejected.
+   */
+  void discard(const llvm::orc::JITDylib&,
+               const llvm::orc::SymbolStringPtr&) override {}
+};
+
+JIT::JIT(CodegenOptions options, bool lazy)
+    : diagnostics_{options.diagnostics, "jit"},
+      codegen_{"jit", false, options},
+      lazy_{lazy},
+      arena_{std::make_shared<Arena>()} {
+  static std::once_flag native_target;
+  std::call_once(native_target, [] {
+    llvm::InitializeNativeTarget();
+    llvm::InitializeNativeTargetAsmPrinter();
+  });
+
+  llvm::orc::LLJITBuilder builder;
+  if (options.cache) {
+    // Look for each module's machine code in the cache before compiling it
+    builder.setCompileFunctionCreator(
+        [this, cache = options.cache](
+            llvm::orc::JITTargetMachineBuilder target)
+            -> llvm::Expected<
+                std::unique_ptr<llvm::orc::IRCompileLayer::IRCompiler>> {
+          auto machine = target.createTargetMachine();
+          if (!machine) return machine.takeError();
+          objects_ = std::make_unique<TargetObjectCache>(
+              cache, target.getTargetTriple().str(), target.getCPU(),
+              target.getFeatures().getString());
+          return std::make_unique<llvm::orc::TMOwningSimpleCompiler>(
+              std::move(*machine), objects_.get());
+        });
+  }
+  jit_ = unwrap(builder.create(), "Couldn't create JIT");
+  // Functions generated lazily fail while ORC is looking up a symbol, which
+  // reports the error here rather than to the caller; by default it's printed
+  jit_->getExecutionSession().setErrorReporter([this](llvm::Error error) {
+    diagnostics_.error(llvm::toString(std::move(error)));
+  });
+  // Resolve anything we can't find in the JIT against the host process
+  jit_->getMainJITDylib().addGenerator(
+      unwrap(llvm::orc::DynamicLibrarySearchGenerator::GetForCurrentProcess(
+                 jit_->getDataLayout().getGlobalPrefix()),
+             "Couldn't search host process for symbols"));
+}
+
+JIT::~JIT() {}
+
+void JIT::declare(PrototypeAST& proto) {
+  // Just needs to be known to the codegen, which declares it in whichever
+  // module calls it
+  proto.accept(codegen_);
+}
+
+void JIT::define(std::shared_ptr<FunctionAST> function) {
+  if (!lazy_) {
+    add_module(*jit_, generate(*function, function->proto()->name()));
+    ++functions_generated_;
+    return;
+  }
+  // Callers need to know the signature to declare the function before it's
+  // been generated
+  declare(*function->proto());
+  check(jit_->getMainJITDylib().define(
+            std::make_unique<FunctionUnit>(*this, std::move(function))),
+        "Couldn't define function");
+}
+
+double JIT::evaluate(const std::shared_ptr<FunctionAST>& top_level) {
+  // Give the expression a name we can look it up by; the body shares
+  // ownership of the AST it came from, which may be in an Arena
+  FunctionAST anonymous(
+      std::make_shared<PrototypeAST>("__anon_expr", std::vector<std::string>()),
+      std::shared_ptr<ExprAST>(top_level, top_level->body()));
+  CodegenModule module = generate(anonymous, "__anon_expr");
+
+  // Track the expression's module separately so that we can free it once it's
+  // been run; the functions it calls stay resident
+  auto tracker = jit_->getMainJITDylib().createResourceTracker();
+  add_module(*jit_, std::move(module), tracker);
+  auto symbol = jit_->lookup("__anon_expr");
+  if (!symbol) {
+    // Leave the way clear for the next expression
+    llvm::consumeError(tracker->remove());
+    throw std::runtime_error("Couldn't compile top-level expression: " +
+                             llvm::toString(symbol.takeError()));
+  }
+  auto* expr = reinterpret_cast<double (*)()>(symbol->getAddress());
+  double result = expr();
+  check(tracker->remove(), "Couldn't free top-level expression");
+  return result;
+}
+
+CodegenModule JIT::generate(FunctionAST& function, const std::string& name) {
+  function.accept(codegen_);
+  auto* generated = codegen_.module().getFunction(name);
+  if (!generated || generated->isDeclaration()) {
+    codegen_.release_module();
+    throw std::runtime_error("Couldn't generate IR for function " + name);
+  }
+  return codegen_.release_module();
+}
+
+std::vector<double> JIT::run(std::string_view source) {
+  Lexer lexer(source);
+  // Lazily-defined functions hold onto their ASTs until they're generated
+  Parser parser(lexer,
+                ASTFactory(lazy_ ? arena_ : std::make_shared<Arena>()),
+                operators_);
+  std::vector<double> results;
+  while (!parser.eof()) {
+    auto ast = parser.step();
+    if (!ast) continue;
+    if (ast->kind() == ASTKind::prototype) {
+      declare(static_cast<PrototypeAST&>(*ast));
+      continue;
+    }
+    auto function = std::static_pointer_cast<FunctionAST>(ast);
+    if (function->proto()->name().empty()) {
+      results.push_back(evaluate(function));
+    } else {
+      define(std::move(function));
+    }
+  }
+  // Operators defined here can be used by later code
+  operators_ = parser.operators();
+  return results;
+}
+
+}  // namespace hls
@@ -0,0 +1,145 @@
+/**
+ * @file jit.hpp
+ * @author Salvatore Cardamone
+ * @brief Just-in-time execution of Kaleidoscope code.
+ */
+#ifndef __HLS_JIT_HPP
+#define __HLS_JIT_HPP
+
+#include <memory>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "ast_visitor.hpp"
+#include "parser.hpp"
+
+namespace llvm::orc {
+class LLJIT;
+}  // namespace llvm::orc
+
+namespace hls {
+
+class AST;
+class Arena;
+class FunctionAST;
+class PrototypeAST;
+class TargetObjectCache;
+
+/**
+ * @brief Execution engine for Kaleidoscope built on ORC's LLJIT.
+ *
+ * Every definition is generated (and optimised) into a module of its own and
+ * handed to the JIT, which only compiles it to machine code the first time
+ * one of its symbols is looked up, i.e. when something that calls it is first
+ * evaluated. Compiled functions stay resident, so later evaluations reuse them
+ * rather than compiling anything again. Top-level expressions are compiled as
+ * a function named __anon_expr, called, and then thrown away.
+ *
+ * In lazy mode, not even IR is generated for a definition up front. The JIT
+ * just records the AST, and the function is generated, optimised and compiled
+ * when its symbol is first looked up, i.e. when the first expression (or
+ * function) that calls it is compiled. Work is then proportional to the
+ * functions that are actually reachable from what's evaluated, rather than
+ * to everything that's been defined.
+ *
+ * Extern declarations without a definition resolve against symbols in the
+ * host process, so e.g. sin and cos from libm can be called.
+ *
+ * A JIT may only be used by one thread at a time.
+ */
+class JIT {
+ public:
+  /**
+   * @brief Class constructor. Throws std::runtime_error if the JIT can't be
+   * created for the host.
+   * @param options How to optimise the generated IR, and where to report
+   * errors, including those generating functions lazily. If there's a cache,
+   * it's used for machine code as well as optimised functions.
+   * @param lazy Whether to defer generating each function until it's first
+   * needed.
+   */
+  JIT(CodegenOptions options = CodegenOptions(), bool lazy = false);
+
+  /**
+   * @brief Class destructor. Out of line since LLJIT is only forward-declared
+   * here.
+   */
+  ~JIT();
+
+  JIT(const JIT&) = delete;
+  JIT& operator=(const JIT&) = delete;
+
+  /**
+   * @brief Declare an external function, e.g. one from the host process.
+   * @param proto Prototype of the function.
+   */
+  void declare(PrototypeAST& proto);
+
+  /**
+   * @brief Define a function so that later evaluations can call it. Throws
+   * std::runtime_error if the function has already been defined, or if IR
+   * can't be generated for it; in lazy mode, the latter is only discovered
+   * when something calling the function is evaluated.
+   * @param function The function definition. In lazy mode the JIT holds onto
+   * this until the function is generated, so if it lives in an Arena then the
+   * Arena must outlive the JIT.
+   */
+  void define(std::shared_ptr<FunctionAST> function);
+
+  /**
+   * @brief Evaluate a top-level expression.
+   * @param top_level The expression, wrapped in an anonymous function as
+   * returned by the Parser.
+   * @return Value of the expression. Throws std::runtime_error if the
+   * expression can't be compiled, e.g. because it calls an undefined function.
+   */
+  double evaluate(const std::shared_ptr<FunctionAST>& top_level);
+
+  /**
+   * @brief Parse source code and handle each of its declarations, definitions
+   * and top-level expressions in turn. In lazy mode the ASTs are kept for the
+   * lifetime of the JIT. Binary operators defined by earlier calls are
+   * recognised.
+   * @param source The source code.
+   * @return Values of the top-level expressions, in order.
+   */
+  std::vector<double> run(std::string_view source);
+
+  /**
+   * @brief Getter for the number of function definitions that IR has been
+   * generated for, excluding top-level expressions.
+   * @return Number of functions generated.
+   */
+  std::size_t functions_generated() const { return functions_generated_; }
+
+ private:
+  // Defers generating a function until its symbol is looked up
+  class FunctionUnit;
+
+  // Where the JIT looks for machine code before compiling; must outlive it
+  std::unique_ptr<TargetObjectCache> objects_;
+  // Where errors raised within the JIT are reported; must outlive it too
+  DiagnosticEngine diagnostics_;
+  std::unique_ptr<llvm::orc::LLJIT> jit_;
+  ASTCodegen codegen_;
+  bool lazy_;
+  // Holds the ASTs parsed by run() while they wait to be generated
+  std::shared_ptr<Arena> arena_;
+  // Binary operators defined by the code run so far
+  OperatorTable operators_;
+  std::size_t functions_generated_ = 0;
+
+  /**
+   * @brief Generate IR for a function.
+   * @param function The function.
+   * @param name Name to give the function in the IR.
+   * @return Module containing the function. Throws std::runtime_error if IR
+   * can't be generated for the function.
+   */
+  CodegenModule generate(FunctionAST& function, const std::string& name);
+};
+
+}  // namespace hls
+
+#endif /* #ifndef __HLS_JIT_HPP */
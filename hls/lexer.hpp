@@ -6,9 +6,17 @@
 #ifndef __HLS_LEXER_HPP
 #define __HLS_LEXER_HPP
 
+#include <array>
 #include <iostream>
+#include <memory>
 #include <optional>
 #include <string>
+#include <string_view>
+
+#include "diagnostics.hpp"
+#include "scan.hpp"
+#include "source_manager.hpp"
+#include "symbol_table.hpp"
 
 namespace hls {
 
@@ -99,7 +107,14 @@ static std::ostream& operator<<(std::ostream& os, const TokenType& type) {
  * and identified as being of that type.
  *
  * Note that the associated string is stored as std::optional since certain
- * token types are fully descriptive of the token value (e.g. keywords).
+ * token types are fully descriptive of the token value (e.g. keywords). Tokens
+ * lexed from a contiguous buffer don't own their string at all; they just
+ * reference the source, which must outlive them.
+ *
+ * Identifier Tokens additionally carry the Symbol the Lexer interned them as,
+ * and Tokens lexed from a buffer registered with a SourceManager carry the
+ * SourceOffset of their first character. The offset fits in what would
+ * otherwise be padding, so costs nothing.
  */
 class Token {
  public:
@@ -110,17 +125,37 @@ class Token {
    * @param type Type of token that was lexed.
    * @param value Value of the token that was lexed. Default initialised as
    * std::nullopt.
+   * @param symbol Interned Symbol of the token, if it's an identifier.
    */
-  Token(TokenType&& type, std::optional<std::string> value = std::nullopt)
-      : type_{std::move(type)}, value_{std::move(value)} {}
+  Token(TokenType&& type, std::optional<std::string> value = std::nullopt,
+        Symbol symbol = no_symbol)
+      : type_{std::move(type)}, value_{std::move(value)}, symbol_{symbol} {}
+
+  /**
+   * @brief Construct a Token that references its value in the source buffer
+   * rather than owning a copy of it.
+   * @param type Type of token that was lexed.
+   * @param source View of the token value in the source buffer.
+   * @param symbol Interned Symbol of the token, if it's an identifier.
+   * @return The non-owning Token.
+   */
+  static Token from_source(TokenType type, std::string_view source,
+                           Symbol symbol = no_symbol) {
+    Token token;
+    token.type_ = type;
+    token.source_ = source;
+    token.symbol_ = symbol;
+    return token;
+  }
 
   /**
-   * @brief Equality comparison operator.
+   * @brief Equality comparison operator. Where the Tokens came from doesn't
+   * matter.
    * @param rhs RHS Token to the equality condition.
    * @return True if Tokens are elementwise equal, otherwise False.
    */
   bool operator==(const Token& rhs) const {
-    return type() == rhs.type() && value() == rhs.value();
+    return type() == rhs.type() && view() == rhs.view();
   }
 
   /**
@@ -130,14 +165,47 @@ class Token {
   const TokenType& type() const { return type_; }
 
   /**
-   * @brief Getter for the Token value.
+   * @brief Getter for the Token value. Always returns an owning copy.
    * @return Value of the Token.
    */
-  const std::string value() const { return value_.value_or(""); }
+  const std::string value() const {
+    return value_ ? *value_ : std::string(source_);
+  }
+
+  /**
+   * @brief Getter for a view of the Token value; doesn't allocate.
+   * @return View of the Token value, valid for as long as the Token (and, for
+   * Tokens lexed from a buffer, the source) lives.
+   */
+  std::string_view view() const {
+    return value_ ? std::string_view(*value_) : source_;
+  }
+
+  /**
+   * @brief Getter for the interned Symbol of an identifier Token.
+   * @return The Symbol, or no_symbol if the Token isn't an identifier.
+   */
+  Symbol symbol() const { return symbol_; }
+
+  /**
+   * @brief Getter for where the Token came from.
+   * @return Offset of the Token's first character, or no_offset if it wasn't
+   * lexed from a registered buffer.
+   */
+  SourceOffset offset() const { return offset_; }
+
+  /**
+   * @brief Record where the Token came from.
+   * @param offset Offset of the Token's first character.
+   */
+  void set_offset(SourceOffset offset) { offset_ = offset; }
 
  private:
   TokenType type_;
+  SourceOffset offset_ = no_offset;
   std::optional<std::string> value_;
+  std::string_view source_;
+  Symbol symbol_ = no_symbol;
 };
 
 /**
@@ -148,56 +216,213 @@ class Token {
  */
 static std::ostream& operator<<(std::ostream& os, const Token& token) {
   os << token.type();
-  if (token.value() != "") os << ", Value: " << token.value();
+  if (!token.view().empty()) os << ", Value: " << token.view();
   return os;
 }
 
+/**
+ * @brief A language keyword and the TokenType it's lexed as.
+ */
+struct Keyword {
+  std::string_view spelling;
+  TokenType type = TokenType::tok_none;
+};
+
+/**
+ * @brief All keywords in the Kaleidoscope language.
+ */
+inline constexpr std::array<Keyword, 7> keywords{{
+    {"def", TokenType::tok_def},
+    {"extern", TokenType::tok_extern},
+    {"if", TokenType::tok_if},
+    {"then", TokenType::tok_then},
+    {"else", TokenType::tok_else},
+    {"for", TokenType::tok_for},
+    {"in", TokenType::tok_in},
+}};
+
+/**
+ * @brief Hash for keyword lookup. Perfect over the keyword list (checked at
+ * compile-time below), so identifying a keyword costs a single comparison.
+ * @param identifier The non-empty identifier to hash.
+ * @return Slot in the keyword table.
+ */
+constexpr std::size_t keyword_hash(std::string_view identifier) {
+  return (2 * identifier.size() + static_cast<unsigned char>(identifier[0]) +
+          static_cast<unsigned char>(identifier[identifier.size() - 1])) &
+         15;
+}
+
+/**
+ * @brief Build the keyword table, with every keyword placed in the slot given
+ * by its hash. Unused slots hold an empty spelling.
+ * @return The keyword table.
+ */
+constexpr std::array<Keyword, 16> make_keyword_table() {
+  std::array<Keyword, 16> table{};
+  for (const auto& keyword : keywords) {
+    table[keyword_hash(keyword.spelling)] = keyword;
+  }
+  return table;
+}
+
+inline constexpr std::array<Keyword, 16> keyword_table = make_keyword_table();
+
+/**
+ * @brief Check that every keyword survived construction of the table, i.e.
+ * that the hash has no collisions.
+ * @return True if the hash is perfect over the keyword list.
+ */
+constexpr bool keyword_hash_is_perfect() {
+  for (const auto& keyword : keywords) {
+    if (keyword_table[keyword_hash(keyword.spelling)].type != keyword.type)
+      return false;
+  }
+  return true;
+}
+static_assert(keyword_hash_is_perfect(),
+              "Keyword hash has collisions; the keyword list has changed and "
+              "keyword_hash() needs retuning.");
+
 /**
  * @brief Lexical analysis of the Kaleidoscope language.
+ *
+ * The Lexer operates in one of two modes; either it pulls characters one at a
+ * time from an input stream, building an owning Token for each lexeme, or it
+ * scans a contiguous buffer (e.g. a MappedFile) and returns Tokens which
+ * reference the buffer without any per-token allocation.
+ *
+ * In both modes identifiers can be interned into a SymbolTable, so that they
+ * can be compared by Symbol further down the line. Interning costs a hash
+ * table lookup per identifier, so only happens if the Lexer is given a table
+ * to intern into. The table is shared between copies of the Lexer, and may be
+ * shared between Lexers.
+ *
+ * Problems with the input are reported through a DiagnosticEngine, which is
+ * likewise shared between copies of the Lexer; the Parser reports through the
+ * same engine. Only a Lexer over a buffer knows where its tokens lie, and if
+ * the buffer has been registered with a SourceManager then its Tokens carry
+ * their SourceOffsets, which the Parser passes on to the AST.
  */
 class Lexer {
  public:
   /**
    * @brief Class constructor.
    * @param input Input stream to tokenise.
+   * @param symbols Table to intern identifiers into. If none is provided,
+   * identifiers aren't interned, and carry no_symbol.
+   * @param diagnostics Engine to report problems through. If none is provided,
+   * they're discarded.
+   */
+  Lexer(std::istream& input, std::shared_ptr<SymbolTable> symbols = nullptr,
+        std::shared_ptr<DiagnosticEngine> diagnostics = nullptr)
+      : input_{&input},
+        symbols_{std::move(symbols)},
+        diagnostics_{diagnostic_engine(std::move(diagnostics))} {}
+
+  /**
+   * @brief Class constructor for zero-copy lexing of a contiguous buffer.
+   * @param source Buffer to tokenise. Must outlive the Lexer and every Token
+   * returned from it.
+   * @param symbols Table to intern identifiers into. If none is provided,
+   * identifiers aren't interned, and carry no_symbol.
+   * @param diagnostics Engine to report problems through. If none is provided,
+   * they're discarded.
+   * @param base Offset of the buffer's first character, as returned by
+   * SourceManager::add; if no_offset, Tokens aren't given offsets.
+   */
+  Lexer(std::string_view source, std::shared_ptr<SymbolTable> symbols = nullptr,
+        std::shared_ptr<DiagnosticEngine> diagnostics = nullptr,
+        SourceOffset base = no_offset)
+      : source_{source},
+        base_{base},
+        symbols_{std::move(symbols)},
+        diagnostics_{diagnostic_engine(std::move(diagnostics))} {}
+
+  /**
+   * @brief Getter for the table that identifiers are interned into.
+   * @return The SymbolTable, or nullptr if identifiers aren't interned.
    */
-  Lexer(std::istream& input) : input_{input} {}
+  const std::shared_ptr<SymbolTable>& symbols() const { return symbols_; }
 
   /**
-   * @brief Retrieve a token from the input stream.
-   * @param input The input stream to lex from.
-   * @return The next Token parsed from the input stream.
+   * @brief Getter for the engine that problems with the input are reported
+   * through.
+   * @return The DiagnosticEngine.
+   */
+  const std::shared_ptr<DiagnosticEngine>& diagnostics() const {
+    return diagnostics_;
+  }
+
+  /**
+   * @brief Find the line and column of the most recent token, for reporting
+   * diagnostics.
+   * @return Location of the token; unknown when lexing a stream.
+   */
+  SourceLocation location() const {
+    if (input_) return SourceLocation();
+    // Diagnostics mostly come in source order, so carry on counting lines
+    // from wherever the last request left off
+    if (token_begin_ < line_scanned_) {
+      line_scanned_ = line_start_ = 0;
+      line_ = 1;
+    }
+    for (; line_scanned_ < token_begin_; ++line_scanned_) {
+      if (source_[line_scanned_] == '\n') {
+        ++line_;
+        line_start_ = line_scanned_ + 1;
+      }
+    }
+    return {static_cast<std::uint32_t>(line_),
+            static_cast<std::uint32_t>(token_begin_ - line_start_ + 1)};
+  }
+
+  /**
+   * @brief Getter for where the most recent token starts in the source buffer.
+   * Only meaningful when lexing a buffer.
+   * @return Offset of the token's first character; the size of the buffer for
+   * the EOF token.
+   */
+  std::size_t token_begin() const { return token_begin_; }
+
+  /**
+   * @brief Getter for where the most recent token ends in the source buffer.
+   * Only meaningful when lexing a buffer.
+   * @return Offset one past the token's last character.
+   */
+  std::size_t token_end() const { return pos_; }
+
+  /**
+   * @brief Retrieve a token from the input.
+   * @return The next Token parsed from the input.
    */
   Token get_token() {
+    if (!input_) {
+      Token token = get_source_token();
+      if (base_ != no_offset)
+        token.set_offset(base_ + static_cast<SourceOffset>(token_begin_));
+      return token;
+    }
+
     // Eat any whitespace (including tabs, newlines and spaces)
-    while (isspace(last_char_)) last_char_ = input_.get();
+    while (isspace(last_char_)) last_char_ = input_->get();
 
     // If the character is alphabetical, it's either an identifier or
     // language keyword, so consume all subsequent alphanumerical characters
     if (isalpha(last_char_)) {
       std::string identifier_string(1, last_char_);
-      while (isalnumuscore(last_char_ = input_.get())) {
+      while (isalnumuscore(last_char_ = input_->get())) {
         identifier_string += last_char_;
       }
 
       // Handle any keywords
-      if (identifier_string == "def") {
-        return Token(TokenType::tok_def);
-      } else if (identifier_string == "extern") {
-        return Token(TokenType::tok_extern);
-      } else if (identifier_string == "if") {
-        return Token(TokenType::tok_if);
-      } else if (identifier_string == "then") {
-        return Token(TokenType::tok_then);
-      } else if (identifier_string == "else") {
-        return Token(TokenType::tok_else);
-      } else if (identifier_string == "for") {
-	return Token(TokenType::tok_for);
-      } else if (identifier_string == "in") {
-	return Token(TokenType::tok_in);
-      }
+      TokenType type = keyword(identifier_string);
+      if (type != TokenType::tok_identifier) return Token(std::move(type));
       // If the token wasn't a keyword, it was an identifier
-      return Token(TokenType::tok_identifier, identifier_string);
+      Symbol symbol =
+          symbols_ ? symbols_->intern(identifier_string) : no_symbol;
+      return Token(TokenType::tok_identifier, std::move(identifier_string),
+                   symbol);
     }
 
     // If the character is numerical, it's a numerical constant of some
@@ -206,8 +431,9 @@ class Lexer {
       std::string numerical_string;
       do {
         numerical_string += last_char_;
-        last_char_ = input_.get();
+        last_char_ = input_->get();
       } while (isdigit(last_char_) || last_char_ == '.');
+      check_number(numerical_string);
       // Return a numerical token
       return Token(TokenType::tok_number, numerical_string);
     }
@@ -215,7 +441,7 @@ class Lexer {
     // If the character indicates a comment, consume the entire line
     if (last_char_ == '#') {
       do {
-        last_char_ = input_.get();
+        last_char_ = input_->get();
       } while (last_char_ != EOF && last_char_ != '\n' && last_char_ != '\r');
       // Recursively call this method so we can return a token if we didn't
       // reach the end-of-file
@@ -230,13 +456,123 @@ class Lexer {
     // character, so this must correspond to an operator of some kind that we
     // can return as a token comprising a single character
     std::string this_char(1, last_char_);
-    last_char_ = input_.get();
+    last_char_ = input_->get();
     return Token(TokenType::tok_operator, this_char);
   }
 
  private:
   int last_char_ = ' ';
-  std::istream& input_;
+  std::istream* input_ = nullptr;
+  std::string_view source_;
+  SourceOffset base_ = no_offset;
+  std::size_t pos_ = 0;
+  std::size_t token_begin_ = 0;
+  std::shared_ptr<SymbolTable> symbols_;
+  std::shared_ptr<DiagnosticEngine> diagnostics_;
+  // How far location() has counted lines, and where the last line began
+  mutable std::size_t line_scanned_ = 0;
+  mutable std::size_t line_start_ = 0;
+  mutable std::size_t line_ = 1;
+
+  /**
+   * @brief Use the provided DiagnosticEngine, or create one that discards
+   * everything if there wasn't one.
+   * @param diagnostics The provided DiagnosticEngine, possibly nullptr.
+   * @return The DiagnosticEngine to use.
+   */
+  static std::shared_ptr<DiagnosticEngine> diagnostic_engine(
+      std::shared_ptr<DiagnosticEngine> diagnostics) {
+    return diagnostics ? std::move(diagnostics)
+                       : std::make_shared<DiagnosticEngine>();
+  }
+
+  /**
+   * @brief Report a numerical constant with more than one decimal point, which
+   * the lexer accepts as a single token.
+   * @param number The numerical constant.
+   */
+  void check_number(std::string_view number) {
+    auto point = number.find('.');
+    if (point != std::string_view::npos &&
+        number.find('.', point + 1) != std::string_view::npos) {
+      diagnostics_->error("Malformed numerical constant " +
+                              std::string(number) + ".",
+                          location());
+    }
+  }
+
+  /**
+   * @brief Retrieve a token from the source buffer. Follows exactly the same
+   * rules as the stream lexer, but Tokens reference the buffer rather than
+   * copying out of it.
+   * @return The next Token parsed from the source buffer.
+   */
+  Token get_source_token() {
+    const std::size_t size = source_.size();
+
+    // Eat any whitespace and comments preceding the token; these are
+    // classified a vector register at a time
+    const char* data = source_.data();
+    while (true) {
+      pos_ = scan::skip_whitespace(data, pos_, size);
+      if (pos_ >= size || data[pos_] != '#') break;
+      pos_ = scan::find_line_end(data, pos_, size);
+    }
+
+    if (pos_ >= size) {
+      token_begin_ = pos_ = size;
+      return Token(TokenType::tok_eof);
+    }
+
+    const std::size_t begin = token_begin_ = pos_;
+
+    // Identifiers and keywords
+    if (isalpha(at(pos_))) {
+      pos_ = scan::skip_identifier(data, pos_ + 1, size);
+      std::string_view identifier = source_.substr(begin, pos_ - begin);
+      TokenType type = keyword(identifier);
+      if (type != TokenType::tok_identifier) return Token(std::move(type));
+      return Token::from_source(
+          TokenType::tok_identifier, identifier,
+          symbols_ ? symbols_->intern(identifier) : no_symbol);
+    }
+
+    // Numerical constants
+    if (isdigit(at(pos_)) || at(pos_) == '.') {
+      while (++pos_ < size && (isdigit(at(pos_)) || at(pos_) == '.')) {
+      }
+      std::string_view number = source_.substr(begin, pos_ - begin);
+      check_number(number);
+      return Token::from_source(TokenType::tok_number, number);
+    }
+
+    // Single-character operators
+    ++pos_;
+    return Token::from_source(TokenType::tok_operator,
+                              source_.substr(begin, 1));
+  }
+
+  /**
+   * @brief Retrieve a character from the source buffer in a form that's safe
+   * to pass to the <cctype> classification functions.
+   * @param idx Index into the source buffer.
+   * @return The character as an unsigned value.
+   */
+  int at(std::size_t idx) const {
+    return static_cast<unsigned char>(source_[idx]);
+  }
+
+  /**
+   * @brief Identify whether an identifier is a language keyword.
+   * @param identifier The identifier to check.
+   * @return The keyword TokenType, or tok_identifier if the identifier isn't a
+   * keyword.
+   */
+  static TokenType keyword(std::string_view identifier) {
+    const Keyword& candidate = keyword_table[keyword_hash(identifier)];
+    return candidate.spelling == identifier ? candidate.type
+                                            : TokenType::tok_identifier;
+  }
 
   /**
    * @brief Check whether a character is alphanumerical or an underscore.
@@ -244,7 +580,7 @@ class Lexer {
    * @return True if the character is alphanumerical or an underscore, false
    * otherwise.
    */
-  bool isalnumuscore(int& input_char) {
+  static bool isalnumuscore(int input_char) {
     return isalnum(input_char) || input_char == '_';
   }
 };
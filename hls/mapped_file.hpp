@@ -0,0 +1,95 @@
+/**
+ * @file mapped_file.hpp
+ * @author Salvatore Cardamone
+ * @brief Read-only memory-mapping of source files.
+ */
+#ifndef __HLS_MAPPED_FILE_HPP
+#define __HLS_MAPPED_FILE_HPP
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <stdexcept>
+#include <string>
+#include <string_view>
+
+namespace hls {
+
+/**
+ * @brief RAII wrapper around a read-only memory-mapped file. The mapped
+ * contents can be handed to the Lexer as a contiguous buffer, so that tokens
+ * can reference the source directly rather than copying it.
+ */
+class MappedFile {
+ public:
+  /**
+   * @brief Class constructor. Maps the entirety of the file into memory.
+   * @param path Path to the file to map.
+   * @throw std::runtime_error If the file can't be opened or mapped.
+   */
+  MappedFile(const std::string& path) {
+    int fd = ::open(path.c_str(), O_RDONLY);
+    if (fd < 0) {
+      throw std::runtime_error("Couldn't open " + path + " for mapping.");
+    }
+
+    struct stat file_stat;
+    if (::fstat(fd, &file_stat) != 0) {
+      ::close(fd);
+      throw std::runtime_error("Couldn't stat " + path + ".");
+    }
+    size_ = static_cast<std::size_t>(file_stat.st_size);
+
+    // mmap refuses zero-length mappings, so an empty file is just an empty
+    // view
+    if (size_ > 0) {
+      void* data = ::mmap(nullptr, size_, PROT_READ, MAP_PRIVATE, fd, 0);
+      if (data == MAP_FAILED) {
+        ::close(fd);
+        throw std::runtime_error("Couldn't map " + path + " into memory.");
+      }
+      data_ = static_cast<const char*>(data);
+      // We'll be streaming through the file front-to-back
+      ::madvise(data, size_, MADV_SEQUENTIAL);
+    }
+    // The mapping persists after the descriptor is closed
+    ::close(fd);
+  }
+
+  /**
+   * @brief Class destructor. Unmaps the file.
+   */
+  ~MappedFile() {
+    if (data_) ::munmap(const_cast<char*>(data_), size_);
+  }
+
+  // The mapping is uniquely owned, so forbid copies but permit moves
+  MappedFile(const MappedFile&) = delete;
+  MappedFile& operator=(const MappedFile&) = delete;
+  MappedFile(MappedFile&& rhs) noexcept : data_{rhs.data_}, size_{rhs.size_} {
+    rhs.data_ = nullptr;
+    rhs.size_ = 0;
+  }
+
+  /**
+   * @brief Getter for the mapped file contents.
+   * @return View over the entire file. Only valid while this object lives.
+   */
+  std::string_view contents() const { return {data_, size_}; }
+
+  /**
+   * @brief Getter for the size of the mapped file.
+   * @return Size of the file in bytes.
+   */
+  std::size_t size() const { return size_; }
+
+ private:
+  const char* data_ = nullptr;
+  std::size_t size_ = 0;
+};
+
+}  // namespace hls
+
+#endif /* #ifndef __HLS_MAPPED_FILE_HPP */
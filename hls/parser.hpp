@@ -6,46 +6,208 @@
 #ifndef __HLS_PARSER_HPP
 #define __HLS_PARSER_HPP
 
-#include <map>
+#include <array>
+#include <cctype>
+#include <iterator>
 #include <memory>
+#include <stdexcept>
 #include <string>
+#include <utility>
 #include <vector>
 
 #include "ast.hpp"
+#include "ast_factory.hpp"
 #include "lexer.hpp"
 
 namespace hls {
 
+/**
+ * @brief Precedences of the binary operators, both built-in and user-defined.
+ *
+ * Operators are single characters, so the table is a dense array indexed by
+ * the character; looking up a token's precedence is a single load, with no
+ * hashing or string comparison, and characters that aren't binary operators
+ * simply hold -1.
+ */
+class OperatorTable {
+ public:
+  /**
+   * @brief Precedence given to a user-defined operator if none is specified.
+   */
+  static constexpr int default_precedence = 30;
+
+  /**
+   * @brief Class constructor. Starts with just the built-in operators.
+   */
+  OperatorTable() {
+    table_.fill(-1);
+    table_['<'] = 10;
+    table_['+'] = 20;
+    table_['-'] = 20;
+    table_['*'] = 40;
+  }
+
+  /**
+   * @brief Getter for the precedence of an operator.
+   * @param op The operator.
+   * @return Its precedence, or -1 if it isn't a binary operator.
+   */
+  int precedence(char op) const {
+    return table_[static_cast<unsigned char>(op)];
+  }
+
+  /**
+   * @brief Whether a character can be defined as a binary operator; it must
+   * be punctuation that doesn't already mean something else.
+   * @param op The character.
+   * @return True if the character can be an operator.
+   */
+  static bool definable(char op) {
+    return std::ispunct(static_cast<unsigned char>(op)) && op != '(' &&
+           op != ')' && op != ',' && op != ';' && op != '#' && op != '.';
+  }
+
+  /**
+   * @brief Define a binary operator, or change the precedence of an existing
+   * one. Throws std::runtime_error if the operator can't be defined or the
+   * precedence isn't positive.
+   * @param op The operator.
+   * @param precedence Its precedence; operators with higher precedences bind
+   * more tightly.
+   */
+  void add(char op, int precedence) {
+    if (!definable(op))
+      throw std::runtime_error(std::string("Can't define ") + op +
+                               " as a binary operator.");
+    if (precedence <= 0)
+      throw std::runtime_error("Operator precedence must be positive.");
+    table_[static_cast<unsigned char>(op)] = precedence;
+  }
+
+  /**
+   * @brief Equality comparison operator.
+   * @param rhs RHS OperatorTable to the equality condition.
+   * @return True if every operator has the same precedence in both.
+   */
+  bool operator==(const OperatorTable& rhs) const {
+    return table_ == rhs.table_;
+  }
+
+  /**
+   * @brief Inequality comparison operator.
+   * @param rhs RHS OperatorTable to the inequality condition.
+   * @return True if any operator has a different precedence.
+   */
+  bool operator!=(const OperatorTable& rhs) const { return !(*this == rhs); }
+
+ private:
+  std::array<int, 256> table_;
+};
+
 /**
  * @brief Parser for the Kaleidoscope language. Wraps the lexer and constructs
  * the AST for the code.
+ *
+ * Syntax errors are reported through the Lexer's DiagnosticEngine, located at
+ * the token where parsing failed, so are silent unless the engine has been
+ * given a sink.
+ *
+ * Each AST node is given the SourceOffset of the token that begins it; for
+ * binary expressions that's the operator, and for top-level expressions the
+ * first token of the expression.
  */
 class Parser {
  public:
   /**
    * @brief Class constructor. Prime the token stream.
    * @param lexer Lexer which provides token stream.
+   * @param factory Factory used to create the AST nodes; by default nodes are
+   * allocated individually on the heap.
+   * @param operators Binary operators to recognise, e.g. those defined by
+   * code parsed earlier; by default just the built-in ones.
    */
-  Parser(Lexer& lexer) : lexer_{lexer} { next_token(); }
+  Parser(Lexer& lexer, ASTFactory factory = ASTFactory(),
+         OperatorTable operators = OperatorTable())
+      : lexer_{lexer},
+        factory_{std::move(factory)},
+        operators_{std::move(operators)} {
+    next_token();
+  }
 
   /**
-   * @brief Parse the token stream from the lexer until we encounter an EOF.
+   * @brief Parse the token stream from the lexer until we encounter an EOF,
+   * discarding the ASTs.
    */
-  void parse() {
-    // Prime the token buffer
-    // Just continue looping
-    while (current_token_.type() != TokenType::tok_eof) {
-      step();
-      next_token();
+  void parse() { parse([](std::shared_ptr<AST>) {}); }
+
+  /**
+   * @brief Parse the token stream from the lexer until we encounter an EOF,
+   * handing each top-level AST on as soon as it's complete, e.g. to a queue
+   * feeding other threads. Constructs that couldn't be parsed are skipped.
+   * @param consume Called with each definition, extern and top-level
+   * expression, in order.
+   */
+  template <typename Consumer>
+  void parse(Consumer&& consume) {
+    while (!eof()) {
+      if (auto ast = step()) consume(std::move(ast));
     }
   }
 
   /**
    * @brief Step through the token stream from the lexer until we can return a
    * complete AST node.
+   * @return AST node that has been parsed. If the nodes are in an Arena, it
+   * shares ownership of the Arena, so the AST outlives the Parser.
+   */
+  std::shared_ptr<AST> step() { return factory_.own(step_tokens()); }
+
+  /**
+   * @brief Whether the whole token stream has been consumed.
+   * @return True if there's nothing left to parse.
+   */
+  bool eof() const { return current_token_.type() == TokenType::tok_eof; }
+
+  /**
+   * @brief Getter for the Lexer that tokens are being pulled from, e.g. to
+   * find where the current token lies in the source.
+   * @return The Lexer.
+   */
+  const Lexer& lexer() const { return lexer_; }
+
+  /**
+   * @brief Getter for the binary operators that are recognised, including any
+   * defined by the code parsed so far.
+   * @return The operators and their precedences.
+   */
+  const OperatorTable& operators() const { return operators_; }
+
+  /**
+   * @brief Define a binary operator for the code that follows, or change the
+   * precedence of an existing one. Expressions using the operator call a
+   * function named binary followed by the operator, e.g. binary|, which takes
+   * the two operands. Throws std::runtime_error if the operator can't be
+   * defined.
+   * @param op The operator.
+   * @param precedence Its precedence; the built-in operators have < at 10,
+   * + and - at 20, and * at 40.
+   */
+  void add_binary_operator(char op, int precedence) {
+    operators_.add(op, precedence);
+  }
+
+ private:
+  Lexer lexer_;
+  ASTFactory factory_;
+  Token current_token_;
+  OperatorTable operators_;
+
+  /**
+   * @brief Step through the token stream until a complete AST node has been
+   * parsed, without giving it ownership of the Arena.
    * @return AST node that has been parsed.
    */
-  std::shared_ptr<AST> step() {
+  std::shared_ptr<AST> step_tokens() {
     switch (current_token_.type()) {
       case TokenType::tok_eof:
         return nullptr;
@@ -54,30 +216,25 @@ class Parser {
       case TokenType::tok_extern:
         return handle_extern();
       case TokenType::tok_operator:
-        if (current_token_.value() == ";") {
+        if (current_token_.view() == ";") {
           next_token();
           break;
         }
-        break;
+        // Any other operator, e.g. an opening parenthesis, starts a top-level
+        // expression
+        return handle_top_level();
       default:
         return handle_top_level();
     }
     return nullptr;
   }
 
- private:
-  Lexer lexer_;
-  Token current_token_;
-  std::map<std::string, int> binop_precedence_{
-      {"<", 10}, {"+", 20}, {"-", 20}, {"*", 40}};
-
   /**
    * @brief Parse an extern function declaration. Recovers from any internal
    * errors by ignoring erroneous parsing and moving onto next expression.
    */
   std::shared_ptr<AST> handle_extern() {
     if (auto result = parse_extern()) {
-      std::cout << "Parsed extern." << std::endl;
       return result;
     } else {
       next_token();
@@ -91,7 +248,6 @@ class Parser {
    */
   std::shared_ptr<AST> handle_definition() {
     if (auto result = parse_definition()) {
-      std::cout << "Parsed function definition." << std::endl;
       return result;
     } else {
       next_token();
@@ -105,7 +261,6 @@ class Parser {
    */
   std::shared_ptr<AST> handle_top_level() {
     if (auto result = parse_top_level()) {
-      std::cout << "Parsed top-level." << std::endl;
       return result;
     } else {
       next_token();
@@ -115,17 +270,17 @@ class Parser {
 
   /**
    * @brief Erroneous parsing for expression.
-   * @param message Message to print to stderr.
+   * @param message Message to report as an error at the current token.
    * @return ExprAST unique pointer that just wraps nullptr.
    */
   std::shared_ptr<ExprAST> expr_error(const std::string& message) {
-    std::cerr << message << std::endl;
+    lexer_.diagnostics()->error(message, lexer_.location());
     return nullptr;
   }
 
   /**
    * @brief Erroneous parsing for prototype.
-   * @param message Message to print to stderr.
+   * @param message Message to report as an error at the current token.
    * @return PrototypeAST unique pointer that just wraps nullptr.
    */
   std::shared_ptr<PrototypeAST> proto_error(const std::string& message) {
@@ -141,306 +296,334 @@ class Parser {
   Token next_token() { return current_token_ = lexer_.get_token(); }
 
   // ==========================================================================
-  //                        PRIMARY EXPRESSION PARSING
+  //                            EXPRESSION PARSING
   // ==========================================================================
 
   /**
-   * @brief Parse a primary expression of some kind; an identifier, number
-   * or parenthetical expression.
-   * @return The primary expression AST node.
+   * @brief The construct that an expression being parsed belongs to, i.e.
+   * what happens to it once it's complete.
    */
-  std::shared_ptr<ExprAST> parse_primary() {
-    switch (current_token_.type()) {
-      default:
-        return nullptr;
-      case TokenType::tok_identifier:
-        return parse_identifier_expr();
-      case TokenType::tok_number:
-        return parse_number_expr();
-      case TokenType::tok_if:
-        return parse_if_expr();
-      case TokenType::tok_for:
-        return parse_for_expr();
-      case TokenType::tok_operator:
-        if (current_token_.value() == "(") return parse_parentheses_expr();
-    }
-    return nullptr;
-  }
+  enum class ExprContext {
+    top,          //< The expression being parsed as a whole
+    parentheses,  //< Contents of a parenthetical expression
+    call_arg,     //< Argument to a function call
+    if_cond,      //< Condition of an if-expression
+    if_then,      //< Expression when the condition is true
+    if_else,      //< Expression when the condition is false
+    for_start,    //< Initial value of the loop variable
+    for_end,      //< Loop termination condition
+    for_step,     //< Loop variable increment
+    for_body      //< Loop body
+  };
 
   /**
-   * @brief Parse a numerical expression from the lexer and return the AST
-   * node.
-   * @return The numerical expression AST node.
+   * @brief An expression that's still being parsed. Its pending binary
+   * operators are those above operator_base on the operator stack. The parts
+   * of the construct it belongs to that are already complete (e.g. earlier
+   * arguments to a call) lie above operand_base on the operand stack, with
+   * the operands of the expression itself above them.
    */
-  std::shared_ptr<ExprAST> parse_number_expr() {
-    // Retrieve the numerical token in the token buffer and create an AST
-    // node with it
-    auto result =
-        std::make_shared<NumberExprAST>(std::stof(current_token_.value()));
-    next_token();
-    return result;
-  }
+  struct ExprFrame {
+    ExprContext context;
+    std::size_t operand_base;
+    std::size_t operator_base;
+    std::string name;     //< Callee of a call, or loop variable of a for-loop
+    SourceOffset offset;  //< Where the construct begins
+  };
 
   /**
-   * @brief Parse the contents from a parenthetical expression.
-   * @return The expression AST node.
+   * @brief A binary operator waiting for its right-hand side.
    */
-  std::shared_ptr<ExprAST> parse_parentheses_expr() {
-    // Have already encountered '(', so move past it
-    next_token();
-
-    auto expr = parse_expression();
-    if (!expr)
-      return expr_error(
-          "Couldn't parse parentheses expression after ( character.");
-
-    if (current_token_.value() != ")")
-      return expr_error("No terminating ) character in parentheses expression");
-    // Consume the trailing ')'
-    next_token();
-
-    return expr;
-  }
+  struct PendingOperator {
+    char op;
+    int precedence;
+    SourceOffset offset;
+  };
+
+  // Stacks used while parsing an expression; kept between expressions so that
+  // their storage is reused
+  std::vector<ExprFrame> frames_;
+  std::vector<std::shared_ptr<ExprAST>> operands_;
+  std::vector<PendingOperator> pending_;
 
   /**
-   * @brief Parse some kind of identifier expression.
-   *
-   * This can take two forms;
-   *    (1) Some kind of expression involving a variable, in which case
-   *        return the variable, or;
-   *    (2) Function call, in which case return the call AST node.
-   * @return The identifier expression AST node.
-   */
-  std::shared_ptr<ExprAST> parse_identifier_expr() {
-    // Retrieve the identifier name, and move on to the rest of the
-    // statement
-    std::string name = current_token_.value();
-    next_token();
-
-    // If next token isn't an opening parenthesis, then we must be parsing
-    // a basic variable expression rather than function call
-    if (current_token_.value() != "(")
-      return std::make_shared<VariableExprAST>(name);
-
-    // Otherwise we have a function call
-    next_token();
-    std::vector<std::shared_ptr<ExprAST>> args;
-
-    // While we haven't encountered the closing parenthesis, continue
-    // parsing the expression
-    if (current_token_.value() != ")") {
-      while (1) {
-        // Generic expression parsing and adding to the function argument
-        // list
-        if (auto arg = parse_expression())
-          args.push_back(std::move(arg));
-        else
-          return expr_error("Unrecognised expression in function call.");
-
-        // End of call expression, so leave the loop
-        if (current_token_.value() == ")") break;
-        // Only permit comma operators separating identifiers
-        if (current_token_.value() != ",")
-          return expr_error(
-              "Only , character is permitted between function arguments.");
-
-        next_token();
-      }
+   * @brief Parse a numerical expression from the lexer and return the AST
+   * node.
+   * @return The numerical expression AST node.
+   */
+  std::shared_ptr<ExprAST> parse_number_expr() {
+    // Retrieve the numerical token in the token buffer and create an AST
+    // node with it. The lexer accepts any run of digits and points, so e.g. a
+    // lone . needn't be a number at all
+    float value;
+    try {
+      value = std::stof(current_token_.value());
+    } catch (const std::logic_error&) {
+      return expr_error("Invalid numerical constant " +
+                        current_token_.value() + ".");
     }
-
-    // Eat the closing ')' and return out call expression
+    auto result = factory_.number(value, current_token_.offset());
     next_token();
-    return std::make_shared<CallExprAST>(name, std::move(args));
+    return result;
   }
 
   /**
-   * @brief Parse control flow if-then-else expression.
-   * @return The if-expression AST node.
+   * @brief Evaluate the precedence of the Token in the token buffer.
+   * @return Token precedence; if the token isn't a binary operator, return -1.
    */
-  std::shared_ptr<ExprAST> parse_if_expr() {
-    // Eat the "if"
-    next_token();
-
-    // Get the condition
-    auto cond = parse_expression();
-    if (!cond) return expr_error("Couldn't parse condition.");
-
-    if (current_token_.type() != TokenType::tok_then)
-      return expr_error("Expected then token after condition.");
-    // Eat the "then"
-    next_token();
-    auto then_expr = parse_expression();
-    if (!then_expr) return expr_error("Couldn't parse then expression");
-
-    if (current_token_.type() != TokenType::tok_else)
-      return expr_error("Expected else token after then expression.");
-    // Eat the "else"
-    next_token();
-    auto else_expr = parse_expression();
-    if (!else_expr) return expr_error("Couldn't parse else expression");
-
-    return std::make_shared<IfExprAST>(std::move(cond), std::move(then_expr),
-                                       std::move(else_expr));
+  int get_token_precedence() {
+    // Make sure the current token is actually an operator
+    if (current_token_.type() != TokenType::tok_operator) return -1;
+    // Operator tokens are a single character, which indexes the table
+    return operators_.precedence(current_token_.view()[0]);
   }
 
   /**
-   * @brief Parse looping for-in expression.
-   * @return The for-expression AST node.
+   * @brief Combine the operands of the innermost expression under its pending
+   * binary operators, for as long as they bind at least as tightly as the
+   * given precedence.
+   * @param precedence Precedence of the operator that's about to be pushed;
+   * zero to resolve every pending operator.
    */
-  std::shared_ptr<ExprAST> parse_for_expr() {
-    // Eat the "for"
-    next_token();
-
-    // Need variable identifier for start of loop
-    if (current_token_.type() != TokenType::tok_identifier) {
-      return expr_error("Expected identifier after for.");
+  void reduce(int precedence) {
+    while (pending_.size() > frames_.back().operator_base &&
+           pending_.back().precedence >= precedence) {
+      auto rhs = std::move(operands_.back());
+      operands_.pop_back();
+      auto lhs = std::move(operands_.back());
+      const PendingOperator& op = pending_.back();
+      operands_.back() =
+          factory_.binary(op.op, std::move(lhs), std::move(rhs), op.offset);
+      pending_.pop_back();
     }
-    // Eat the loop variable
-    std::string loop_var_name = current_token_.value();
-    next_token();
-
-    if (current_token_.value() != "=") {
-      return expr_error("Expected = after loop variable.");
-    }
-    next_token();
-
-    // Parse the expression for the loop variable initialisation
-    auto start_condition = parse_expression();
-    if (!start_condition)
-      return expr_error("Was not able to parse loop variable initialisation.");
-
-    if (current_token_.value() != ",") {
-      return expr_error(
-          "Expected comma between start and end loop variable expressions.");
-    }
-    next_token();
-
-    // Parse the expression for the loop variable finishing state
-    auto end_condition = parse_expression();
-    if (!end_condition)
-      return expr_error("Was not able to parse loop variable finalisation.");
-
-    // Optional step value for the loop
-    std::shared_ptr<ExprAST> step_condition;
-    if (current_token_.value() == ",") {
-      next_token();
-      step_condition = parse_expression();
-      if (!step_condition) {
-        return expr_error("Erroneously parsed for-loop step.");
-      }
-    }
-
-    // Eat the "in"
-    if (current_token_.type() != TokenType::tok_in) {
-      return expr_error("Expected in token after for loop definition.");
-    }
-    next_token();
-
-    // Parse the for-loop body
-    auto body = parse_expression();
-    if (!body) return expr_error("Failed to parse for-loop body.");
-
-    // Return the for-loop AST
-    return std::make_shared<ForExprAST>(
-        loop_var_name, std::move(start_condition), std::move(end_condition),
-        std::move(step_condition), std::move(body));
   }
 
-  // ==========================================================================
-  //                        BINARY EXPRESSION PARSING
-  // ==========================================================================
-
   /**
-   * @brief Evaluate the precedence of the Token in the token buffer.
-   * @return Token precedence; if the token isn't a binary operator, return -1.
+   * @brief Take the last operands off the operand stack.
+   * @param count Number of operands to take.
+   * @return The operands, in order.
    */
-  int get_token_precedence() {
-    // Make sure the current token is actually an operator
-    if (current_token_.type() != TokenType::tok_operator) return -1;
-    // If we have an operator, establish precedence if it was a binary operator
-    // Note that if a value isn't in the std::map, query will return 0
-    return binop_precedence_[current_token_.value()] > 0
-               ? binop_precedence_[current_token_.value()]
-               : -1;
+  std::vector<std::shared_ptr<ExprAST>> pop_operands(std::size_t count) {
+    std::vector<std::shared_ptr<ExprAST>> popped(
+        std::make_move_iterator(operands_.end() - count),
+        std::make_move_iterator(operands_.end()));
+    operands_.resize(operands_.size() - count);
+    return popped;
   }
 
   /**
    * @brief Parse an expression; a primary expression which is potentially
-   * followed by a sequence of [binop, primary] pairs.
+   * followed by a sequence of [binop, primary] pairs. Primaries are
+   * identifiers, numbers, calls, parenthetical expressions, and if- and
+   * for-expressions.
    *
    * For instance, consider a + (b + c) * d. This would be considered as the
    * sequence (a, [+, (b + c)], [*, d]) (recall that a parenthetical expression
-   * is also a primary).
+   * is also a primary). Binary operators are resolved shunting-yard style;
+   * each operand is pushed onto a stack, and each operator waits on another
+   * stack until an operator binding no more tightly arrives (or the
+   * expression ends), at which point it's combined with the top two operands.
+   * Operators of equal precedence therefore associate to the left, e.g.
+   * a - b - c is (a - b) - c.
+   *
+   * Rather than recursing into the expressions nested inside primaries (the
+   * contents of parentheses, call arguments, and the parts of if- and
+   * for-expressions), each is given a frame on an explicit stack that records
+   * what to do with it once it's complete. Arbitrarily deep or long
+   * expressions are therefore parsed in constant native stack.
    * @return The expression AST node.
    */
   std::shared_ptr<ExprAST> parse_expression() {
-    auto lhs = parse_primary();
-    if (!lhs) return expr_error("Couldn't parse LHS in expression.");
-
-    // Start off with a zero precedence since we've just parsed the first
-    // primary in the expression
-    return parse_binop_rhs(0, std::move(lhs));
-  }
-
-  /**
-   * @brief Operator precedence parsing implementation for the parsing of
-   * expressions. Effectively inserts parentheses around expressions with higher
-   * precedences, turning them into primaries, allowing the expression to be
-   * parsed recursively.
-   * @param expr_precedence
-   * @param lhs
-   * @return
-   */
-  std::shared_ptr<ExprAST> parse_binop_rhs(int expr_precedence,
-                                           std::shared_ptr<ExprAST> lhs) {
-    // Keep on eating the full expression
-    while (1) {
-      // If we have a binop as the current token, then retrieve a precedence >=
-      // 0
-      int token_precedence = get_token_precedence();
-      // If it was a binop that binds at least as tightly as the current binop,
-      // then consume it, else we're done.
-      // For instance, if our expression so far is a * b and we're parsing [+,
-      // c],
-      // + binds less tightly than * and so we return a * b as our
-      if (token_precedence < expr_precedence) return lhs;
-
-      // We know we've got a binary operator we need to process, so eat it
-      Token binop = current_token_;
-      next_token();
-
-      // Try to retrieve the primary on the RHS of the binary operator; if there
-      // isn't one there, there's something wrong (can't have a trailing binop)
-      auto rhs = parse_primary();
-      if (!rhs) return expr_error("Couldn't parse RHS in binop.");
-
-      // Look-ahead at the next binary operator in sequence. So far we've parsed
-      // a `.` b `?`; if `?` is of lower precedence than `.`, e.g. the
-      // expression looks like a * b + c, we want (a * b) + c, our primary being
-      // a * b, so we can return LHS = a and RHS = b. We'll parse the [+, c]
-      // later.
-      //
-      // However, if our expression is a + b * c, we want a + (b * c), so we
-      // need to return LHS = a and RHS = (b * c). Hence if the look-ahead
-      // operator is higher in precedence than the first, we need to recurse
-      // into parse_binop_rhs with LHS = b, returning a binary expression AST of
-      // (b * c). This can then be returned as the RHS to the LHS of a in the
-      // first invocation of parse_binop_rhs
-      int next_precedence = get_token_precedence();
-      if (token_precedence < next_precedence) {
-        rhs = parse_binop_rhs(token_precedence + 1, std::move(rhs));
-        if (!rhs)
-          return expr_error("Couldn't find RHS in recursive binop search.");
+    frames_.assign(1, ExprFrame{ExprContext::top, 0, 0, "", no_offset});
+    operands_.clear();
+    pending_.clear();
+    // Begin a nested expression, belonging to a construct whose completed
+    // parts (if any) are the given number of operands on top of the stack
+    auto open = [this](ExprContext context, SourceOffset offset,
+                       std::string name = "", std::size_t parts = 0) {
+      frames_.push_back(ExprFrame{context, operands_.size() - parts,
+                                  pending_.size(), std::move(name), offset});
+    };
+
+    while (true) {
+      // Expecting an operand. Either it's a primary that can be parsed
+      // outright, or a construct that has nested expressions of its own, in
+      // which case we go on to parse the first of those
+      switch (current_token_.type()) {
+        case TokenType::tok_number: {
+          auto number = parse_number_expr();
+          if (!number) return nullptr;
+          operands_.push_back(std::move(number));
+          break;
+        }
+        case TokenType::tok_identifier: {
+          // If next token isn't an opening parenthesis, then we must be
+          // parsing a basic variable expression rather than function call
+          std::string name = current_token_.value();
+          const SourceOffset offset = current_token_.offset();
+          next_token();
+          if (current_token_.view() != "(") {
+            operands_.push_back(factory_.variable(name, offset));
+            break;
+          }
+          next_token();
+          if (current_token_.view() == ")") {
+            next_token();
+            operands_.push_back(factory_.call(name, {}, offset));
+            break;
+          }
+          open(ExprContext::call_arg, offset, std::move(name));
+          continue;
+        }
+        case TokenType::tok_if: {
+          open(ExprContext::if_cond, current_token_.offset());
+          next_token();
+          continue;
+        }
+        case TokenType::tok_for: {
+          const SourceOffset offset = current_token_.offset();
+          next_token();
+          if (current_token_.type() != TokenType::tok_identifier)
+            return expr_error("Expected identifier after for.");
+          std::string loop_var = current_token_.value();
+          next_token();
+          if (current_token_.view() != "=")
+            return expr_error("Expected = after loop variable.");
+          next_token();
+          open(ExprContext::for_start, offset, std::move(loop_var));
+          continue;
+        }
+        default: {
+          if (current_token_.type() == TokenType::tok_operator &&
+              current_token_.view() == "(") {
+            open(ExprContext::parentheses, current_token_.offset());
+            next_token();
+            continue;
+          }
+          // Can't have a trailing binop
+          return expr_error(pending_.size() > frames_.back().operator_base
+                                ? "Couldn't parse RHS in binop."
+                                : "Couldn't parse LHS in expression.");
+        }
       }
 
-      lhs = std::make_shared<BinaryExprAST>(*binop.value().c_str(),
-                                            std::move(lhs), std::move(rhs));
+      // With an operand in hand, a binary operator continues the innermost
+      // expression, and anything else completes it. Completing an expression
+      // either leads on to the next part of its construct, or completes the
+      // construct, which is then an operand of the enclosing expression
+      bool need_operand = false;
+      while (!need_operand) {
+        int precedence = get_token_precedence();
+        if (precedence > 0) {
+          reduce(precedence);
+          pending_.push_back(
+              {current_token_.view()[0], precedence, current_token_.offset()});
+          next_token();
+          break;
+        }
+        reduce(0);
+
+        ExprFrame& frame = frames_.back();
+        switch (frame.context) {
+          case ExprContext::top:
+            return std::move(operands_.back());
+          case ExprContext::parentheses: {
+            if (current_token_.view() != ")")
+              return expr_error(
+                  "No terminating ) character in parentheses expression");
+            next_token();
+            frames_.pop_back();
+            break;
+          }
+          case ExprContext::call_arg: {
+            if (current_token_.view() == ",") {
+              // The next argument is stacked on top of those so far
+              next_token();
+              need_operand = true;
+              break;
+            }
+            if (current_token_.view() != ")")
+              return expr_error(
+                  "Only , character is permitted between function "
+                  "arguments.");
+            next_token();
+            auto args = pop_operands(operands_.size() - frame.operand_base);
+            operands_.push_back(
+                factory_.call(frame.name, std::move(args), frame.offset));
+            frames_.pop_back();
+            break;
+          }
+          case ExprContext::if_cond: {
+            if (current_token_.type() != TokenType::tok_then)
+              return expr_error("Expected then token after condition.");
+            next_token();
+            frame.context = ExprContext::if_then;
+            need_operand = true;
+            break;
+          }
+          case ExprContext::if_then: {
+            if (current_token_.type() != TokenType::tok_else)
+              return expr_error("Expected else token after then expression.");
+            next_token();
+            frame.context = ExprContext::if_else;
+            need_operand = true;
+            break;
+          }
+          case ExprContext::if_else: {
+            auto parts = pop_operands(3);
+            operands_.push_back(
+                factory_.if_expr(std::move(parts[0]), std::move(parts[1]),
+                                 std::move(parts[2]), frame.offset));
+            frames_.pop_back();
+            break;
+          }
+          case ExprContext::for_start: {
+            if (current_token_.view() != ",")
+              return expr_error(
+                  "Expected comma between start and end loop variable "
+                  "expressions.");
+            next_token();
+            frame.context = ExprContext::for_end;
+            need_operand = true;
+            break;
+          }
+          case ExprContext::for_end: {
+            // Optional step value for the loop
+            if (current_token_.view() == ",") {
+              next_token();
+              frame.context = ExprContext::for_step;
+              need_operand = true;
+              break;
+            }
+            operands_.push_back(nullptr);
+          }
+            [[fallthrough]];
+          case ExprContext::for_step: {
+            if (current_token_.type() != TokenType::tok_in)
+              return expr_error("Expected in token after for loop definition.");
+            next_token();
+            frame.context = ExprContext::for_body;
+            need_operand = true;
+            break;
+          }
+          case ExprContext::for_body: {
+            auto parts = pop_operands(4);
+            operands_.push_back(factory_.for_expr(
+                frame.name, std::move(parts[0]), std::move(parts[1]),
+                std::move(parts[2]), std::move(parts[3]), frame.offset));
+            frames_.pop_back();
+            break;
+          }
+        }
+      }
     }
   }
 
   /**
    * @brief Parse a function prototype of the form function_name(arg1, arg2,
-   * ...).
+   * ...). A binary operator is defined by a prototype of the form
+   * binary| precedence (lhs rhs), where the precedence is optional; the
+   * operator is recognised from then on.
    * @return Prototype AST node.
    */
   std::shared_ptr<PrototypeAST> parse_prototype() {
@@ -448,9 +631,32 @@ class Parser {
     if (current_token_.type() != TokenType::tok_identifier)
       return proto_error("Prototype must begin with an identifier.");
     std::string function_name = current_token_.value();
+    const SourceOffset offset = current_token_.offset();
     next_token();
 
-    if (current_token_.value() != "(")
+    int precedence = -1;
+    if (function_name == "binary" &&
+        current_token_.type() == TokenType::tok_operator &&
+        current_token_.view() != "(") {
+      if (!OperatorTable::definable(current_token_.view()[0]))
+        return proto_error("Can't define " + current_token_.value() +
+                           " as a binary operator.");
+      function_name += current_token_.view();
+      next_token();
+      precedence = OperatorTable::default_precedence;
+      if (current_token_.type() == TokenType::tok_number) {
+        // Must be a whole number, and not so large that it overflows
+        precedence = -1;
+        std::string digits = current_token_.value();
+        if (digits.find('.') == std::string::npos && digits.size() < 9)
+          precedence = std::stoi(digits);
+        if (precedence <= 0)
+          return proto_error("Invalid operator precedence " + digits + ".");
+        next_token();
+      }
+    }
+
+    if (current_token_.view() != "(")
       return proto_error(
           "Prototype arguments must be separated from identifier by "
           "parenthesis, got " +
@@ -462,13 +668,18 @@ class Parser {
       arg_names.push_back(current_token_.value());
     }
 
-    if (current_token_.value() != ")")
+    if (current_token_.view() != ")")
       return proto_error(
           "Prototype arguments must be ended with parenthesis, got " +
           current_token_.value());
     next_token();
 
-    return std::make_shared<PrototypeAST>(function_name, std::move(arg_names));
+    if (precedence > 0) {
+      if (arg_names.size() != 2)
+        return proto_error("Binary operator must have exactly two operands.");
+      operators_.add(function_name.back(), precedence);
+    }
+    return factory_.prototype(function_name, std::move(arg_names), offset);
   }
 
   /**
@@ -479,6 +690,7 @@ class Parser {
    */
   std::shared_ptr<FunctionAST> parse_definition() {
     // Eat the def keyword
+    const SourceOffset offset = current_token_.offset();
     next_token();
 
     // Parse the prototype following the def
@@ -488,7 +700,7 @@ class Parser {
     // Parse the function expression and return the function AST node if we've
     // been able to retrieve a valid expression
     if (auto expr = parse_expression()) {
-      return std::make_shared<FunctionAST>(std::move(proto), std::move(expr));
+      return factory_.function(std::move(proto), std::move(expr), offset);
     }
 
     return nullptr;
@@ -511,11 +723,11 @@ class Parser {
    * @return Function definition AST.
    */
   std::shared_ptr<FunctionAST> parse_top_level() {
+    const SourceOffset offset = current_token_.offset();
     if (auto expr = parse_expression()) {
       // Prototype is completely anonymous; no name or arguments
-      auto proto =
-          std::make_shared<PrototypeAST>("", std::vector<std::string>());
-      return std::make_shared<FunctionAST>(std::move(proto), std::move(expr));
+      auto proto = factory_.prototype("", std::vector<std::string>(), offset);
+      return factory_.function(std::move(proto), std::move(expr), offset);
     }
     return nullptr;
   }
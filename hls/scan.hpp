@@ -0,0 +1,244 @@
+/**
+ * @file scan.hpp
+ * @author Salvatore Cardamone
+ * @brief Vectorised character-class scanning used by the buffer Lexer.
+ */
+#ifndef __HLS_SCAN_HPP
+#define __HLS_SCAN_HPP
+
+#include <cstddef>
+
+#if defined(__AVX2__)
+#include <immintrin.h>
+#elif defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+namespace hls {
+namespace scan {
+
+// ==========================================================================
+//                           SCALAR SCANNING
+// ==========================================================================
+
+/**
+ * @brief Check whether a character is whitespace in the sense of isspace() in
+ * the "C" locale.
+ * @param c The character to check.
+ * @return True if the character is whitespace, false otherwise.
+ */
+inline bool is_space(char c) { return c == ' ' || (c >= '\t' && c <= '\r'); }
+
+/**
+ * @brief Check whether a character can continue an identifier, i.e. is
+ * alphanumerical or an underscore.
+ * @param c The character to check.
+ * @return True if the character is part of an identifier, false otherwise.
+ */
+inline bool is_identifier(char c) {
+  char folded = c | 0x20;
+  return (c >= '0' && c <= '9') || (folded >= 'a' && folded <= 'z') ||
+         c == '_';
+}
+
+/**
+ * @brief Check whether a character terminates a line comment.
+ * @param c The character to check.
+ * @return True if the character is a newline or carriage return.
+ */
+inline bool is_line_end(char c) { return c == '\n' || c == '\r'; }
+
+/**
+ * @brief Byte-wise scan for the first whitespace character.
+ * @param data Buffer to scan.
+ * @param pos Index to begin scanning from.
+ * @param size Size of the buffer.
+ * @return Index of the first non-whitespace character, or size.
+ */
+inline std::size_t skip_whitespace_scalar(const char* data, std::size_t pos,
+                                          std::size_t size) {
+  while (pos < size && is_space(data[pos])) ++pos;
+  return pos;
+}
+
+/**
+ * @brief Byte-wise scan over identifier characters.
+ * @param data Buffer to scan.
+ * @param pos Index to begin scanning from.
+ * @param size Size of the buffer.
+ * @return Index of the first non-identifier character, or size.
+ */
+inline std::size_t skip_identifier_scalar(const char* data, std::size_t pos,
+                                          std::size_t size) {
+  while (pos < size && is_identifier(data[pos])) ++pos;
+  return pos;
+}
+
+/**
+ * @brief Byte-wise scan for the end of a line.
+ * @param data Buffer to scan.
+ * @param pos Index to begin scanning from.
+ * @param size Size of the buffer.
+ * @return Index of the first newline/ carriage return, or size.
+ */
+inline std::size_t find_line_end_scalar(const char* data, std::size_t pos,
+                                        std::size_t size) {
+  while (pos < size && !is_line_end(data[pos])) ++pos;
+  return pos;
+}
+
+// ==========================================================================
+//                          VECTORISED SCANNING
+// ==========================================================================
+
+#if defined(__AVX2__) || defined(__SSE2__)
+namespace detail {
+
+#if defined(__AVX2__)
+using vec = __m256i;
+constexpr std::size_t width = 32;
+inline vec load(const char* p) {
+  return _mm256_loadu_si256(reinterpret_cast<const vec*>(p));
+}
+inline vec splat(char c) { return _mm256_set1_epi8(c); }
+inline vec eq(vec a, vec b) { return _mm256_cmpeq_epi8(a, b); }
+inline vec gt(vec a, vec b) { return _mm256_cmpgt_epi8(a, b); }
+inline vec both(vec a, vec b) { return _mm256_and_si256(a, b); }
+inline vec either(vec a, vec b) { return _mm256_or_si256(a, b); }
+inline unsigned mask(vec a) {
+  return static_cast<unsigned>(_mm256_movemask_epi8(a));
+}
+#else
+using vec = __m128i;
+constexpr std::size_t width = 16;
+inline vec load(const char* p) {
+  return _mm_loadu_si128(reinterpret_cast<const vec*>(p));
+}
+inline vec splat(char c) { return _mm_set1_epi8(c); }
+inline vec eq(vec a, vec b) { return _mm_cmpeq_epi8(a, b); }
+inline vec gt(vec a, vec b) { return _mm_cmpgt_epi8(a, b); }
+inline vec both(vec a, vec b) { return _mm_and_si128(a, b); }
+inline vec either(vec a, vec b) { return _mm_or_si128(a, b); }
+inline unsigned mask(vec a) {
+  return static_cast<unsigned>(_mm_movemask_epi8(a)) & 0xFFFFu;
+}
+#endif
+
+/**
+ * @brief Lanes of the block whose bytes lie in the inclusive range [lo, hi].
+ * Comparisons are signed, so bytes >= 0x80 never match a printable ASCII range.
+ */
+inline vec in_range(vec block, char lo, char hi) {
+  return both(gt(block, splat(lo - 1)), gt(splat(hi + 1), block));
+}
+
+/**
+ * @brief Lanes of the block that are whitespace.
+ */
+inline vec space_lanes(vec block) {
+  return either(eq(block, splat(' ')), in_range(block, '\t', '\r'));
+}
+
+/**
+ * @brief Lanes of the block that are alphanumerical or an underscore. Case is
+ * folded by setting bit 5, which maps no non-letter onto a letter.
+ */
+inline vec identifier_lanes(vec block) {
+  vec folded = either(block, splat(0x20));
+  return either(either(in_range(block, '0', '9'), in_range(folded, 'a', 'z')),
+                eq(block, splat('_')));
+}
+
+/**
+ * @brief Lanes of the block that are a newline or carriage return.
+ */
+inline vec line_end_lanes(vec block) {
+  return either(eq(block, splat('\n')), eq(block, splat('\r')));
+}
+
+/**
+ * @brief Advance through the buffer a block at a time for as long as every
+ * lane satisfies the classifier, finishing off the tail byte-wise.
+ * @param classify Maps a block to the lanes that should be skipped over.
+ * @param scalar Byte-wise equivalent of the classifier for the tail.
+ */
+template <typename Classify, typename Scalar>
+inline std::size_t skip(const char* data, std::size_t pos, std::size_t size,
+                        Classify classify, Scalar scalar) {
+  constexpr unsigned full = width == 32 ? 0xFFFFFFFFu : 0xFFFFu;
+  while (pos + width <= size) {
+    unsigned stop = ~mask(classify(load(data + pos))) & full;
+    if (stop) return pos + __builtin_ctz(stop);
+    pos += width;
+  }
+  while (pos < size && scalar(data[pos])) ++pos;
+  return pos;
+}
+
+}  // namespace detail
+#endif
+
+/**
+ * @brief Scan past whitespace, a vector register at a time where available.
+ * @param data Buffer to scan.
+ * @param pos Index to begin scanning from.
+ * @param size Size of the buffer.
+ * @return Index of the first non-whitespace character, or size.
+ */
+inline std::size_t skip_whitespace(const char* data, std::size_t pos,
+                                   std::size_t size) {
+#if defined(__AVX2__) || defined(__SSE2__)
+  // Runs of a single space are by far the most common, so don't pay for a
+  // vector load unless there's more than one whitespace character
+  if (pos + 1 >= size || !is_space(data[pos]) || !is_space(data[pos + 1]))
+    return skip_whitespace_scalar(data, pos, pos + 1 < size ? pos + 1 : size);
+  return detail::skip(data, pos + 2, size, detail::space_lanes, is_space);
+#else
+  return skip_whitespace_scalar(data, pos, size);
+#endif
+}
+
+/**
+ * @brief Scan past identifier characters, a vector register at a time where
+ * available.
+ * @param data Buffer to scan.
+ * @param pos Index to begin scanning from.
+ * @param size Size of the buffer.
+ * @return Index of the first non-identifier character, or size.
+ */
+inline std::size_t skip_identifier(const char* data, std::size_t pos,
+                                   std::size_t size) {
+#if defined(__AVX2__) || defined(__SSE2__)
+  return detail::skip(data, pos, size, detail::identifier_lanes,
+                      is_identifier);
+#else
+  return skip_identifier_scalar(data, pos, size);
+#endif
+}
+
+/**
+ * @brief Scan for the end of the line, a vector register at a time where
+ * available.
+ * @param data Buffer to scan.
+ * @param pos Index to begin scanning from.
+ * @param size Size of the buffer.
+ * @return Index of the first newline/ carriage return, or size.
+ */
+inline std::size_t find_line_end(const char* data, std::size_t pos,
+                                 std::size_t size) {
+#if defined(__AVX2__) || defined(__SSE2__)
+  return detail::skip(
+      data, pos, size,
+      [](detail::vec block) {
+        return detail::eq(detail::line_end_lanes(block), detail::splat(0));
+      },
+      [](char c) { return !is_line_end(c); });
+#else
+  return find_line_end_scalar(data, pos, size);
+#endif
+}
+
+}  // namespace scan
+}  // namespace hls
+
+#endif /* #ifndef __HLS_SCAN_HPP */
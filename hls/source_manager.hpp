@@ -0,0 +1,196 @@
+/**
+ * @file source_manager.hpp
+ * @author Salvatore Cardamone
+ * @brief Compact locations in Kaleidoscope source buffers.
+ */
+#ifndef __HLS_SOURCE_MANAGER_HPP
+#define __HLS_SOURCE_MANAGER_HPP
+
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <deque>
+#include <limits>
+#include <mutex>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace hls {
+
+/**
+ * @brief A position in a source buffer. Lines and columns count from one;
+ * zero means the position isn't known.
+ */
+struct SourceLocation {
+  std::uint32_t line = 0;
+  std::uint32_t column = 0;
+
+  /**
+   * @brief Whether the position is known.
+   * @return True if the location refers to an actual line.
+   */
+  bool valid() const { return line != 0; }
+};
+
+/**
+ * @brief Position of a character in one of the buffers of a SourceManager.
+ * Small enough to be carried by every Token and AST node.
+ */
+using SourceOffset = std::uint32_t;
+
+/**
+ * @brief SourceOffset carried by anything that didn't come from a buffer
+ * registered with a SourceManager.
+ */
+constexpr SourceOffset no_offset = 0;
+
+/**
+ * @brief Maps compact SourceOffsets back onto the buffers they lie in, and
+ * onto lines and columns within them.
+ *
+ * Every buffer that's added is given a contiguous range of offsets, much as
+ * files are laid out in an archive, so a single 32-bit offset identifies both
+ * the buffer and the character within it. Lines and columns are only worked
+ * out when they're asked for, by binary search of a table of where each line
+ * begins; the table itself is only built the first time a buffer is asked
+ * about, so locations that are never looked at cost nothing beyond their
+ * offsets.
+ *
+ * Buffers are referenced rather than copied. The manager may be shared between
+ * threads.
+ */
+class SourceManager {
+ public:
+  /**
+   * @brief Class constructor.
+   */
+  SourceManager() {}
+
+  SourceManager(const SourceManager&) = delete;
+  SourceManager& operator=(const SourceManager&) = delete;
+
+  /**
+   * @brief Register a buffer. Throws std::length_error if the buffers added so
+   * far would no longer fit in a SourceOffset.
+   * @param name Name of the buffer, e.g. the file name.
+   * @param contents Contents of the buffer. Must outlive every lookup of an
+   * offset within it.
+   * @return Offset of the buffer's first character; the offset of the
+   * character at index i is this plus i. The end of the buffer has an offset
+   * too, so that e.g. an EOF token can be located.
+   */
+  SourceOffset add(std::string name, std::string_view contents) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (contents.size() >=
+        std::numeric_limits<SourceOffset>::max() - next_) {
+      throw std::length_error("Source buffers exceed the offset space.");
+    }
+    SourceOffset base = next_;
+    buffers_.emplace_back(std::move(name), contents, base);
+    next_ += static_cast<SourceOffset>(contents.size()) + 1;
+    return base;
+  }
+
+  /**
+   * @brief Getter for the name of the buffer an offset lies in.
+   * @param offset The offset.
+   * @return Name of the buffer; empty if the offset isn't in any buffer.
+   */
+  std::string_view name(SourceOffset offset) const {
+    const Buffer* buffer = find(offset);
+    return buffer ? std::string_view(buffer->name) : std::string_view();
+  }
+
+  /**
+   * @brief Work out the line and column of an offset.
+   * @param offset The offset.
+   * @return Location of the offset within its buffer; unknown if the offset
+   * isn't in any buffer.
+   */
+  SourceLocation location(SourceOffset offset) const {
+    const Buffer* buffer = find(offset);
+    if (!buffer) return SourceLocation();
+    std::call_once(buffer->indexed, [buffer] { index(*buffer); });
+
+    // The line containing the offset is the last one beginning at or before it
+    const std::uint32_t position = offset - buffer->base;
+    auto line = std::upper_bound(buffer->lines.begin(), buffer->lines.end(),
+                                 position) -
+                1;
+    return {static_cast<std::uint32_t>(line - buffer->lines.begin()) + 1,
+            position - *line + 1};
+  }
+
+  /**
+   * @brief Getter for the number of buffers added.
+   * @return Number of buffers.
+   */
+  std::size_t size() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return buffers_.size();
+  }
+
+ private:
+  /**
+   * @brief A registered buffer and, once it's needed, its line table.
+   */
+  struct Buffer {
+    Buffer(std::string name, std::string_view contents, SourceOffset base)
+        : name{std::move(name)}, contents{contents}, base{base} {}
+
+    std::string name;
+    std::string_view contents;
+    SourceOffset base;
+    // Index of the first character of each line
+    mutable std::vector<std::uint32_t> lines;
+    mutable std::once_flag indexed;
+  };
+
+  mutable std::mutex mutex_;
+  // Buffers never move once they've been added, so can be used unlocked
+  std::deque<Buffer> buffers_;
+  SourceOffset next_ = no_offset + 1;
+
+  /**
+   * @brief Find the buffer an offset lies in.
+   * @param offset The offset.
+   * @return The buffer, or nullptr if there isn't one.
+   */
+  const Buffer* find(SourceOffset offset) const {
+    if (offset == no_offset) return nullptr;
+    std::lock_guard<std::mutex> lock(mutex_);
+    // Buffers are added in order of offset
+    auto after = std::upper_bound(
+        buffers_.begin(), buffers_.end(), offset,
+        [](SourceOffset offset, const Buffer& buffer) {
+          return offset < buffer.base;
+        });
+    if (after == buffers_.begin()) return nullptr;
+    const Buffer& buffer = *(after - 1);
+    if (offset - buffer.base > buffer.contents.size()) return nullptr;
+    return &buffer;
+  }
+
+  /**
+   * @brief Build the line table of a buffer.
+   * @param buffer The buffer.
+   */
+  static void index(const Buffer& buffer) {
+    const char* data = buffer.contents.data();
+    const char* end = data + buffer.contents.size();
+    buffer.lines.push_back(0);
+    for (const char* line = data; line != end;) {
+      auto* newline =
+          static_cast<const char*>(std::memchr(line, '\n', end - line));
+      if (!newline) break;
+      line = newline + 1;
+      buffer.lines.push_back(static_cast<std::uint32_t>(line - data));
+    }
+  }
+};
+
+}  // namespace hls
+
+#endif /* #ifndef __HLS_SOURCE_MANAGER_HPP */
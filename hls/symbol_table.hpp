@@ -0,0 +1,82 @@
+/**
+ * @file symbol_table.hpp
+ * @author Salvatore Cardamone
+ * @brief Interning of identifiers as small integer symbols.
+ */
+#ifndef __HLS_SYMBOL_TABLE_HPP
+#define __HLS_SYMBOL_TABLE_HPP
+
+#include <cstdint>
+#include <deque>
+#include <limits>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+
+namespace hls {
+
+/**
+ * @brief Interned identifier. Two identifiers interned in the same SymbolTable
+ * are equal if and only if their Symbols are equal.
+ */
+using Symbol = std::uint32_t;
+
+/**
+ * @brief Symbol value carried by anything that isn't an interned identifier.
+ */
+constexpr Symbol no_symbol = std::numeric_limits<Symbol>::max();
+
+/**
+ * @brief Interns identifiers, mapping each distinct spelling onto a dense
+ * integer Symbol so that later stages can compare and hash identifiers without
+ * touching their characters.
+ */
+class SymbolTable {
+ public:
+  /**
+   * @brief Class constructor.
+   */
+  SymbolTable() {}
+
+  // Lookup keys are views into names_, so copying would leave them dangling
+  SymbolTable(const SymbolTable&) = delete;
+  SymbolTable& operator=(const SymbolTable&) = delete;
+
+  /**
+   * @brief Intern an identifier.
+   * @param name Spelling of the identifier.
+   * @return The Symbol for the identifier; a new Symbol if this is the first
+   * time the spelling has been seen, otherwise the existing Symbol.
+   */
+  Symbol intern(std::string_view name) {
+    auto existing = ids_.find(name);
+    if (existing != ids_.end()) return existing->second;
+
+    // Strings in a deque never move once they've been pushed, so we can key
+    // the map on views into them
+    Symbol symbol = static_cast<Symbol>(names_.size());
+    ids_.emplace(names_.emplace_back(name), symbol);
+    return symbol;
+  }
+
+  /**
+   * @brief Retrieve the spelling of an interned identifier.
+   * @param symbol The Symbol to look up.
+   * @return Spelling of the identifier.
+   */
+  std::string_view name(Symbol symbol) const { return names_.at(symbol); }
+
+  /**
+   * @brief Number of distinct identifiers that have been interned.
+   * @return Number of Symbols.
+   */
+  std::size_t size() const { return names_.size(); }
+
+ private:
+  std::deque<std::string> names_;
+  std::unordered_map<std::string_view, Symbol> ids_;
+};
+
+}  // namespace hls
+
+#endif /* #ifndef __HLS_SYMBOL_TABLE_HPP */
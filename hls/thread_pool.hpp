@@ -0,0 +1,113 @@
+/**
+ * @file thread_pool.hpp
+ * @author Salvatore Cardamone
+ * @brief Fixed-size pool of worker threads.
+ */
+#ifndef __HLS_THREAD_POOL_HPP
+#define __HLS_THREAD_POOL_HPP
+
+#include <algorithm>
+#include <condition_variable>
+#include <functional>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <queue>
+#include <thread>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+namespace hls {
+
+/**
+ * @brief Fixed number of worker threads servicing a single FIFO queue of
+ * tasks. Results (and exceptions) are handed back through std::futures.
+ */
+class ThreadPool {
+ public:
+  /**
+   * @brief Class constructor. Starts the workers.
+   * @param threads Number of worker threads. If zero, one per hardware thread.
+   */
+  ThreadPool(unsigned threads = 0) {
+    if (threads == 0)
+      threads = std::max(1u, std::thread::hardware_concurrency());
+    workers_.reserve(threads);
+    for (unsigned i = 0; i < threads; ++i)
+      workers_.emplace_back([this] { run(); });
+  }
+
+  /**
+   * @brief Class destructor. Finishes every task that has been submitted and
+   * joins the workers.
+   */
+  ~ThreadPool() {
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      stopping_ = true;
+    }
+    ready_.notify_all();
+    for (auto& worker : workers_) worker.join();
+  }
+
+  // Workers hold a pointer back to the pool
+  ThreadPool(const ThreadPool&) = delete;
+  ThreadPool& operator=(const ThreadPool&) = delete;
+
+  /**
+   * @brief Queue a task for execution on one of the workers.
+   * @param task Callable taking no arguments.
+   * @return Future for the result of the task. Anything thrown by the task is
+   * rethrown from std::future::get().
+   */
+  template <typename F>
+  std::future<std::invoke_result_t<F>> submit(F&& task) {
+    // std::function must be copyable but std::packaged_task isn't, so share it
+    using Result = std::invoke_result_t<F>;
+    auto packaged =
+        std::make_shared<std::packaged_task<Result()>>(std::forward<F>(task));
+    auto result = packaged->get_future();
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      tasks_.emplace([packaged] { (*packaged)(); });
+    }
+    ready_.notify_one();
+    return result;
+  }
+
+  /**
+   * @brief Getter for the number of worker threads.
+   * @return Number of workers.
+   */
+  std::size_t size() const { return workers_.size(); }
+
+ private:
+  std::vector<std::thread> workers_;
+  std::queue<std::function<void()>> tasks_;
+  std::mutex mutex_;
+  std::condition_variable ready_;
+  bool stopping_ = false;
+
+  /**
+   * @brief Worker loop; runs tasks until the pool is stopping and the queue has
+   * drained.
+   */
+  void run() {
+    while (true) {
+      std::function<void()> task;
+      {
+        std::unique_lock<std::mutex> lock(mutex_);
+        ready_.wait(lock, [this] { return stopping_ || !tasks_.empty(); });
+        if (tasks_.empty()) return;
+        task = std::move(tasks_.front());
+        tasks_.pop();
+      }
+      task();
+    }
+  }
+};
+
+}  // namespace hls
+
+#endif /* #ifndef __HLS_THREAD_POOL_HPP */
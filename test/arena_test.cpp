@@ -0,0 +1,56 @@
+/**
+ * @file arena_test.cpp
+ * @author Salvatore Cardamone
+ * @brief Unit tests for the Arena allocator.
+ */
+// clang-format off
+#include <gtest/gtest.h>
+
+#include "hls/arena.hpp"
+// clang-format on
+
+/**
+ * @brief Verify that allocations respect alignment, are laid out
+ * contiguously and that oversized allocations are still satisfied.
+ */
+TEST(ArenaTests, Allocation) {
+  hls::Arena arena(256);
+
+  auto* a = static_cast<char*>(arena.allocate(1, 1));
+  auto* b = static_cast<char*>(arena.allocate(8, 8));
+  auto* c = static_cast<char*>(arena.allocate(8, 8));
+  ASSERT_EQ(reinterpret_cast<std::uintptr_t>(b) % 8, 0);
+  ASSERT_EQ(c, b + 8);
+  ASSERT_GT(b, a);
+  ASSERT_EQ(arena.blocks(), 1);
+
+  // Too big for a block, so gets one of its own
+  arena.allocate(1024, 16);
+  ASSERT_EQ(arena.blocks(), 2);
+  ASSERT_EQ(arena.bytes_allocated(), 1 + 8 + 8 + 1024);
+}
+
+/**
+ * @brief Verify that objects constructed in the Arena are destroyed, in
+ * reverse order, when the Arena is reset.
+ */
+TEST(ArenaTests, Destruction) {
+  std::vector<int> destroyed;
+  struct Tracked {
+    Tracked(std::vector<int>& log, int id) : log_{log}, id_{id} {}
+    ~Tracked() { log_.push_back(id_); }
+    std::vector<int>& log_;
+    int id_;
+  };
+
+  hls::Arena arena;
+  arena.create<Tracked>(destroyed, 1);
+  arena.create<Tracked>(destroyed, 2);
+  arena.create<int>(3);
+  ASSERT_TRUE(destroyed.empty());
+
+  arena.reset();
+  ASSERT_EQ(destroyed, (std::vector<int>{2, 1}));
+  ASSERT_EQ(arena.blocks(), 0);
+  ASSERT_EQ(arena.bytes_allocated(), 0);
+}
@@ -7,6 +7,7 @@
 #include <gtest/gtest.h>
 
 #include "test/ast_test.hpp"
+#include "hls/ast_factory.hpp"
 // clang-format on
 
 /**
@@ -177,3 +178,88 @@ TEST_F(ASTTests, TestFunctionInequality) {
   ASSERT_FALSE(function_ast_ == call_expr_ast_);
   ASSERT_FALSE(function_ast_ == prototype_ast_);
 }
+
+/**
+ * @brief Verify that each node carries the kind of its concrete type.
+ */
+TEST_F(ASTTests, TestKind) {
+  ASSERT_EQ(number_expr_ast_.kind(), hls::ASTKind::number_expr);
+  ASSERT_EQ(variable_expr_ast_.kind(), hls::ASTKind::variable_expr);
+  ASSERT_EQ(binary_expr_ast_.kind(), hls::ASTKind::binary_expr);
+  ASSERT_EQ(if_expr_ast_.kind(), hls::ASTKind::if_expr);
+  ASSERT_EQ(call_expr_ast_.kind(), hls::ASTKind::call_expr);
+  ASSERT_EQ(prototype_ast_.kind(), hls::ASTKind::prototype);
+  ASSERT_EQ(function_ast_.kind(), hls::ASTKind::function);
+}
+
+/**
+ * @brief Verify that structurally equal ASTs hash identically, and that the
+ * hash discriminates between the ASTs that are unequal.
+ */
+TEST_F(ASTTests, TestStructuralHash) {
+  using hls::structural_hash;
+  ASSERT_EQ(structural_hash(number_expr_ast_),
+            structural_hash(number_expr_ast_a_));
+  ASSERT_NE(structural_hash(number_expr_ast_),
+            structural_hash(number_expr_ast_b_));
+  ASSERT_EQ(structural_hash(binary_expr_ast_),
+            structural_hash(binary_expr_ast_a_));
+  ASSERT_NE(structural_hash(binary_expr_ast_),
+            structural_hash(binary_expr_ast_b_));
+  ASSERT_EQ(structural_hash(if_expr_ast_), structural_hash(if_expr_ast_a_));
+  ASSERT_NE(structural_hash(if_expr_ast_), structural_hash(if_expr_ast_b_));
+  ASSERT_EQ(structural_hash(call_expr_ast_), structural_hash(call_expr_ast_a_));
+  ASSERT_NE(structural_hash(call_expr_ast_), structural_hash(call_expr_ast_b_));
+  ASSERT_EQ(structural_hash(prototype_ast_), structural_hash(prototype_ast_a_));
+  ASSERT_NE(structural_hash(prototype_ast_), structural_hash(prototype_ast_b_));
+  ASSERT_EQ(structural_hash(function_ast_), structural_hash(function_ast_a_));
+  ASSERT_NE(structural_hash(function_ast_), structural_hash(function_ast_b_));
+
+  // Same contents but different kinds
+  ASSERT_NE(structural_hash(hls::VariableExprAST("my_func")),
+            structural_hash(hls::PrototypeAST("my_func", {})));
+  // Signed zeros compare equal, so must hash equal
+  ASSERT_EQ(structural_hash(hls::NumberExprAST(0.0)),
+            structural_hash(hls::NumberExprAST(-0.0)));
+}
+
+/**
+ * @brief Verify that for-loops with and without the optional step compare and
+ * hash differently.
+ */
+TEST_F(ASTTests, TestForExprStructure) {
+  auto make_for = [](std::shared_ptr<hls::ExprAST> step) {
+    return hls::ForExprAST("i", std::make_shared<hls::NumberExprAST>(0),
+                           std::make_shared<hls::VariableExprAST>("n"), step,
+                           std::make_shared<hls::VariableExprAST>("i"));
+  };
+  auto with_step = make_for(std::make_shared<hls::NumberExprAST>(1));
+  auto without_step = make_for(nullptr);
+
+  ASSERT_TRUE(with_step == make_for(std::make_shared<hls::NumberExprAST>(1)));
+  ASSERT_TRUE(without_step == make_for(nullptr));
+  ASSERT_FALSE(with_step == without_step);
+  ASSERT_NE(hls::structural_hash(with_step),
+            hls::structural_hash(without_step));
+}
+
+/**
+ * @brief Verify that comparison and hashing of very deep trees doesn't
+ * exhaust the stack.
+ */
+TEST_F(ASTTests, TestDeepStructure) {
+  // Arena-allocated so that tearing down the trees isn't recursive either
+  hls::ASTFactory factory(std::make_shared<hls::Arena>());
+  auto chain = [&factory](double leaf) {
+    auto expr = factory.number(leaf);
+    for (int idx = 0; idx < 200000; ++idx)
+      expr = factory.binary('+', factory.variable("x"), expr);
+    return expr;
+  };
+  auto a = chain(1.0), b = chain(1.0), c = chain(2.0);
+
+  ASSERT_TRUE(*a == *b);
+  ASSERT_FALSE(*a == *c);
+  ASSERT_EQ(hls::structural_hash(*a), hls::structural_hash(*b));
+  ASSERT_NE(hls::structural_hash(*a), hls::structural_hash(*c));
+}
@@ -29,3 +29,36 @@ TEST_F(ASTCodegenTests, Codegen) {
   function_ast_.accept(visitor);
   std::cout << visitor << std::endl;
 }
+
+/**
+ * @brief Verify that the optimisation level selects the pipeline run over each
+ * generated function, that a custom pipeline can be given instead and that an
+ * invalid one is rejected.
+ */
+TEST_F(ASTCodegenTests, OptLevels) {
+  // Both operands compute x * 2, which any optimisation merges
+  auto twice = [] {
+    return std::make_shared<hls::BinaryExprAST>(
+        '*', std::make_shared<hls::VariableExprAST>("x"),
+        std::make_shared<hls::NumberExprAST>(2.0));
+  };
+  hls::FunctionAST function(
+      std::make_shared<hls::PrototypeAST>("f", std::vector<std::string>{"x"}),
+      std::make_shared<hls::BinaryExprAST>('+', twice(), twice()));
+
+  auto instructions = [&function](hls::CodegenOptions options) {
+    hls::ASTCodegen visitor("HLS", false, std::move(options));
+    function.accept(visitor);
+    return visitor.module().getFunction("f")->getInstructionCount();
+  };
+  hls::CodegenOptions o0{hls::OptLevel::O0, "", nullptr, nullptr};
+  hls::CodegenOptions o2{hls::OptLevel::O2, "", nullptr, nullptr};
+  hls::CodegenOptions cse{hls::OptLevel::O0, "early-cse", nullptr, nullptr};
+  ASSERT_EQ(instructions(o0), 4);
+  ASSERT_EQ(instructions(o2), 3);
+  ASSERT_EQ(instructions(cse), 3);
+
+  hls::CodegenOptions invalid{hls::OptLevel::O0, "no-such-pass", nullptr,
+                              nullptr};
+  ASSERT_THROW(hls::ASTCodegen("HLS", false, invalid), std::runtime_error);
+}
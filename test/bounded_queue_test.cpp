@@ -0,0 +1,133 @@
+/**
+ * @file bounded_queue_test.cpp
+ * @author Salvatore Cardamone
+ * @brief Unit tests for the BoundedQueue.
+ */
+// clang-format off
+#include <gtest/gtest.h>
+
+#include <algorithm>
+#include <chrono>
+#include <ctime>
+#include <memory>
+#include <thread>
+#include <vector>
+
+#include "hls/bounded_queue.hpp"
+// clang-format on
+
+/**
+ * @brief Verify first-in first-out order, that a full queue refuses elements
+ * without consuming them, and that an empty one has nothing to give.
+ */
+TEST(BoundedQueueTests, Order) {
+  hls::BoundedQueue<std::unique_ptr<int>> queue(3);
+  ASSERT_EQ(queue.capacity(), 4);
+
+  std::unique_ptr<int> value;
+  ASSERT_FALSE(queue.try_pop(value));
+  // Go round the ring a few times
+  for (int lap = 0; lap < 3; ++lap) {
+    for (int i = 0; i < 4; ++i) {
+      auto element = std::make_unique<int>(lap * 4 + i);
+      ASSERT_TRUE(queue.try_push(element));
+      ASSERT_EQ(element, nullptr);
+    }
+    auto extra = std::make_unique<int>(-1);
+    ASSERT_FALSE(queue.try_push(extra));
+    ASSERT_NE(extra, nullptr);
+    for (int i = 0; i < 4; ++i) {
+      ASSERT_TRUE(queue.try_pop(value));
+      ASSERT_EQ(*value, lap * 4 + i);
+    }
+    ASSERT_FALSE(queue.try_pop(value));
+  }
+
+  // Closing lets what's left drain, and then stops consumers waiting
+  queue.push(std::make_unique<int>(42));
+  queue.close();
+  ASSERT_TRUE(queue.closed());
+  ASSERT_TRUE(queue.pop(value));
+  ASSERT_EQ(*value, 42);
+  ASSERT_FALSE(queue.pop(value));
+}
+
+/**
+ * @brief Verify that every element pushed by several producers is popped by
+ * exactly one of several consumers, and that each producer's elements arrive
+ * in the order they were pushed.
+ */
+TEST(BoundedQueueTests, Concurrent) {
+  constexpr int producers = 3, consumers = 3, count = 20000;
+  // Small, so that both ends have to wait on each other
+  hls::BoundedQueue<int> queue(8);
+
+  std::vector<std::vector<int>> popped(consumers);
+  std::vector<std::thread> threads;
+  for (int c = 0; c < consumers; ++c) {
+    threads.emplace_back([&, c] {
+      int value;
+      while (queue.pop(value)) popped[c].push_back(value);
+    });
+  }
+  std::vector<std::thread> pushers;
+  for (int p = 0; p < producers; ++p) {
+    pushers.emplace_back([&, p] {
+      for (int i = 0; i < count; ++i) queue.push(p * count + i);
+    });
+  }
+  for (auto& thread : pushers) thread.join();
+  queue.close();
+  for (auto& thread : threads) thread.join();
+
+  std::vector<int> all;
+  for (const auto& values : popped) {
+    // A consumer sees each producer's elements in order
+    std::vector<int> last(producers, -1);
+    for (int value : values) {
+      ASSERT_GT(value, last[value / count]);
+      last[value / count] = value;
+    }
+    all.insert(all.end(), values.begin(), values.end());
+  }
+  std::sort(all.begin(), all.end());
+  ASSERT_EQ(all.size(), producers * count);
+  for (int i = 0; i < producers * count; ++i) ASSERT_EQ(all[i], i);
+}
+
+/**
+ * @brief Verify that consumers waiting on an empty queue block rather than
+ * spin, and are woken by a push and by the queue being closed.
+ */
+TEST(BoundedQueueTests, Blocking) {
+  constexpr int consumers = 3;
+  hls::BoundedQueue<int> queue(4);
+  std::vector<int> popped(consumers, 0);
+  std::vector<std::thread> threads;
+  for (int c = 0; c < consumers; ++c) {
+    threads.emplace_back([&, c] {
+      int value;
+      while (queue.pop(value)) popped[c] += value;
+    });
+  }
+
+  // With nothing to do, the consumers use next to no processor time; this
+  // thread is asleep, so any time used is theirs
+  std::this_thread::sleep_for(std::chrono::milliseconds(50));
+  const std::clock_t start = std::clock();
+  std::this_thread::sleep_for(std::chrono::milliseconds(200));
+  const double used =
+      static_cast<double>(std::clock() - start) / CLOCKS_PER_SEC;
+  ASSERT_LT(used, 0.05);
+
+  for (int i = 1; i <= 100; ++i) {
+    queue.push(i);
+    // Let the consumers go back to sleep now and then
+    if (i % 10 == 0) std::this_thread::sleep_for(std::chrono::milliseconds(5));
+  }
+  queue.close();
+  for (auto& thread : threads) thread.join();
+  int total = 0;
+  for (int sum : popped) total += sum;
+  ASSERT_EQ(total, 5050);
+}
@@ -0,0 +1,196 @@
+/**
+ * @file compile_cache_test.cpp
+ * @author Salvatore Cardamone
+ * @brief Unit tests for the persistent compilation cache.
+ */
+// clang-format off
+#include <gtest/gtest.h>
+#include <llvm/IR/Verifier.h>
+#include <llvm/Support/raw_ostream.h>
+
+#include <cmath>
+#include <filesystem>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "hls/compile_cache.hpp"
+#include "hls/driver.hpp"
+#include "hls/jit.hpp"
+// clang-format on
+
+/**
+ * @brief Fixture providing an empty cache directory, removed afterwards. Each
+ * test has a directory of its own, since CTest may run them concurrently.
+ */
+class CompileCacheTests : public ::testing::Test {
+ protected:
+  CompileCacheTests() { std::filesystem::remove_all(directory_); }
+  ~CompileCacheTests() { std::filesystem::remove_all(directory_); }
+
+  const std::string directory_ =
+      (std::filesystem::temp_directory_path() /
+       ("hls_cache_" + std::string(::testing::UnitTest::GetInstance()
+                                       ->current_test_info()
+                                       ->name())))
+          .string();
+  const std::string source_ =
+      "extern sin(x)\n"
+      "def square(x) x * x\n"
+      "def f(x) square(x) + sin(x)\n"
+      "def g(x) for i = 0, i < x in f(i)\n";
+
+  /**
+   * @brief Print a module's IR, for comparison.
+   * @param module The module.
+   * @return The IR.
+   */
+  static std::string print(const llvm::Module& module) {
+    std::string ir;
+    llvm::raw_string_ostream os(ir);
+    module.print(os, nullptr);
+    return os.str();
+  }
+};
+
+/**
+ * @brief Verify that functions are generated once, and reused by later
+ * compilations with the same options, giving identical IR.
+ */
+TEST_F(CompileCacheTests, Reuse) {
+  hls::CodegenOptions options;
+  options.cache = std::make_shared<hls::CompileCache>(directory_);
+
+  auto first = hls::Driver::compile_source(source_, "cached", options);
+  auto stats = options.cache->stats();
+  ASSERT_EQ(stats.hits, 0);
+  ASSERT_EQ(stats.misses, 3);
+
+  // A new cache over the same directory stands in for a later run
+  options.cache = std::make_shared<hls::CompileCache>(directory_);
+  auto second = hls::Driver::compile_source(source_, "cached", options);
+  stats = options.cache->stats();
+  ASSERT_EQ(stats.hits, 3);
+  ASSERT_EQ(stats.misses, 0);
+  ASSERT_FALSE(llvm::verifyModule(*second.module, &llvm::errs()));
+  ASSERT_EQ(print(*second.module), print(*first.module));
+
+  // Only the function that changed is generated again
+  options.cache = std::make_shared<hls::CompileCache>(directory_);
+  hls::Driver::compile_source(
+      "extern sin(x)\n"
+      "def square(x) x * x * 1\n"
+      "def f(x) square(x) + sin(x)\n",
+      "changed", options);
+  stats = options.cache->stats();
+  ASSERT_EQ(stats.hits, 1);
+  ASSERT_EQ(stats.misses, 1);
+}
+
+/**
+ * @brief Verify that a cached function isn't reused once a function it calls
+ * has a different signature, so the call is still checked.
+ */
+TEST_F(CompileCacheTests, CalleeSignature) {
+  hls::CodegenOptions options;
+  options.opt_level = hls::OptLevel::O0;
+  options.cache = std::make_shared<hls::CompileCache>(directory_);
+  hls::Driver::compile_source("extern foo(a)\ndef f(x) foo(x)\n", "unary",
+                              options);
+
+  options.cache = std::make_shared<hls::CompileCache>(directory_);
+  auto binary = hls::Driver::compile_source(
+      "extern foo(a b)\ndef f(x) foo(x)\n", "binary", options);
+  auto stats = options.cache->stats();
+  ASSERT_EQ(stats.hits, 0);
+  ASSERT_EQ(stats.misses, 1);
+  auto* f = binary.module->getFunction("f");
+  ASSERT_TRUE(!f || f->isDeclaration());
+  ASSERT_FALSE(llvm::verifyModule(*binary.module, &llvm::errs()));
+
+  // Nor once the callee isn't declared at all
+  options.cache = std::make_shared<hls::CompileCache>(directory_);
+  hls::Driver::compile_source("def f(x) foo(x)\n", "undeclared", options);
+  ASSERT_EQ(options.cache->stats().hits, 0);
+
+  // But it is with the same signature, whatever the arguments are called
+  options.cache = std::make_shared<hls::CompileCache>(directory_);
+  hls::Driver::compile_source("extern foo(b)\ndef f(x) foo(x)\n", "renamed",
+                              options);
+  ASSERT_EQ(options.cache->stats().hits, 1);
+}
+
+/**
+ * @brief Verify that functions optimised differently don't share entries.
+ */
+TEST_F(CompileCacheTests, Options) {
+  hls::CodegenOptions options;
+  options.cache = std::make_shared<hls::CompileCache>(directory_);
+  hls::Driver::compile_source(source_, "O2", options);
+
+  options.opt_level = hls::OptLevel::O0;
+  hls::Driver::compile_source(source_, "O0", options);
+  options.pipeline = "instcombine";
+  hls::Driver::compile_source(source_, "instcombine", options);
+  auto stats = options.cache->stats();
+  ASSERT_EQ(stats.hits, 0);
+  ASSERT_EQ(stats.misses, 9);
+}
+
+/**
+ * @brief Verify that the JIT reuses machine code compiled by an earlier JIT.
+ */
+TEST_F(CompileCacheTests, JIT) {
+  hls::CodegenOptions options;
+  options.cache = std::make_shared<hls::CompileCache>(directory_);
+  {
+    hls::JIT jit(options);
+    ASSERT_EQ(jit.run(source_ + "f(2)\n"),
+              std::vector<double>{4 + std::sin(2)});
+  }
+  auto stats = options.cache->stats();
+  ASSERT_EQ(stats.object_hits, 0);
+  ASSERT_GT(stats.object_misses, 0);
+
+  options.cache = std::make_shared<hls::CompileCache>(directory_);
+  {
+    hls::JIT jit(options);
+    ASSERT_EQ(jit.run(source_ + "f(2)\n"),
+              std::vector<double>{4 + std::sin(2)});
+  }
+  // The top-level expression is generated as a function too, so is also found
+  stats = options.cache->stats();
+  ASSERT_EQ(stats.hits, 4);
+  ASSERT_EQ(stats.misses, 0);
+  ASSERT_GT(stats.object_hits, 0);
+  ASSERT_EQ(stats.object_misses, 0);
+}
+
+/**
+ * @brief Verify that machine code is only reused on the target it was compiled
+ * for.
+ */
+TEST_F(CompileCacheTests, ObjectTarget) {
+  auto cache = std::make_shared<hls::CompileCache>(directory_);
+  llvm::LLVMContext context;
+  llvm::Module module("m", context);
+  const char object[] = "machine code";
+  llvm::MemoryBufferRef buffer(llvm::StringRef(object, sizeof(object)), "m");
+
+  hls::TargetObjectCache x86(cache, "x86_64-unknown-linux-gnu", "skylake", "");
+  x86.notifyObjectCompiled(&module, buffer);
+  ASSERT_NE(x86.getObject(&module), nullptr);
+
+  hls::TargetObjectCache cpu(cache, "x86_64-unknown-linux-gnu", "znver3", "");
+  ASSERT_EQ(cpu.getObject(&module), nullptr);
+  hls::TargetObjectCache features(cache, "x86_64-unknown-linux-gnu", "skylake",
+                                  "-avx2");
+  ASSERT_EQ(features.getObject(&module), nullptr);
+  hls::TargetObjectCache triple(cache, "aarch64-unknown-linux-gnu", "skylake",
+                                "");
+  ASSERT_EQ(triple.getObject(&module), nullptr);
+
+  auto stats = cache->stats();
+  ASSERT_EQ(stats.object_hits, 1);
+  ASSERT_EQ(stats.object_misses, 3);
+}
@@ -0,0 +1,243 @@
+/**
+ * @file constraint_graph_test.cpp
+ * @author Salvatore Cardamone
+ * @brief Unit tests for the ConstraintGraph class and the solving of
+ * difference constraints.
+ */
+// clang-format off
+#include <gtest/gtest.h>
+
+#include <algorithm>
+#include <limits>
+#include <memory>
+#include <random>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include "hls/constraint_graph.hpp"
+#include "hls/csr_graph.hpp"
+#include "hls/graph.hpp"
+#include "hls/graph_visitor.hpp"
+// clang-format on
+
+/**
+ * @brief Verify that constraints share the vertices of their variables, may
+ * bound a difference both ways, and that only the tightest bound is kept.
+ */
+TEST(ConstraintGraphTests, Construction) {
+  hls::ConstraintGraph graph;
+  graph.add_constraint(hls::ConstraintExpr("a", "b", 3));
+  graph.add_constraint(hls::ConstraintExpr("b", "a", -1));
+  graph.add_constraint(hls::ConstraintExpr("a", "b", 5));
+  graph.add_constraint(hls::ConstraintExpr("c", "b", 2));
+  graph.add_constraint(hls::ConstraintExpr("c", "b", 1));
+  // Trivially true, so adds nothing
+  graph.add_constraint(hls::ConstraintExpr("a", "a", 0));
+  ASSERT_THROW(graph.vertex("d"), std::runtime_error);
+
+  auto a = graph.vertex("a"), b = graph.vertex("b"), c = graph.vertex("c");
+  ASSERT_EQ(a->name(), "a");
+  auto b_outputs = graph.outputs(b);
+  ASSERT_EQ(b_outputs.size(), 2);
+  ASSERT_EQ(b_outputs[0].dest(), a);
+  ASSERT_EQ(b_outputs[0].weight(), 3);
+  ASSERT_EQ(b_outputs[1].dest(), c);
+  ASSERT_EQ(b_outputs[1].weight(), 1);
+  ASSERT_EQ(graph.inputs(c)[0].weight(), 1);
+  ASSERT_EQ(graph.destinations(a), std::vector<hls::Graph::vptr>({b}));
+
+  auto constraint = hls::ConstraintGraph::constraint(graph.outputs(a)[0]);
+  ASSERT_EQ(constraint.xa(), "b");
+  ASSERT_EQ(constraint.xb(), "a");
+  ASSERT_EQ(constraint.b(), -1);
+
+  hls::CSRGraph csr(graph);
+  ASSERT_EQ(csr.num_vertices(), 3);
+  ASSERT_EQ(csr.num_edges(), 3);
+}
+
+/**
+ * @brief Verify that a satisfiable system is given an assignment that meets
+ * every constraint.
+ */
+TEST(ConstraintGraphTests, Feasible) {
+  // A small schedule: b at least 2 after a, c at least 1 after b, d at least
+  // 1 after a and no more than 1 before c, and all within 4 of a
+  std::vector<hls::ConstraintExpr> constraints{
+      {"a", "b", -2}, {"b", "c", -1}, {"a", "d", -1},
+      {"d", "c", 1},  {"c", "a", 4},  {"d", "a", 4}};
+  hls::ConstraintGraph graph;
+  for (const auto& constraint : constraints) graph.add_constraint(constraint);
+
+  hls::GraphBellmanFord solver;
+  graph.accept(solver);
+  ASSERT_TRUE(solver.feasible());
+  ASSERT_TRUE(solver.cycle().empty());
+  for (const auto& constraint : constraints) {
+    ASSERT_LE(solver.distance(graph.vertex(constraint.xa())) -
+                  solver.distance(graph.vertex(constraint.xb())),
+              constraint.b());
+  }
+  ASSERT_EQ(solver.distance(graph.vertex("c")) -
+                solver.distance(graph.vertex("a")),
+            3);
+  ASSERT_THROW(solver.distance(std::make_shared<hls::Vertex>()),
+               std::runtime_error);
+}
+
+/**
+ * @brief Verify that an unsatisfiable system is reported along with the
+ * constraints that conflict.
+ */
+TEST(ConstraintGraphTests, Infeasible) {
+  hls::ConstraintGraph graph;
+  // b after a, c after b, but c no later than a, plus some bystanders
+  graph.add_constraint(hls::ConstraintExpr("a", "b", -1));
+  graph.add_constraint(hls::ConstraintExpr("b", "c", -1));
+  graph.add_constraint(hls::ConstraintExpr("c", "a", 1));
+  graph.add_constraint(hls::ConstraintExpr("d", "a", 5));
+  graph.add_constraint(hls::ConstraintExpr("a", "e", 0));
+
+  hls::GraphBellmanFord solver;
+  graph.accept(solver);
+  ASSERT_FALSE(solver.feasible());
+  const auto& cycle = solver.cycle();
+  ASSERT_EQ(cycle.size(), 3);
+  int total = 0;
+  for (std::size_t i = 0; i < cycle.size(); ++i) {
+    ASSERT_EQ(cycle[i].dest(), cycle[(i + 1) % cycle.size()].src());
+    total += cycle[i].weight();
+  }
+  ASSERT_EQ(total, -1);
+
+  std::vector<std::string> conflicting;
+  for (const auto& edge : cycle) {
+    auto constraint = hls::ConstraintGraph::constraint(edge);
+    conflicting.push_back(constraint.xa() + "-" + constraint.xb());
+  }
+  std::sort(conflicting.begin(), conflicting.end());
+  ASSERT_EQ(conflicting, std::vector<std::string>({"a-b", "b-c", "c-a"}));
+}
+
+/**
+ * @brief Verify that a variable constrained against itself is accepted, and
+ * that a constraint it can't meet is reported as a cycle on its own.
+ */
+TEST(ConstraintGraphTests, SelfConstraint) {
+  hls::ConstraintGraph graph;
+  graph.add_constraint(hls::ConstraintExpr("a", "b", -1));
+  graph.add_constraint(hls::ConstraintExpr("b", "b", 2));
+  hls::GraphBellmanFord trivial;
+  graph.accept(trivial);
+  ASSERT_TRUE(trivial.feasible());
+  ASSERT_EQ(hls::CSRGraph(graph).num_edges(), 1);
+
+  graph.add_constraint(hls::ConstraintExpr("b", "b", -1));
+  graph.add_constraint(hls::ConstraintExpr("b", "b", -3));
+  graph.add_constraint(hls::ConstraintExpr("b", "b", -2));
+  hls::CSRGraph csr(graph);
+  ASSERT_EQ(csr.num_edges(), 2);
+  hls::GraphBellmanFord solver;
+  csr.accept(solver);
+  ASSERT_FALSE(solver.feasible());
+  const auto& cycle = solver.cycle();
+  ASSERT_EQ(cycle.size(), 1);
+  ASSERT_EQ(cycle[0].src(), graph.vertex("b"));
+  ASSERT_EQ(cycle[0].dest(), graph.vertex("b"));
+  auto constraint = hls::ConstraintGraph::constraint(cycle[0]);
+  ASSERT_EQ(constraint.xa(), "b");
+  ASSERT_EQ(constraint.xb(), "b");
+  ASSERT_EQ(constraint.b(), -3);
+}
+
+/**
+ * @brief Verify shortest paths from a single source, through negative weights
+ * and to an unreachable Vertex.
+ */
+TEST(ConstraintGraphTests, SingleSource) {
+  hls::Graph graph;
+  std::vector<std::shared_ptr<hls::Vertex>> v;
+  for (int i = 0; i < 5; ++i) v.push_back(std::make_shared<hls::Vertex>());
+  graph.add_edge(v[0], v[1], 4);
+  graph.add_edge(v[0], v[2], 2);
+  graph.add_edge(v[2], v[1], -3);
+  graph.add_edge(v[1], v[3], 1);
+  graph.add_vertex(v[4]);
+
+  hls::GraphBellmanFord solver(v[0]);
+  graph.accept(solver);
+  ASSERT_TRUE(solver.feasible());
+  ASSERT_EQ(solver.distance(v[0]), 0);
+  ASSERT_EQ(solver.distance(v[1]), -1);
+  ASSERT_EQ(solver.distance(v[2]), 2);
+  ASSERT_EQ(solver.distance(v[3]), 0);
+  ASSERT_EQ(solver.distance(v[4]), std::numeric_limits<int>::max());
+
+  hls::GraphBellmanFord unknown(std::make_shared<hls::Vertex>());
+  ASSERT_THROW(graph.accept(unknown), std::runtime_error);
+}
+
+/**
+ * @brief Verify the solver against a plain Bellman-Ford on random systems of
+ * constraints, some of them unsatisfiable.
+ */
+TEST(ConstraintGraphTests, Random) {
+  std::mt19937 random(42);
+  int infeasible = 0;
+  for (int trial = 0; trial < 200; ++trial) {
+    const int variables = 2 + trial % 20;
+    std::uniform_int_distribution<int> variable(0, variables - 1);
+    std::uniform_int_distribution<int> bound(-4, 10);
+
+    hls::ConstraintGraph graph;
+    std::vector<hls::ConstraintExpr> constraints;
+    for (int i = 0; i < 2 * variables; ++i) {
+      int xa = variable(random), xb = variable(random);
+      if (xa == xb) continue;
+      constraints.emplace_back("x" + std::to_string(xa),
+                               "x" + std::to_string(xb), bound(random));
+      graph.add_constraint(constraints.back());
+    }
+
+    // Relax every constraint V times; any that can still be relaxed
+    // afterwards lie on (or downstream of) a negative cycle
+    hls::CSRGraph csr(graph);
+    std::vector<int> reference(csr.num_vertices(), 0);
+    bool changed = true;
+    for (std::size_t pass = 0; pass <= csr.num_vertices() && changed;
+         ++pass) {
+      changed = false;
+      for (const auto& constraint : constraints) {
+        auto a = csr.id(graph.vertex(constraint.xa()));
+        auto b = csr.id(graph.vertex(constraint.xb()));
+        if (reference[b] + constraint.b() < reference[a]) {
+          reference[a] = reference[b] + constraint.b();
+          changed = true;
+        }
+      }
+    }
+
+    hls::GraphBellmanFord solver;
+    csr.accept(solver);
+    ASSERT_EQ(solver.feasible(), !changed);
+    if (!solver.feasible()) {
+      ++infeasible;
+      int total = 0;
+      const auto& cycle = solver.cycle();
+      for (std::size_t i = 0; i < cycle.size(); ++i) {
+        ASSERT_EQ(cycle[i].dest(), cycle[(i + 1) % cycle.size()].src());
+        total += cycle[i].weight();
+      }
+      ASSERT_LT(total, 0);
+      continue;
+    }
+    // Shortest paths from the virtual source are unique
+    for (hls::CSRGraph::vertex_id i = 0; i < csr.num_vertices(); ++i) {
+      ASSERT_EQ(solver.distance(csr.vertex(i)), reference[i]);
+    }
+  }
+  // Make sure both outcomes were exercised
+  ASSERT_GT(infeasible, 10);
+  ASSERT_LT(infeasible, 190);
+}
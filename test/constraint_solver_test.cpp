@@ -0,0 +1,192 @@
+/**
+ * @file constraint_solver_test.cpp
+ * @author Salvatore Cardamone
+ * @brief Unit tests for the IncrementalConstraintSolver class.
+ */
+// clang-format off
+#include <gtest/gtest.h>
+
+#include <random>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include "hls/constraint_graph.hpp"
+#include "hls/constraint_solver.hpp"
+#include "hls/graph_visitor.hpp"
+// clang-format on
+
+/**
+ * @brief Verify that every constraint holds in the solver's assignment.
+ * @param solver The solver.
+ * @param constraints The constraints it's been given.
+ * @return Whether they all hold.
+ */
+static bool satisfied(const hls::IncrementalConstraintSolver& solver,
+                      const std::vector<hls::ConstraintExpr>& constraints) {
+  for (const auto& constraint : constraints) {
+    if (solver.value(constraint.xa()) - solver.value(constraint.xb()) >
+        constraint.b()) {
+      return false;
+    }
+  }
+  return true;
+}
+
+/**
+ * @brief Verify that a conflict is a cycle of constraints of negative weight.
+ * @param conflict The constraints in the conflict.
+ * @return Whether it is.
+ */
+static bool negative_cycle(const std::vector<hls::ConstraintExpr>& conflict) {
+  int total = 0;
+  for (std::size_t i = 0; i < conflict.size(); ++i) {
+    // Each constraint's x_a is the next one's x_b
+    if (conflict[i].xa() != conflict[(i + 1) % conflict.size()].xb())
+      return false;
+    total += conflict[i].b();
+  }
+  return !conflict.empty() && total < 0;
+}
+
+/**
+ * @brief Verify that constraints are satisfied as they're added, that one
+ * that can't be is rejected with the reason, and that removing a constraint
+ * makes room for it.
+ */
+TEST(ConstraintSolverTests, Edits) {
+  hls::IncrementalConstraintSolver solver;
+  std::vector<hls::ConstraintExpr> constraints{
+      {"b", "a", -2}, {"c", "b", -1}, {"c", "a", -4}, {"d", "c", 0}};
+  for (const auto& constraint : constraints) {
+    ASSERT_TRUE(solver.add_constraint(constraint));
+    ASSERT_TRUE(solver.conflict().empty());
+  }
+  ASSERT_TRUE(satisfied(solver, constraints));
+  ASSERT_EQ(solver.size(), 4);
+  ASSERT_EQ(solver.num_variables(), 4);
+  ASSERT_EQ(solver.value("e"), 0);
+
+  // c is at least 4 after a, so can't also be within 3 of it
+  hls::ConstraintExpr deadline("a", "c", 3);
+  ASSERT_FALSE(solver.add_constraint(deadline));
+  ASSERT_TRUE(satisfied(solver, constraints));
+  ASSERT_EQ(solver.size(), 4);
+  const auto& conflict = solver.conflict();
+  ASSERT_TRUE(negative_cycle(conflict));
+  ASSERT_EQ(conflict.size(), 2);
+  ASSERT_EQ(conflict[0].xa(), "a");
+  ASSERT_EQ(conflict[0].xb(), "c");
+  ASSERT_EQ(conflict[1].b(), -4);
+
+  // Without the tightest of the constraints, the deadline can be met
+  solver.remove_constraint(constraints[2]);
+  constraints.erase(constraints.begin() + 2);
+  ASSERT_TRUE(solver.add_constraint(deadline));
+  constraints.push_back(deadline);
+  ASSERT_TRUE(satisfied(solver, constraints));
+  ASSERT_EQ(solver.value("c") - solver.value("a"), -3);
+
+  ASSERT_THROW(solver.remove_constraint(hls::ConstraintExpr("b", "a", -3)),
+               std::runtime_error);
+  ASSERT_THROW(solver.remove_constraint(hls::ConstraintExpr("x", "a", 0)),
+               std::runtime_error);
+}
+
+/**
+ * @brief Verify that a variable constrained against itself is accepted if the
+ * constraint holds trivially, and rejected as a conflict on its own if not.
+ */
+TEST(ConstraintSolverTests, SelfConstraint) {
+  hls::IncrementalConstraintSolver solver;
+  ASSERT_TRUE(solver.add_constraint(hls::ConstraintExpr("a", "b", -1)));
+  ASSERT_TRUE(solver.add_constraint(hls::ConstraintExpr("b", "b", 2)));
+  ASSERT_TRUE(solver.add_constraint(hls::ConstraintExpr("c", "c", 0)));
+  ASSERT_EQ(solver.size(), 3);
+  ASSERT_EQ(solver.num_variables(), 3);
+  ASSERT_EQ(solver.value("a") - solver.value("b"), -1);
+
+  hls::ConstraintExpr never("b", "b", -1);
+  ASSERT_FALSE(solver.add_constraint(never));
+  ASSERT_EQ(solver.conflict().size(), 1);
+  ASSERT_TRUE(negative_cycle(solver.conflict()));
+  ASSERT_EQ(solver.size(), 3);
+
+  // Nor does it leave an edge behind to get in the way
+  solver.remove_constraint(hls::ConstraintExpr("b", "b", 2));
+  solver.remove_constraint(hls::ConstraintExpr("c", "c", 0));
+  ASSERT_THROW(solver.remove_constraint(hls::ConstraintExpr("c", "c", 0)),
+               std::runtime_error);
+  ASSERT_TRUE(solver.add_constraint(hls::ConstraintExpr("b", "a", 1)));
+  ASSERT_EQ(solver.size(), 2);
+}
+
+/**
+ * @brief Verify that the looser of two bounds on the same difference takes
+ * over once the tighter one is removed.
+ */
+TEST(ConstraintSolverTests, RepeatedBounds) {
+  hls::IncrementalConstraintSolver solver;
+  ASSERT_TRUE(solver.add_constraint(hls::ConstraintExpr("a", "b", -1)));
+  ASSERT_TRUE(solver.add_constraint(hls::ConstraintExpr("a", "b", -5)));
+  ASSERT_TRUE(solver.add_constraint(hls::ConstraintExpr("a", "b", -1)));
+  ASSERT_EQ(solver.size(), 3);
+  ASSERT_FALSE(solver.add_constraint(hls::ConstraintExpr("b", "a", 4)));
+
+  solver.remove_constraint(hls::ConstraintExpr("a", "b", -5));
+  ASSERT_TRUE(solver.add_constraint(hls::ConstraintExpr("b", "a", 4)));
+  solver.remove_constraint(hls::ConstraintExpr("a", "b", -1));
+  ASSERT_FALSE(solver.add_constraint(hls::ConstraintExpr("b", "a", 0)));
+  solver.remove_constraint(hls::ConstraintExpr("a", "b", -1));
+  ASSERT_TRUE(solver.add_constraint(hls::ConstraintExpr("b", "a", 0)));
+  ASSERT_EQ(solver.size(), 2);
+}
+
+/**
+ * @brief Verify the solver against solving from scratch, over random
+ * sequences of edits.
+ */
+TEST(ConstraintSolverTests, Random) {
+  std::mt19937 random(7);
+  int rejected = 0;
+  for (int trial = 0; trial < 20; ++trial) {
+    const int variables = 3 + trial;
+    std::uniform_int_distribution<int> variable(0, variables - 1);
+    std::uniform_int_distribution<int> bound(-3, 8);
+
+    hls::IncrementalConstraintSolver solver;
+    std::vector<hls::ConstraintExpr> constraints;
+    for (int edit = 0; edit < 20 * variables; ++edit) {
+      if (!constraints.empty() && random() % 3 == 0) {
+        std::size_t removed = random() % constraints.size();
+        solver.remove_constraint(constraints[removed]);
+        constraints.erase(constraints.begin() + removed);
+        ASSERT_TRUE(satisfied(solver, constraints));
+        continue;
+      }
+
+      int xa = variable(random), xb = variable(random);
+      hls::ConstraintExpr added("x" + std::to_string(xa),
+                                "x" + std::to_string(xb), bound(random));
+      hls::ConstraintGraph graph;
+      for (const auto& constraint : constraints) {
+        graph.add_constraint(constraint);
+      }
+      graph.add_constraint(added);
+      hls::GraphBellmanFord scratch;
+      graph.accept(scratch);
+
+      bool accepted = solver.add_constraint(added);
+      ASSERT_EQ(accepted, scratch.feasible());
+      if (accepted) {
+        constraints.push_back(added);
+      } else {
+        ++rejected;
+        ASSERT_TRUE(negative_cycle(solver.conflict()));
+      }
+      ASSERT_TRUE(satisfied(solver, constraints));
+      ASSERT_EQ(solver.size(), constraints.size());
+    }
+  }
+  ASSERT_GT(rejected, 50);
+}
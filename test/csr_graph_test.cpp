@@ -0,0 +1,100 @@
+/**
+ * @file csr_graph_test.cpp
+ * @author Salvatore Cardamone
+ * @brief Unit tests for the CSRGraph class.
+ */
+// clang-format off
+#include <gtest/gtest.h>
+
+#include <memory>
+#include <stdexcept>
+#include <vector>
+
+#include "hls/csr_graph.hpp"
+#include "hls/graph.hpp"
+// clang-format on
+
+/**
+ * @brief Verify that the compressed graph has the same vertices and edges as
+ * the Graph it was built from, in both directions.
+ */
+TEST(CSRGraphTests, Connections) {
+  hls::Graph graph;
+
+  auto vertex_a = std::make_shared<hls::Vertex>();
+  auto vertex_b = std::make_shared<hls::Vertex>();
+  auto vertex_c = std::make_shared<hls::Vertex>();
+  auto vertex_d = std::make_shared<hls::Vertex>();
+  auto vertex_e = std::make_shared<hls::Vertex>();
+
+  // E -> A -> B -> C and A -> C, with D on its own
+  graph.add_edge(vertex_a, vertex_b, 1);
+  graph.add_edge(vertex_b, vertex_c, 2);
+  graph.add_edge(vertex_a, vertex_c, -3);
+  graph.add_vertex(vertex_d);
+  graph.add_edge(vertex_e, vertex_a, 4);
+
+  hls::CSRGraph csr(graph);
+  ASSERT_EQ(csr.num_vertices(), 5);
+  ASSERT_EQ(csr.num_edges(), 4);
+
+  // Vertices are numbered in the order they were added
+  auto a = csr.id(vertex_a), b = csr.id(vertex_b), c = csr.id(vertex_c),
+       d = csr.id(vertex_d), e = csr.id(vertex_e);
+  ASSERT_EQ(std::vector<hls::CSRGraph::vertex_id>({a, b, c, d, e}),
+            std::vector<hls::CSRGraph::vertex_id>({0, 1, 2, 3, 4}));
+  ASSERT_EQ(csr.vertex(c), vertex_c);
+  ASSERT_THROW(csr.id(std::make_shared<hls::Vertex>()), std::runtime_error);
+
+  auto as_vector = [](auto span) {
+    return std::vector<std::decay_t<decltype(span[0])>>(span.begin(),
+                                                         span.end());
+  };
+  using ids = std::vector<hls::CSRGraph::vertex_id>;
+  ASSERT_EQ(as_vector(csr.destinations(a)), ids({b, c}));
+  ASSERT_EQ(as_vector(csr.weights(a)), std::vector<int>({1, -3}));
+  ASSERT_EQ(as_vector(csr.destinations(e)), ids({a}));
+  ASSERT_TRUE(csr.destinations(c).empty());
+  ASSERT_TRUE(csr.destinations(d).empty());
+  ASSERT_EQ(csr.out_degree(b), 1);
+
+  ASSERT_EQ(as_vector(csr.sources(c)), ids({a, b}));
+  ASSERT_EQ(csr.in_degree(c), 2);
+  ASSERT_EQ(csr.in_degree(d), 0);
+  ASSERT_EQ(as_vector(csr.sources(a)), ids({e}));
+
+  // Edges are numbered by source, and input edges refer back to them
+  for (hls::CSRGraph::vertex_id v = 0; v < csr.num_vertices(); ++v) {
+    for (auto edge = csr.out_begin(v); edge != csr.out_end(v); ++edge) {
+      ASSERT_EQ(csr.source(edge), v);
+    }
+    auto sources = csr.sources(v);
+    auto in_edges = csr.in_edges(v);
+    ASSERT_EQ(sources.size(), in_edges.size());
+    for (std::size_t i = 0; i < in_edges.size(); ++i) {
+      ASSERT_EQ(csr.source(in_edges[i]), sources[i]);
+      ASSERT_EQ(csr.destination(in_edges[i]), v);
+    }
+  }
+  ASSERT_EQ(csr.weight(csr.in_edges(a)[0]), 4);
+
+  // The compressed graph is a snapshot
+  graph.add_edge(vertex_d, vertex_b, 5);
+  ASSERT_EQ(csr.num_edges(), 4);
+}
+
+/**
+ * @brief Verify that a graph with no vertices, or no edges, compresses.
+ */
+TEST(CSRGraphTests, Empty) {
+  hls::Graph graph;
+  hls::CSRGraph empty(graph);
+  ASSERT_EQ(empty.num_vertices(), 0);
+  ASSERT_EQ(empty.num_edges(), 0);
+
+  graph.add_vertex(std::make_shared<hls::Vertex>());
+  hls::CSRGraph unconnected(graph);
+  ASSERT_EQ(unconnected.num_vertices(), 1);
+  ASSERT_TRUE(unconnected.destinations(0).empty());
+  ASSERT_TRUE(unconnected.sources(0).empty());
+}
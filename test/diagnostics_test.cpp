@@ -0,0 +1,145 @@
+/**
+ * @file diagnostics_test.cpp
+ * @author Salvatore Cardamone
+ * @brief Unit tests for the reporting of diagnostics.
+ */
+// clang-format off
+#include <gtest/gtest.h>
+
+#include <memory>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include "hls/ast_visitor.hpp"
+#include "hls/diagnostics.hpp"
+#include "hls/driver.hpp"
+#include "hls/jit.hpp"
+#include "hls/lexer.hpp"
+#include "hls/parser.hpp"
+// clang-format on
+
+/**
+ * @brief Verify that the engine stamps diagnostics with their source and
+ * counts them, and that they're printed in the usual form.
+ */
+TEST(DiagnosticsTests, Engine) {
+  auto sink = std::make_shared<hls::BufferedDiagnosticSink>();
+  hls::DiagnosticEngine engine(sink, "file.k");
+  engine.error("Something broke.", {3, 7});
+  engine.warning("Something looks odd.");
+  ASSERT_EQ(engine.errors(), 1);
+  ASSERT_EQ(engine.count(hls::Severity::warning), 1);
+
+  auto diagnostics = sink->diagnostics();
+  ASSERT_EQ(diagnostics.size(), 2);
+  std::stringstream printed;
+  printed << diagnostics[0] << "\n" << diagnostics[1];
+  ASSERT_EQ(printed.str(),
+            "file.k:3:7: error: Something broke.\n"
+            "file.k: warning: Something looks odd.");
+  sink->clear();
+  ASSERT_TRUE(sink->diagnostics().empty());
+
+  std::stringstream stream;
+  hls::DiagnosticEngine printing(
+      std::make_shared<hls::StreamDiagnosticSink>(stream));
+  printing.error("Unlocated.");
+  ASSERT_EQ(stream.str(), "error: Unlocated.\n");
+}
+
+/**
+ * @brief Verify that syntax errors are reported at the token where parsing
+ * failed, and that nothing is reported without a sink.
+ */
+TEST(DiagnosticsTests, Parser) {
+  std::string source =
+      "def f(x) x + 1\n"
+      "def g(x) (x + \n"
+      "  )\n"
+      "1.2.3 + f(2)\n";
+  auto sink = std::make_shared<hls::BufferedDiagnosticSink>();
+  auto engine = std::make_shared<hls::DiagnosticEngine>(sink, "source.k");
+  hls::Lexer lexer(source, nullptr, engine);
+  hls::Parser parser(lexer);
+  while (!parser.eof()) parser.step();
+
+  auto diagnostics = sink->diagnostics();
+  ASSERT_EQ(engine->errors(), 2);
+  ASSERT_EQ(diagnostics[0].source, "source.k");
+  ASSERT_EQ(diagnostics[0].message, "Couldn't parse RHS in binop.");
+  ASSERT_EQ(diagnostics[0].location.line, 3);
+  ASSERT_EQ(diagnostics[0].location.column, 3);
+  // The lexer reports through the same engine
+  ASSERT_EQ(diagnostics[1].message, "Malformed numerical constant 1.2.3.");
+  ASSERT_EQ(diagnostics[1].location.line, 4);
+  ASSERT_EQ(diagnostics[1].location.column, 1);
+
+  // Without an engine, errors are still counted but are then discarded
+  hls::Lexer silent_lexer(source);
+  hls::Parser silent_parser(silent_lexer);
+  testing::internal::CaptureStdout();
+  testing::internal::CaptureStderr();
+  while (!silent_parser.eof()) silent_parser.step();
+  ASSERT_TRUE(testing::internal::GetCapturedStdout().empty());
+  ASSERT_TRUE(testing::internal::GetCapturedStderr().empty());
+  ASSERT_EQ(silent_lexer.diagnostics()->errors(), 2);
+  ASSERT_NE(dynamic_cast<hls::NullDiagnosticSink*>(
+                silent_lexer.diagnostics()->sink().get()),
+            nullptr);
+}
+
+/**
+ * @brief Verify that codegen errors go to the sink given in the options,
+ * including when compiling through the Driver.
+ */
+TEST(DiagnosticsTests, Codegen) {
+  auto sink = std::make_shared<hls::BufferedDiagnosticSink>();
+  hls::CodegenOptions options;
+  options.diagnostics = sink;
+  hls::Driver::compile_source("def f(x) y\ng(1)\n", "codegen.k", options);
+
+  auto diagnostics = sink->diagnostics();
+  ASSERT_EQ(diagnostics.size(), 4);
+  ASSERT_EQ(diagnostics[0].source, "codegen.k");
+  ASSERT_EQ(diagnostics[0].message, "Variable y not in symbol table.");
+  ASSERT_EQ(diagnostics[2].message,
+            "Function g was not found in symbol table.");
+
+  // Located when the Driver knows the source
+  ASSERT_EQ(diagnostics[0].location.line, 1);
+  ASSERT_EQ(diagnostics[0].location.column, 10);
+  ASSERT_EQ(diagnostics[2].location.line, 2);
+  ASSERT_EQ(diagnostics[2].location.column, 1);
+
+  hls::Driver driver(2, options);
+  sink->clear();
+  driver.compile_source_functions("def f(x) x\ndef f(x) x\n", "split.k");
+  diagnostics = sink->diagnostics();
+  ASSERT_EQ(diagnostics.size(), 1);
+  ASSERT_EQ(diagnostics[0].message, "Redefinition of function f.");
+}
+
+/**
+ * @brief Verify that errors generating a function lazily, which surface
+ * within the JIT, go to the sink rather than being printed.
+ */
+TEST(DiagnosticsTests, LazyJIT) {
+  auto sink = std::make_shared<hls::BufferedDiagnosticSink>();
+  hls::CodegenOptions options;
+  options.diagnostics = sink;
+  hls::JIT jit(options, true);
+
+  testing::internal::CaptureStderr();
+  ASSERT_THROW(jit.run("def f(x) y\nf(1)\n"), std::runtime_error);
+  ASSERT_TRUE(testing::internal::GetCapturedStderr().empty());
+  auto diagnostics = sink->diagnostics();
+  // Codegen's own errors, then the JIT's as it gives up on the function
+  ASSERT_EQ(diagnostics.size(), 4);
+  ASSERT_EQ(diagnostics[0].message, "Variable y not in symbol table.");
+  ASSERT_EQ(diagnostics[2].source, "jit");
+  ASSERT_EQ(diagnostics[2].message, "Couldn't generate IR for function f");
+  ASSERT_NE(diagnostics[3].message.find("Failed to materialize"),
+            std::string::npos);
+}
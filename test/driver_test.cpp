@@ -0,0 +1,235 @@
+/**
+ * @file driver_test.cpp
+ * @author Salvatore Cardamone
+ * @brief Unit tests for the ThreadPool and parallel compilation Driver.
+ */
+// clang-format off
+#include <gtest/gtest.h>
+#include <llvm/IR/Verifier.h>
+#include <llvm/Support/raw_ostream.h>
+
+#include <algorithm>
+#include <atomic>
+#include <cstdio>
+#include <fstream>
+#include <future>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include "hls/diagnostics.hpp"
+#include "hls/driver.hpp"
+#include "hls/thread_pool.hpp"
+// clang-format on
+
+/**
+ * @brief Verify that every task submitted to the pool runs, that results come
+ * back through the futures and that exceptions are propagated.
+ */
+TEST(ThreadPoolTests, Submit) {
+  std::atomic<int> ran{0};
+  std::vector<std::future<int>> results;
+  {
+    hls::ThreadPool pool(4);
+    ASSERT_EQ(pool.size(), 4);
+    for (int i = 0; i < 100; ++i) {
+      results.push_back(pool.submit([&ran, i] {
+        ++ran;
+        return i * i;
+      }));
+    }
+    for (int i = 0; i < 100; ++i) ASSERT_EQ(results[i].get(), i * i);
+
+    auto failure = pool.submit([]() -> int { throw std::runtime_error("x"); });
+    ASSERT_THROW(failure.get(), std::runtime_error);
+  }
+  ASSERT_EQ(ran, 100);
+}
+
+/**
+ * @brief Fixture writing some source files for the Driver to compile, and
+ * cleaning them up afterwards. Each test writes files of its own, since CTest
+ * may run them concurrently.
+ */
+class DriverTests : public ::testing::Test {
+ protected:
+  DriverTests() {
+    write("a", "def add(x y) x + y\n");
+    write("b", "extern add(x y)\ndef twice(x) add(x, x)\n");
+    write("c", "def add(a b) a * b\n");
+  }
+  ~DriverTests() {
+    for (const auto& path : paths_) std::remove(path.c_str());
+  }
+
+  std::vector<std::string> paths_;
+
+  void write(const std::string& name, const std::string& source) {
+    std::string path =
+        ::testing::TempDir() + "driver_test_" +
+        ::testing::UnitTest::GetInstance()->current_test_info()->name() + "_" +
+        name + ".k";
+    std::ofstream(path) << source;
+    paths_.push_back(path);
+  }
+};
+
+/**
+ * @brief Verify that files are compiled into separate modules, each in its own
+ * context, returned in the order they were requested.
+ */
+TEST_F(DriverTests, Compile) {
+  hls::Driver driver(2);
+  auto modules = driver.compile({paths_[0], paths_[1]});
+  ASSERT_EQ(modules.size(), 2);
+  ASSERT_NE(modules[0].context, modules[1].context);
+
+  ASSERT_EQ(modules[0].module->getModuleIdentifier(), paths_[0]);
+  ASSERT_FALSE(modules[0].module->getFunction("add")->isDeclaration());
+
+  ASSERT_EQ(modules[1].module->getModuleIdentifier(), paths_[1]);
+  ASSERT_TRUE(modules[1].module->getFunction("add")->isDeclaration());
+  ASSERT_FALSE(modules[1].module->getFunction("twice")->isDeclaration());
+
+  ASSERT_THROW(driver.compile({paths_[0], "driver_test_missing.k"}),
+               std::runtime_error);
+}
+
+/**
+ * @brief Verify that linking resolves declarations in one module against
+ * definitions in another, and that conflicting definitions are rejected.
+ */
+TEST_F(DriverTests, Link) {
+  hls::Driver driver(2);
+  auto linked = hls::Driver::link(driver.compile({paths_[0], paths_[1]}), "ab");
+  ASSERT_EQ(linked.module->getModuleIdentifier(), "ab");
+  ASSERT_FALSE(linked.module->getFunction("add")->isDeclaration());
+  ASSERT_FALSE(linked.module->getFunction("twice")->isDeclaration());
+
+  ASSERT_THROW(
+      hls::Driver::link(driver.compile({paths_[0], paths_[2]}), "ac"),
+      std::runtime_error);
+}
+
+/**
+ * @brief Verify that compiling the functions of a translation unit in parallel
+ * produces the same functions as compiling it serially, with calls resolved
+ * across shards and redefinitions dropped.
+ */
+TEST(DriverFunctionTests, CompileFunctions) {
+  std::string source =
+      "extern sin(x)\n"
+      "def f0(x) x + 1\n"
+      "def f1(x) f0(x) * 2\n"
+      "def f2(x) f1(x) - sin(x)\n"
+      "def f3(x y) f2(x) < f0(y)\n"
+      "def f4(x) for i = 0, i < x in f3(i, x)\n"
+      "def f5(x) f4(f4(x))\n"
+      "def f1(x) x\n"
+      "f5(3)\n";
+  auto serial = hls::Driver::compile_source(source, "serial");
+
+  hls::Driver driver(3);
+  auto parallel = driver.compile_source_functions(source, "parallel");
+  ASSERT_FALSE(llvm::verifyModule(*parallel.module, &llvm::errs()));
+  // The linker drops unused declarations, so just compare the definitions
+  auto definitions = [](const llvm::Module& module) {
+    std::vector<std::string> names;
+    for (const auto& function : module) {
+      if (!function.isDeclaration()) names.push_back(function.getName().str());
+    }
+    std::sort(names.begin(), names.end());
+    return names;
+  };
+  ASSERT_EQ(definitions(*parallel.module), definitions(*serial.module));
+
+  // Functions are declared with the argument names of their definition, which
+  // are the ones the body refers to, rather than those of an extern
+  auto declared = driver.compile_source_functions(
+      "extern g(a)\ndef h(x) g(x)\ndef g(x) x * 2\n", "declared");
+  ASSERT_FALSE(llvm::verifyModule(*declared.module, &llvm::errs()));
+  ASSERT_EQ(declared.module->getFunction("g")->getArg(0)->getName(), "x");
+  ASSERT_FALSE(declared.module->getFunction("g")->isDeclaration());
+}
+
+/**
+ * @brief Verify that functions compiled in parallel only see the declarations
+ * that come before them, and are checked against them, as when compiled
+ * serially.
+ */
+TEST(DriverFunctionTests, SourceOrder) {
+  // h calls g before it's declared, and g is defined unlike its extern
+  const std::string source =
+      "def h(x) g(x)\n"
+      "extern g(a)\n"
+      "def k(x) g(x)\n"
+      "def g(x y) x\n";
+  auto sink = std::make_shared<hls::BufferedDiagnosticSink>();
+  hls::CodegenOptions options;
+  options.diagnostics = sink;
+  auto messages = [&sink] {
+    std::vector<std::string> messages;
+    for (const auto& diagnostic : sink->diagnostics())
+      messages.push_back(diagnostic.message);
+    std::sort(messages.begin(), messages.end());
+    sink->clear();
+    return messages;
+  };
+  auto serial = hls::Driver::compile_source(source, "serial", options);
+  auto expected = messages();
+  ASSERT_NE(std::find(expected.begin(), expected.end(),
+                      "Function g was not found in symbol table."),
+            expected.end());
+  ASSERT_NE(std::find(expected.begin(), expected.end(),
+                      "Definition doesn't match declaration."),
+            expected.end());
+
+  hls::Driver driver(3, options);
+  auto parallel = driver.compile_source_functions(source, "parallel");
+  ASSERT_FALSE(llvm::verifyModule(*parallel.module, &llvm::errs()));
+  ASSERT_EQ(messages(), expected);
+  ASSERT_FALSE(parallel.module->getFunction("k")->isDeclaration());
+  ASSERT_EQ(parallel.module->getFunction("h"), nullptr);
+}
+
+/**
+ * @brief Verify that compiling a translation unit while it's being parsed
+ * produces the same functions as compiling it serially, with calls resolved
+ * between workers and redefinitions reported and dropped.
+ */
+TEST(DriverFunctionTests, CompileStreaming) {
+  // Far more functions than fit in the queue, each calling the one before
+  std::string source = "extern sin(x)\ndef f0(x) sin(x)\n";
+  for (int i = 1; i < 1000; ++i) {
+    source += "def f" + std::to_string(i) + "(x) f" + std::to_string(i - 1) +
+              "(x) * " + std::to_string(i) + "\n";
+  }
+  source += "def f1(x) x\nf999(2)\n";
+  auto sink = std::make_shared<hls::BufferedDiagnosticSink>();
+  hls::CodegenOptions options;
+  options.opt_level = hls::OptLevel::O0;
+  options.diagnostics = sink;
+  auto serial = hls::Driver::compile_source(source, "serial", options);
+  ASSERT_EQ(sink->diagnostics().size(), 1);
+  sink->clear();
+
+  hls::Driver driver(3, options);
+  auto streamed = driver.compile_source_streaming(source, "streamed");
+  ASSERT_FALSE(llvm::verifyModule(*streamed.module, &llvm::errs()));
+  auto diagnostics = sink->diagnostics();
+  ASSERT_EQ(diagnostics.size(), 1);
+  ASSERT_EQ(diagnostics[0].message, "Redefinition of function f1.");
+
+  auto definitions = [](const llvm::Module& module) {
+    std::vector<std::string> names;
+    for (const auto& function : module) {
+      if (!function.isDeclaration()) names.push_back(function.getName().str());
+    }
+    std::sort(names.begin(), names.end());
+    return names;
+  };
+  ASSERT_EQ(definitions(*streamed.module), definitions(*serial.module));
+  // The first definition of f1 is the one that's kept
+  ASSERT_EQ(streamed.module->getFunction("f1")->getInstructionCount(), 3);
+}
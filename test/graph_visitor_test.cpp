@@ -6,8 +6,19 @@
 // clang-format off
 #include <gtest/gtest.h>
 
+#include <algorithm>
+#include <limits>
+#include <memory>
+#include <random>
+#include <set>
+#include <stdexcept>
+#include <utility>
+#include <vector>
+
+#include "hls/csr_graph.hpp"
 #include "hls/graph.hpp"
 #include "hls/graph_visitor.hpp"
+#include "hls/thread_pool.hpp"
 // clang-format on
 
 TEST(GraphVisitorTests, Basic) {
@@ -29,5 +40,235 @@ TEST(GraphVisitorTests, Basic) {
 
   graph.accept(path);
   ASSERT_EQ(path.path_length(), 3);
-  
+  ASSERT_EQ(path.route(),
+            std::vector<hls::GraphShortestPath::vptr>(
+                {vertex_a, vertex_b, vertex_c}));
+}
+
+/**
+ * @brief Verify that the shortest route is found when it isn't the one with
+ * fewest edges, and that a compressed Graph can be searched directly.
+ */
+TEST(GraphVisitorTests, Route) {
+  hls::Graph graph;
+  std::vector<std::shared_ptr<hls::Vertex>> v;
+  for (int i = 0; i < 6; ++i) v.push_back(std::make_shared<hls::Vertex>());
+
+  // Direct but heavy 0 -> 5, against 0 -> 1 -> 2 -> 3 -> 5 and a detour
+  // through 4 that looks promising at first
+  graph.add_edge(v[0], v[5], 10);
+  graph.add_edge(v[0], v[4], 1);
+  graph.add_edge(v[4], v[5], 9);
+  graph.add_edge(v[0], v[1], 2);
+  graph.add_edge(v[1], v[2], 2);
+  graph.add_edge(v[2], v[3], 2);
+  graph.add_edge(v[3], v[5], 2);
+
+  hls::CSRGraph csr(graph);
+  hls::GraphShortestPath path(v[0], v[5]);
+  csr.accept(path);
+  ASSERT_EQ(path.path_length(), 8);
+  ASSERT_EQ(path.route(), std::vector<std::shared_ptr<hls::Vertex>>(
+                              {v[0], v[1], v[2], v[3], v[5]}));
+
+  hls::GraphShortestPath itself(v[2], v[2]);
+  csr.accept(itself);
+  ASSERT_EQ(itself.path_length(), 0);
+  ASSERT_EQ(itself.route(), std::vector<std::shared_ptr<hls::Vertex>>({v[2]}));
+}
+
+/**
+ * @brief Verify that an unreachable Vertex, an unknown Vertex and a negative
+ * weight are all handled.
+ */
+TEST(GraphVisitorTests, Unreachable) {
+  hls::Graph graph;
+  auto vertex_a = std::make_shared<hls::Vertex>();
+  auto vertex_b = std::make_shared<hls::Vertex>();
+  auto vertex_c = std::make_shared<hls::Vertex>();
+  graph.add_edge(vertex_a, vertex_b, 1);
+  graph.add_vertex(vertex_c);
+
+  hls::GraphShortestPath nowhere(vertex_b, vertex_a);
+  graph.accept(nowhere);
+  ASSERT_EQ(nowhere.path_length(), std::numeric_limits<int>::max());
+  ASSERT_TRUE(nowhere.route().empty());
+
+  hls::GraphShortestPath unknown(vertex_a, std::make_shared<hls::Vertex>());
+  ASSERT_THROW(graph.accept(unknown), std::runtime_error);
+
+  graph.add_edge(vertex_b, vertex_c, -1);
+  hls::GraphShortestPath negative(vertex_a, vertex_c);
+  ASSERT_THROW(graph.accept(negative), std::runtime_error);
+}
+
+/**
+ * @brief Verify both all-pairs algorithms against single-source searches, on
+ * random graphs with negative weights but no negative cycles.
+ */
+TEST(GraphVisitorTests, AllPairs) {
+  std::mt19937 random(3);
+  // One visitor is reused with its own threads; the others share a pool
+  hls::GraphAllPairs floyd(hls::GraphAllPairs::Method::floyd_warshall, 3);
+  hls::ThreadPool pool(3);
+  for (int trial = 0; trial < 10; ++trial) {
+    // Weights are made from a hidden potential plus a non-negative slack, so
+    // that every cycle has a non-negative weight
+    const int vertices = 10 + 20 * trial;
+    std::vector<std::shared_ptr<hls::Vertex>> v;
+    std::vector<int> potential;
+    std::uniform_int_distribution<int> offset(-20, 20), slack(0, 10);
+    for (int i = 0; i < vertices; ++i) {
+      v.push_back(std::make_shared<hls::Vertex>());
+      potential.push_back(offset(random));
+    }
+    hls::Graph graph;
+    for (const auto& vertex : v) graph.add_vertex(vertex);
+    std::set<std::pair<int, int>> connected;
+    std::uniform_int_distribution<int> any(0, vertices - 1);
+    const int edges = trial % 2 ? vertices * 2 : vertices * vertices / 4;
+    for (int i = 0; i < edges; ++i) {
+      int a = any(random), b = any(random);
+      if (a == b || !connected.insert(std::minmax(a, b)).second) continue;
+      graph.add_edge(v[a], v[b], potential[b] - potential[a] + slack(random));
+    }
+
+    hls::CSRGraph csr(graph);
+    hls::GraphAllPairs johnson(pool, hls::GraphAllPairs::Method::johnson);
+    csr.accept(floyd);
+    csr.accept(johnson);
+    ASSERT_EQ(floyd.size(), vertices);
+    ASSERT_EQ(floyd.matrix(), johnson.matrix());
+    for (int source = 0; source < vertices; source += 7) {
+      hls::GraphBellmanFord single(v[source]);
+      csr.accept(single);
+      for (int destination = 0; destination < vertices; ++destination) {
+        ASSERT_EQ(floyd.distance(v[source], v[destination]),
+                  single.distance(v[destination]));
+      }
+    }
+  }
+}
+
+/**
+ * @brief Verify the choice of algorithm, and that a negative cycle is
+ * reported by both.
+ */
+TEST(GraphVisitorTests, AllPairsMethods) {
+  hls::Graph graph;
+  std::vector<std::shared_ptr<hls::Vertex>> v;
+  for (int i = 0; i < 64; ++i) v.push_back(std::make_shared<hls::Vertex>());
+  for (int i = 0; i + 1 < 64; ++i) graph.add_edge(v[i], v[i + 1], 1);
+
+  hls::GraphAllPairs sparse;
+  graph.accept(sparse);
+  ASSERT_EQ(sparse.method(), hls::GraphAllPairs::Method::johnson);
+  ASSERT_EQ(sparse.distance(v[3], v[60]), 57);
+  ASSERT_EQ(sparse.distance(v[60], v[3]), std::numeric_limits<int>::max());
+  ASSERT_THROW(sparse.distance(v[0], std::make_shared<hls::Vertex>()),
+               std::runtime_error);
+
+  for (int i = 0; i < 64; ++i) {
+    for (int j = i + 2; j < 64; ++j) graph.add_edge(v[i], v[j], j - i + 1);
+  }
+  hls::GraphAllPairs dense;
+  graph.accept(dense);
+  ASSERT_EQ(dense.method(), hls::GraphAllPairs::Method::floyd_warshall);
+  ASSERT_EQ(dense.distance(v[3], v[60]), 57);
+  // A visitor left to choose chooses afresh for each graph
+  graph.accept(sparse);
+  ASSERT_EQ(sparse.method(), hls::GraphAllPairs::Method::floyd_warshall);
+
+  // Back round from the end to the start, for less than it cost to get there
+  auto back = std::make_shared<hls::Vertex>();
+  graph.add_edge(v[63], back, -100);
+  graph.add_edge(back, v[0], 0);
+  for (auto method : {hls::GraphAllPairs::Method::floyd_warshall,
+                      hls::GraphAllPairs::Method::johnson}) {
+    hls::GraphAllPairs negative(method);
+    ASSERT_THROW(graph.accept(negative), std::runtime_error);
+  }
+}
+
+/**
+ * @brief Verify delta-stepping against Bellman-Ford on random graphs, over a
+ * range of bucket widths and numbers of threads.
+ */
+TEST(GraphVisitorTests, DeltaStepping) {
+  std::mt19937 random(5);
+  hls::ThreadPool pool(3);
+  for (int trial = 0; trial < 12; ++trial) {
+    const int vertices = 50 + 400 * (trial % 4);
+    std::vector<std::shared_ptr<hls::Vertex>> v;
+    hls::Graph graph;
+    for (int i = 0; i < vertices; ++i) {
+      v.push_back(std::make_shared<hls::Vertex>());
+      graph.add_vertex(v.back());
+    }
+    std::set<std::pair<int, int>> connected;
+    std::uniform_int_distribution<int> any(0, vertices - 1), weight(0, 50);
+    for (int i = 0; i < vertices * 3; ++i) {
+      int a = any(random), b = any(random);
+      if (a == b || !connected.insert(std::minmax(a, b)).second) continue;
+      graph.add_edge(v[a], v[b], weight(random));
+    }
+
+    hls::CSRGraph csr(graph);
+    hls::GraphBellmanFord reference(v[0]);
+    csr.accept(reference);
+    for (int delta : {0, 1, 7, 1000}) {
+      hls::GraphDeltaStepping paths(v[0], delta, 1 + trial % 3);
+      hls::GraphDeltaStepping shared(pool, v[0], delta);
+      csr.accept(paths);
+      csr.accept(shared);
+      ASSERT_GT(paths.delta(), 0);
+      for (int i = 0; i < vertices; ++i) {
+        ASSERT_EQ(paths.distance(i), reference.distance(v[i]));
+      }
+      ASSERT_EQ(shared.distances(), paths.distances());
+    }
+  }
+
+  // A long path of heavy edges, spanning far more buckets than are kept
+  std::vector<std::shared_ptr<hls::Vertex>> path;
+  hls::Graph long_path;
+  for (int i = 0; i < 1000; ++i) {
+    path.push_back(std::make_shared<hls::Vertex>());
+    long_path.add_vertex(path.back());
+    if (i > 0) long_path.add_edge(path[i - 1], path[i], 100000 + i % 2);
+  }
+  hls::GraphDeltaStepping stepped(path[0], 1);
+  long_path.accept(stepped);
+  for (int i = 0; i < 1000; ++i) {
+    ASSERT_EQ(stepped.distance(i), 100000 * i + (i + 1) / 2);
+  }
+
+  // A visitor left to choose the width chooses afresh for each graph
+  auto vertex_a = std::make_shared<hls::Vertex>();
+  auto vertex_b = std::make_shared<hls::Vertex>();
+  hls::Graph light, heavy;
+  light.add_edge(vertex_a, vertex_b, 2);
+  heavy.add_edge(vertex_a, vertex_b, 2000);
+  hls::GraphDeltaStepping derived(vertex_a);
+  light.accept(derived);
+  ASSERT_EQ(derived.delta(), 2);
+  heavy.accept(derived);
+  ASSERT_EQ(derived.delta(), 2000);
+  ASSERT_EQ(derived.distance(1), 2000);
+}
+
+/**
+ * @brief Verify that delta-stepping rejects negative weights and an unknown
+ * source.
+ */
+TEST(GraphVisitorTests, DeltaSteppingErrors) {
+  hls::Graph graph;
+  auto vertex_a = std::make_shared<hls::Vertex>();
+  auto vertex_b = std::make_shared<hls::Vertex>();
+  graph.add_edge(vertex_a, vertex_b, -1);
+
+  hls::GraphDeltaStepping negative(vertex_a);
+  ASSERT_THROW(graph.accept(negative), std::runtime_error);
+  hls::GraphDeltaStepping unknown(std::make_shared<hls::Vertex>());
+  ASSERT_THROW(graph.accept(unknown), std::runtime_error);
 }
@@ -0,0 +1,176 @@
+/**
+ * @file incremental_parser_test.cpp
+ * @author Salvatore Cardamone
+ * @brief Unit tests for incremental reparsing of an edited source buffer.
+ */
+// clang-format off
+#include <gtest/gtest.h>
+
+#include <memory>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "hls/ast.hpp"
+#include "hls/incremental_parser.hpp"
+#include "hls/lexer.hpp"
+#include "hls/parser.hpp"
+// clang-format on
+
+namespace {
+
+/**
+ * @brief Parse a whole buffer from scratch.
+ * @param source The buffer.
+ * @return The ASTs of the buffer, omitting anything that couldn't be parsed.
+ */
+std::vector<std::shared_ptr<hls::AST>> parse(const std::string& source) {
+  hls::Lexer lexer(source);
+  hls::Parser parser(lexer);
+  std::vector<std::shared_ptr<hls::AST>> asts;
+  while (!parser.eof()) {
+    if (auto ast = parser.step()) asts.push_back(std::move(ast));
+  }
+  return asts;
+}
+
+/**
+ * @brief Check that an incrementally maintained buffer has the same ASTs as
+ * parsing it from scratch.
+ * @param parser The incremental parser.
+ */
+void expect_consistent(const hls::IncrementalParser& parser) {
+  auto expected = parse(parser.source());
+  auto actual = parser.asts();
+  ASSERT_EQ(actual.size(), expected.size()) << parser.source();
+  for (std::size_t idx = 0; idx < actual.size(); ++idx)
+    ASSERT_EQ(*actual[idx], *expected[idx]) << parser.source();
+}
+
+}  // namespace
+
+/**
+ * @brief Verify that an edit inside one definition only reparses that
+ * definition, and that every other AST is reused.
+ */
+TEST(IncrementalParserTests, Reuse) {
+  std::string source;
+  for (int i = 0; i < 100; ++i) {
+    source += "def f" + std::to_string(i) + "(x) x + " + std::to_string(i) +
+              "\n";
+  }
+  hls::IncrementalParser parser(source);
+  auto before = parser.asts();
+  ASSERT_EQ(before.size(), 100);
+
+  // Change the body of f50 from x + 50 to x * 50
+  std::size_t offset = parser.source().find("def f50(x) x +") + 13;
+  ASSERT_EQ(parser.edit(offset, 1, "*"), 1);
+  auto after = parser.asts();
+  ASSERT_EQ(after.size(), 100);
+  for (std::size_t idx = 0; idx < after.size(); ++idx) {
+    if (idx == 50) {
+      ASSERT_NE(after[idx], before[idx]);
+    } else {
+      ASSERT_EQ(after[idx], before[idx]);
+    }
+  }
+  expect_consistent(parser);
+
+  // Inserting a definition shifts, but doesn't reparse, everything after it.
+  // The one before is reparsed too, since it was left looking at the token
+  // that the insertion now precedes
+  offset = parser.source().find("def f10(x)");
+  ASSERT_EQ(parser.edit(offset, 0, "def g(y) y\n"), 2);
+  ASSERT_EQ(parser.asts().size(), 101);
+  ASSERT_EQ(parser.asts()[11], before[10]);
+  // Likewise appending an expression reparses the last definition with it
+  ASSERT_EQ(parser.edit(parser.source().size(), 0, "f0(1)\n"), 2);
+  ASSERT_EQ(parser.asts().size(), 102);
+  expect_consistent(parser);
+}
+
+/**
+ * @brief Verify that edits which change how neighbouring text is lexed or
+ * parsed give the same ASTs as parsing the edited buffer from scratch.
+ */
+TEST(IncrementalParserTests, Edits) {
+  hls::IncrementalParser parser(
+      "extern sin(x)\n"
+      "def f(x) x + 1\n"
+      "def g(x) f(x) * 2; g(3)\n"
+      "def h(a b) a < b\n");
+  expect_consistent(parser);
+
+  // Comment out a line, then uncomment it
+  std::size_t offset = parser.source().find("def g");
+  parser.edit(offset, 0, "#");
+  expect_consistent(parser);
+  ASSERT_EQ(parser.asts().size(), 3);
+  parser.edit(offset, 1, "");
+  expect_consistent(parser);
+  ASSERT_EQ(parser.asts().size(), 5);
+
+  // Continue an expression onto the next line, so f absorbs a definition
+  offset = parser.source().find("\ndef g");
+  parser.edit(offset + 1, 3, "+");
+  expect_consistent(parser);
+  parser.edit(offset + 1, 1, "def");
+  expect_consistent(parser);
+
+  // Join two identifiers, then split them again
+  offset = parser.source().find("f(x) *");
+  parser.edit(offset + 1, 0, "f");
+  expect_consistent(parser);
+  parser.edit(offset + 1, 1, "");
+  expect_consistent(parser);
+
+  // Delete across several definitions, break the syntax and restore it
+  std::string original = parser.source();
+  offset = parser.source().find("x + 1");
+  parser.edit(offset, parser.source().find("a <") - offset, "(");
+  expect_consistent(parser);
+  parser.edit(0, 0, "   ");
+  expect_consistent(parser);
+  parser.edit(0, parser.source().size(), original);
+  expect_consistent(parser);
+  ASSERT_EQ(parser.source(), original);
+
+  // Changing an operator's precedence reparses the code that uses it
+  parser.edit(parser.source().size(), 0,
+              "def binary| 5 (a b) a\n"
+              "def k(x) x | x + 1\n"
+              "def l(x) x\n");
+  expect_consistent(parser);
+  offset = parser.source().find("| 5");
+  ASSERT_EQ(parser.edit(offset + 2, 1, "50"), 3);
+  expect_consistent(parser);
+
+  ASSERT_THROW(parser.edit(parser.source().size(), 1, ""), std::out_of_range);
+}
+
+/**
+ * @brief Verify that a long run of random edits never leaves the ASTs out of
+ * step with the buffer.
+ */
+TEST(IncrementalParserTests, RandomEdits) {
+  const std::vector<std::string> snippets{
+      "def ", "extern ", "f", "g(x)", "(", ")", "x", " + ", "*", "1", "2.5",
+      ";",    "\n",     "#", " ",    "if x < 1 then 1 else 2",
+      "for i = 0, i < 3 in i", "def binary| 5 (a b) a\n", " | ",
+      "binary"};
+  hls::IncrementalParser parser("def f(x) x + 1\nextern g(x)\ng(2)\n");
+  std::mt19937 generator(42);
+  for (int i = 0; i < 500; ++i) {
+    const std::string& source = parser.source();
+    std::size_t offset =
+        std::uniform_int_distribution<std::size_t>(0, source.size())(generator);
+    std::size_t length = std::uniform_int_distribution<std::size_t>(
+        0, std::min<std::size_t>(3, source.size() - offset))(generator);
+    const std::string& text =
+        snippets[std::uniform_int_distribution<std::size_t>(
+            0, snippets.size() - 1)(generator)];
+    parser.edit(offset, length, text);
+    expect_consistent(parser);
+  }
+}
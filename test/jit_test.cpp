@@ -0,0 +1,105 @@
+/**
+ * @file jit_test.cpp
+ * @author Salvatore Cardamone
+ * @brief Unit tests for the JIT execution engine.
+ */
+// clang-format off
+#include <gtest/gtest.h>
+
+#include <cmath>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include "hls/jit.hpp"
+// clang-format on
+
+/**
+ * @brief Verify that top-level expressions are evaluated, including control
+ * flow and loops.
+ */
+TEST(JITTests, Evaluate) {
+  hls::JIT jit;
+  ASSERT_EQ(jit.run("4 + 5\n(1 + 2) * 3 - 1\n"),
+            (std::vector<double>{9.0, 8.0}));
+  ASSERT_EQ(jit.run("if 1 < 2 then 10 else 20\n"), std::vector<double>{10.0});
+  // Loops evaluate to zero
+  ASSERT_EQ(jit.run("for i = 0, i < 10 in i\n"), std::vector<double>{0.0});
+}
+
+/**
+ * @brief Verify that functions stay resident between evaluations, and that
+ * externs resolve against the host process.
+ */
+TEST(JITTests, Functions) {
+  hls::JIT jit;
+  ASSERT_TRUE(jit.run("def square(x) x * x\n").empty());
+  ASSERT_EQ(jit.run("square(3)\n"), std::vector<double>{9.0});
+  ASSERT_TRUE(
+      jit.run("def fib(n) if n < 2 then n else fib(n - 1) + fib(n - 2)\n")
+          .empty());
+  ASSERT_EQ(jit.run("fib(10) + square(2)\n"), std::vector<double>{59.0});
+
+  auto sin = jit.run("extern sin(x)\nsin(1)\n");
+  ASSERT_EQ(sin.size(), 1);
+  ASSERT_DOUBLE_EQ(sin[0], std::sin(1.0));
+}
+
+/**
+ * @brief Verify that errors are reported as exceptions and that the JIT is
+ * still usable afterwards.
+ */
+TEST(JITTests, Errors) {
+  hls::JIT jit;
+  ASSERT_THROW(jit.run("undefined(1)\n"), std::runtime_error);
+  ASSERT_THROW(jit.run("def f(x) y\n"), std::runtime_error);
+  jit.run("def g(x) x + 1\n");
+  ASSERT_THROW(jit.run("def g(x) x + 2\n"), std::runtime_error);
+  ASSERT_EQ(jit.run("g(1)\n"), std::vector<double>{2.0});
+}
+
+/**
+ * @brief Verify that in lazy mode functions are only generated once something
+ * that calls them is evaluated, and are generated at most once.
+ */
+TEST(JITTests, Lazy) {
+  hls::JIT jit(hls::CodegenOptions(), true);
+  std::string source;
+  for (int i = 0; i < 100; ++i) {
+    source += "def f" + std::to_string(i) + "(x) x + " + std::to_string(i) +
+              "\n";
+  }
+  source += "def g(x) f1(x) * f2(x)\n";
+  ASSERT_TRUE(jit.run(source).empty());
+  ASSERT_EQ(jit.functions_generated(), 0);
+
+  // g pulls in f1 and f2 when it's compiled
+  ASSERT_EQ(jit.run("g(1)\n"), std::vector<double>{6.0});
+  ASSERT_EQ(jit.functions_generated(), 3);
+  ASSERT_EQ(jit.run("g(2) + f1(0)\n"), std::vector<double>{13.0});
+  ASSERT_EQ(jit.functions_generated(), 3);
+
+  // Errors in a function body only surface once it's needed, and don't stop
+  // later expressions from being evaluated
+  ASSERT_TRUE(jit.run("def h(x) y\n").empty());
+  ASSERT_THROW(jit.run("h(1)\n"), std::runtime_error);
+  ASSERT_EQ(jit.run("f99(1)\n"), std::vector<double>{100.0});
+  ASSERT_THROW(jit.run("def f0(x) x\n"), std::runtime_error);
+}
+
+/**
+ * @brief Verify that user-defined binary operators are evaluated with their
+ * precedence, including in code run after they were defined.
+ */
+TEST(JITTests, Operators) {
+  hls::JIT jit;
+  ASSERT_TRUE(
+      jit.run("def binary| 5 (a b) if a then 1 else if b then 1 else 0\n"
+              "def binary> 10 (a b) b < a\n")
+          .empty());
+  ASSERT_EQ(jit.run("0 | 1\n0 | 0\n"), (std::vector<double>{1.0, 0.0}));
+  // Binds more loosely than <, so this is (1 < 0) | (3 > 2)
+  ASSERT_EQ(jit.run("1 < 0 | 3 > 2\n"), std::vector<double>{1.0});
+  ASSERT_EQ(jit.run("def binary^ (a b) a * b * 2\n2 + 3 ^ 4\n"),
+            std::vector<double>{26.0});
+}
@@ -7,6 +7,11 @@
 
 #include <gtest/gtest.h>
 
+#include <cstdio>
+#include <fstream>
+
+#include "hls/mapped_file.hpp"
+
 // Lexer works on istream, so we can create stringstream inputs to
 // feed into the lexer for unit testing
 std::stringstream prototype_input("def my_func()");
@@ -47,3 +52,106 @@ TEST(LexerTest, TestFunctionLexing) {
   ASSERT_EQ(lexer.get_token(), hls::Token(hls::TokenType::tok_identifier, "b"));
   ASSERT_EQ(lexer.get_token(), hls::Token(hls::TokenType::tok_eof));
 };
+
+/**
+ * @brief Lexing of the function input from a contiguous buffer. Should result
+ * in the same tokens as the stream lexer, but referencing the buffer.
+ */
+TEST(LexerTest, TestBufferLexing) {
+  std::string_view source("def my_func(a, b)\n\r\ta + b # comment\n1.5");
+  hls::Lexer lexer(source);
+
+  ASSERT_EQ(lexer.get_token(), hls::Token(hls::TokenType::tok_def));
+  auto identifier = lexer.get_token();
+  ASSERT_EQ(identifier, hls::Token(hls::TokenType::tok_identifier, "my_func"));
+  // Token value should point straight into the source buffer
+  ASSERT_EQ(identifier.view().data(), source.data() + 4);
+  ASSERT_EQ(lexer.get_token(), hls::Token(hls::TokenType::tok_operator, "("));
+  ASSERT_EQ(lexer.get_token(), hls::Token(hls::TokenType::tok_identifier, "a"));
+  ASSERT_EQ(lexer.get_token(), hls::Token(hls::TokenType::tok_operator, ","));
+  ASSERT_EQ(lexer.get_token(), hls::Token(hls::TokenType::tok_identifier, "b"));
+  ASSERT_EQ(lexer.get_token(), hls::Token(hls::TokenType::tok_operator, ")"));
+  ASSERT_EQ(lexer.get_token(), hls::Token(hls::TokenType::tok_identifier, "a"));
+  ASSERT_EQ(lexer.get_token(), hls::Token(hls::TokenType::tok_operator, "+"));
+  ASSERT_EQ(lexer.get_token(), hls::Token(hls::TokenType::tok_identifier, "b"));
+  auto number = lexer.get_token();
+  ASSERT_EQ(number, hls::Token(hls::TokenType::tok_number, "1.5"));
+  // Owning copies of the value are still available
+  ASSERT_EQ(number.value(), std::string("1.5"));
+  ASSERT_EQ(lexer.get_token(), hls::Token(hls::TokenType::tok_eof));
+};
+
+/**
+ * @brief Lexing of a memory-mapped file.
+ */
+TEST(LexerTest, TestMappedFileLexing) {
+  std::string path = ::testing::TempDir() + "hls_lexer_test.ks";
+  std::ofstream(path) << "extern sin(x)";
+
+  hls::MappedFile file(path);
+  hls::Lexer lexer(file.contents());
+
+  ASSERT_EQ(lexer.get_token(), hls::Token(hls::TokenType::tok_extern));
+  ASSERT_EQ(lexer.get_token(),
+            hls::Token(hls::TokenType::tok_identifier, "sin"));
+  ASSERT_EQ(lexer.get_token(), hls::Token(hls::TokenType::tok_operator, "("));
+  ASSERT_EQ(lexer.get_token(), hls::Token(hls::TokenType::tok_identifier, "x"));
+  ASSERT_EQ(lexer.get_token(), hls::Token(hls::TokenType::tok_operator, ")"));
+  ASSERT_EQ(lexer.get_token(), hls::Token(hls::TokenType::tok_eof));
+
+  ASSERT_THROW(hls::MappedFile(path + ".missing"), std::runtime_error);
+  std::remove(path.c_str());
+};
+
+/**
+ * @brief Verify that every keyword is recognised in both lexing modes, and that
+ * near-misses are lexed as identifiers.
+ */
+TEST(LexerTest, TestKeywordLexing) {
+  std::string source("def extern if then else for in define iff fi d e");
+  std::stringstream input(source);
+  hls::Lexer stream_lexer(input);
+  hls::Lexer buffer_lexer(std::string_view{source});
+
+  for (auto* lexer : {&stream_lexer, &buffer_lexer}) {
+    for (const auto& keyword : hls::keywords) {
+      ASSERT_EQ(lexer->get_token().type(), keyword.type);
+    }
+    for (auto identifier : {"define", "iff", "fi", "d", "e"}) {
+      ASSERT_EQ(lexer->get_token(),
+                hls::Token(hls::TokenType::tok_identifier, identifier));
+    }
+  }
+}
+
+/**
+ * @brief Verify that identifiers are interned when asked, so that repeated
+ * identifiers share a Symbol, including across Lexers sharing a SymbolTable,
+ * and aren't interned otherwise.
+ */
+TEST(LexerTest, TestIdentifierInterning) {
+  std::string_view source("a + b * a");
+  hls::Lexer lexer(source, std::make_shared<hls::SymbolTable>());
+
+  auto a = lexer.get_token();
+  lexer.get_token();
+  auto b = lexer.get_token();
+  lexer.get_token();
+  auto a_again = lexer.get_token();
+
+  ASSERT_EQ(a.symbol(), a_again.symbol());
+  ASSERT_NE(a.symbol(), b.symbol());
+  ASSERT_EQ(lexer.symbols()->size(), 2);
+  ASSERT_EQ(lexer.symbols()->name(b.symbol()), "b");
+
+  std::stringstream other_input("b c");
+  hls::Lexer other_lexer(other_input, lexer.symbols());
+  ASSERT_EQ(other_lexer.get_token().symbol(), b.symbol());
+  ASSERT_EQ(other_lexer.get_token().symbol(), 2);
+  // Non-identifiers don't carry a Symbol
+  ASSERT_EQ(other_lexer.get_token().symbol(), hls::no_symbol);
+
+  hls::Lexer uninterned(source);
+  ASSERT_EQ(uninterned.symbols(), nullptr);
+  ASSERT_EQ(uninterned.get_token().symbol(), hls::no_symbol);
+}
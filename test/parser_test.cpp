@@ -13,6 +13,7 @@
 #include "hls/lexer.hpp"
 #include "hls/ast.hpp"
 #include "hls/parser.hpp"
+#include "hls/source_manager.hpp"
 // clang-format on
 
 /**
@@ -118,3 +119,276 @@ TEST(ParserTests, TestIfExpressionParsing) {
 
   ASSERT_EQ(*result, FunctionAST(std::move(proto), std::move(body)));
 };
+
+/**
+ * @brief Verify that parsing into an Arena produces the same AST as parsing
+ * onto the heap, and that the root, or a child held through it, keeps the
+ * Arena alive after the Parser has gone.
+ */
+TEST(ParserTests, TestArenaParsing) {
+  using namespace hls;
+
+  std::string_view source("def my_func(a b c) a + b * c");
+  Lexer heap_lexer(source);
+  Parser heap_parser(heap_lexer);
+  auto heap_result = heap_parser.step();
+
+  auto arena = std::make_shared<Arena>();
+  Lexer arena_lexer(source);
+  Parser arena_parser(arena_lexer, ASTFactory(arena));
+  auto arena_result = arena_parser.step();
+
+  ASSERT_EQ(*arena_result, *heap_result);
+  ASSERT_GT(arena->bytes_allocated(), 0);
+
+  std::weak_ptr<Arena> owner;
+  {
+    auto temporary = std::make_shared<Arena>();
+    owner = temporary;
+    Lexer lexer(source);
+    arena_result = Parser(lexer, ASTFactory(std::move(temporary))).step();
+  }
+  ASSERT_FALSE(owner.expired());
+  ASSERT_EQ(*arena_result, *heap_result);
+
+  // The body outlives its function, provided it's held through the function
+  auto function = std::static_pointer_cast<FunctionAST>(arena_result);
+  std::shared_ptr<ExprAST> body(function, function->body());
+  function.reset();
+  arena_result.reset();
+  ASSERT_FALSE(owner.expired());
+  ASSERT_EQ(*body, *std::static_pointer_cast<FunctionAST>(heap_result)->body());
+  body.reset();
+  ASSERT_TRUE(owner.expired());
+}
+
+/**
+ * @brief Verify that a hash-consing Parser shares repeated subexpressions, but
+ * still produces an AST structurally equal to the unshared one.
+ */
+TEST(ParserTests, TestHashConsedParsing) {
+  using namespace hls;
+
+  std::string_view source("def my_func(a b) (a * b + 1) * (a * b + 1)");
+  Lexer tree_lexer(source);
+  Parser tree_parser(tree_lexer);
+  auto tree = tree_parser.step();
+
+  ASTFactory factory(nullptr, true);
+  Lexer dag_lexer(source);
+  Parser dag_parser(dag_lexer, factory);
+  auto dag = dag_parser.step();
+
+  ASSERT_EQ(*dag, *tree);
+
+  auto* body = static_cast<BinaryExprAST*>(
+      std::static_pointer_cast<FunctionAST>(dag)->body());
+  // Both operands of the outer product are the same node
+  ASSERT_EQ(body->lhs(), body->rhs());
+  // a, b, a * b, 1 and a * b + 1 were all requested a second time
+  ASSERT_EQ(factory.shared_nodes(), 5);
+}
+
+/**
+ * @brief Verify that a hash-consing Parser doesn't share nodes that have been
+ * located, so each keeps the offset it was parsed from.
+ */
+TEST(ParserTests, TestHashConsedLocations) {
+  using namespace hls;
+
+  std::string_view source("def my_func(a b) (a * b) * (a * b)");
+  SourceManager sources;
+  SourceOffset base = sources.add("located.k", source);
+  ASTFactory factory(nullptr, true);
+  Lexer lexer(source, nullptr, nullptr, base);
+  Parser parser(lexer, factory);
+  auto function = std::static_pointer_cast<FunctionAST>(parser.step());
+  ASSERT_EQ(factory.shared_nodes(), 0);
+
+  auto* body = static_cast<BinaryExprAST*>(function->body());
+  auto* lhs = static_cast<BinaryExprAST*>(body->lhs());
+  auto* rhs = static_cast<BinaryExprAST*>(body->rhs());
+  ASSERT_NE(lhs, rhs);
+  ASSERT_EQ(lhs->offset(), base + source.find('*'));
+  ASSERT_EQ(rhs->offset(), base + source.rfind('*'));
+  ASSERT_EQ(lhs->lhs()->offset(), base + source.find("a *"));
+  ASSERT_EQ(rhs->lhs()->offset(), base + source.rfind("a *"));
+}
+
+/**
+ * @brief Verify that a hash-consing Parser doesn't keep nodes on the heap
+ * alive once the ASTs that use them have gone, and doesn't hand them out again.
+ */
+TEST(ParserTests, TestHashConsedLifetime) {
+  using namespace hls;
+
+  std::string_view source("def my_func(a b) a * b + 1");
+  ASTFactory factory(nullptr, true);
+  // The table doesn't keep a function's body alive once the function's gone
+  std::weak_ptr<ExprAST> body;
+  {
+    auto product =
+        factory.binary('*', factory.variable("a"), factory.variable("b"));
+    body = product;
+    auto function = factory.function(factory.prototype("f", {"a", "b"}),
+                                     std::move(product));
+  }
+  ASSERT_TRUE(body.expired());
+  Lexer lexer(source);
+  Parser parser(lexer, factory);
+  parser.step();
+
+  // The same function again is made of fresh nodes
+  Lexer again_lexer(source);
+  Parser again_parser(again_lexer, factory);
+  auto again = again_parser.step();
+  ASSERT_EQ(factory.shared_nodes(), 0);
+  again.reset();
+
+  // Parsing many distinct expressions one at a time doesn't accumulate them
+  for (int i = 0; i < 10000; ++i) {
+    std::string sum_source = "x + " + std::to_string(i);
+    Lexer sum_lexer(sum_source);
+    Parser sum_parser(sum_lexer, factory);
+    sum_parser.step();
+  }
+  ASSERT_EQ(factory.shared_nodes(), 0);
+}
+
+/**
+ * @brief Verify that very deeply nested and very long expressions are parsed
+ * without exhausting the stack, with the same shapes as shallow ones, and are
+ * freed without exhausting it either, whether they're on the heap or in an
+ * Arena.
+ */
+TEST(ParserTests, TestDeepExpressionParsing) {
+  using namespace hls;
+  const int depth = 100000;
+
+  // Length of a chain of nodes, each the given child of the one before
+  auto chain = [](ExprAST* node, auto next) {
+    int length = 0;
+    while (auto* child = next(*node)) {
+      node = child;
+      ++length;
+    }
+    return length;
+  };
+  // Once on the heap and once in an Arena
+  for (auto arena : {std::shared_ptr<Arena>(), std::make_shared<Arena>()}) {
+    auto parse = [&arena](const std::string& source) {
+      Lexer lexer(source);
+      Parser parser(lexer, ASTFactory(arena));
+      auto function = std::static_pointer_cast<FunctionAST>(parser.step());
+      EXPECT_TRUE(parser.eof());
+      return function;
+    };
+
+    // A long sum associates to the left
+    std::string sum = "x";
+    for (int i = 0; i < depth; ++i) sum += " + x";
+    auto lhs = [](ExprAST& node) -> ExprAST* {
+      if (node.kind() != ASTKind::binary_expr) return nullptr;
+      auto& binary = static_cast<BinaryExprAST&>(node);
+      EXPECT_EQ(binary.rhs()->kind(), ASTKind::variable_expr);
+      return binary.lhs();
+    };
+    ASSERT_EQ(chain(parse(sum)->body(), lhs), depth);
+
+    // Every level of parentheses is a product with the level inside it
+    std::string nested = std::string(depth, '(') + "x";
+    for (int i = 0; i < depth; ++i) nested += " * 2)";
+    auto product = [](ExprAST& node) -> ExprAST* {
+      if (node.kind() != ASTKind::binary_expr) return nullptr;
+      auto& binary = static_cast<BinaryExprAST&>(node);
+      EXPECT_EQ(binary.op(), '*');
+      return binary.lhs();
+    };
+    ASSERT_EQ(chain(parse(nested)->body(), product), depth);
+
+    // Calls and if-expressions nested in their last argument or branch
+    std::string calls;
+    for (int i = 0; i < depth; ++i) calls += "f(1, ";
+    calls += "x" + std::string(depth, ')');
+    auto arg = [](ExprAST& node) -> ExprAST* {
+      if (node.kind() != ASTKind::call_expr) return nullptr;
+      auto& call = static_cast<CallExprAST&>(node);
+      EXPECT_EQ(call.arg_count(), 2);
+      return call.arg(1);
+    };
+    ASSERT_EQ(chain(parse(calls)->body(), arg), depth);
+
+    std::string ifs;
+    for (int i = 0; i < depth; ++i) ifs += "if x < 1 then 1 else ";
+    ifs += "0";
+    auto otherwise = [](ExprAST& node) -> ExprAST* {
+      if (node.kind() != ASTKind::if_expr) return nullptr;
+      return static_cast<IfExprAST&>(node).else_expr();
+    };
+    ASSERT_EQ(chain(parse(ifs)->body(), otherwise), depth);
+  }
+}
+
+/**
+ * @brief Verify that binary operators can be defined, both through the Parser
+ * and by the code being parsed, and are parsed with their precedence.
+ */
+TEST(ParserTests, TestOperatorParsing) {
+  using namespace hls;
+
+  std::string_view source(
+      "a | b + c\n"
+      "def binary& 50 (x y) x * y\n"
+      "a & b + c & d\n"
+      "extern binary~ (x)\n");
+  Lexer lexer(source);
+  Parser parser(lexer);
+  ASSERT_THROW(parser.add_binary_operator('(', 10), std::runtime_error);
+  ASSERT_THROW(parser.add_binary_operator('|', 0), std::runtime_error);
+  parser.add_binary_operator('|', 5);
+  ASSERT_EQ(parser.operators().precedence('|'), 5);
+
+  auto a = std::make_shared<VariableExprAST>("a");
+  auto b = std::make_shared<VariableExprAST>("b");
+  auto c = std::make_shared<VariableExprAST>("c");
+  auto d = std::make_shared<VariableExprAST>("d");
+  auto body = [](const std::shared_ptr<AST>& ast) -> const ExprAST& {
+    return *std::static_pointer_cast<FunctionAST>(ast)->body();
+  };
+  // | binds more loosely than +
+  ASSERT_EQ(body(parser.step()),
+            BinaryExprAST('|', a, std::make_shared<BinaryExprAST>('+', b, c)));
+
+  // & is defined by a function named after it, and binds more tightly than +
+  auto definition = std::static_pointer_cast<FunctionAST>(parser.step());
+  ASSERT_EQ(definition->proto()->name(), "binary&");
+  ASSERT_EQ(parser.operators().precedence('&'), 50);
+  ASSERT_EQ(body(parser.step()),
+            BinaryExprAST('+', std::make_shared<BinaryExprAST>('&', a, b),
+                          std::make_shared<BinaryExprAST>('&', c, d)));
+
+  // Operators must be binary
+  ASSERT_EQ(parser.step(), nullptr);
+  ASSERT_EQ(parser.operators().precedence('~'), -1);
+}
+
+/**
+ * @brief Verify that parsing a whole token stream hands every top-level AST
+ * to the consumer in order, skipping what can't be parsed.
+ */
+TEST(ParserTests, TestConsumerParsing) {
+  hls::Lexer lexer(std::string_view(
+      "extern sin(x)\ndef f x\ndef g(x) sin(x)\n; g(1)\n"));
+  hls::Parser parser(lexer);
+  std::vector<std::shared_ptr<hls::AST>> asts;
+  parser.parse([&](std::shared_ptr<hls::AST> ast) {
+    asts.push_back(std::move(ast));
+  });
+  ASSERT_TRUE(parser.eof());
+  ASSERT_EQ(asts.size(), 3);
+  ASSERT_EQ(asts[0]->kind(), hls::ASTKind::prototype);
+  auto g = std::static_pointer_cast<hls::FunctionAST>(asts[1]);
+  ASSERT_EQ(g->proto()->name(), "g");
+  auto top_level = std::static_pointer_cast<hls::FunctionAST>(asts[2]);
+  ASSERT_TRUE(top_level->proto()->name().empty());
+}
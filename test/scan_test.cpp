@@ -0,0 +1,51 @@
+/**
+ * @file scan_test.cpp
+ * @author Salvatore Cardamone
+ * @brief Unit tests for the vectorised character-class scanning.
+ */
+#include "hls/scan.hpp"
+
+#include <gtest/gtest.h>
+
+#include <random>
+#include <string>
+
+/**
+ * @brief Verify that the vectorised scans agree with the byte-wise scans from
+ * every starting position of a buffer mixing all the character classes,
+ * including bytes outside of ASCII.
+ */
+TEST(ScanTest, TestVectorisedMatchesScalar) {
+  const std::string alphabet =
+      " \t\n\r\v\f#_azAZ09@[`{.+()\x80\xff";
+  std::mt19937 rng(1234);
+  std::uniform_int_distribution<std::size_t> pick(0, alphabet.size() - 1);
+  // Biased runs of the same class so that we cross vector boundaries
+  std::string buffer;
+  while (buffer.size() < 4096) {
+    char c = alphabet[pick(rng)];
+    buffer.append(rng() % 48, c);
+  }
+
+  const char* data = buffer.data();
+  for (std::size_t pos = 0; pos < buffer.size(); ++pos) {
+    ASSERT_EQ(hls::scan::skip_whitespace(data, pos, buffer.size()),
+              hls::scan::skip_whitespace_scalar(data, pos, buffer.size()));
+    ASSERT_EQ(hls::scan::skip_identifier(data, pos, buffer.size()),
+              hls::scan::skip_identifier_scalar(data, pos, buffer.size()));
+    ASSERT_EQ(hls::scan::find_line_end(data, pos, buffer.size()),
+              hls::scan::find_line_end_scalar(data, pos, buffer.size()));
+  }
+}
+
+/**
+ * @brief Verify the byte-wise classification matches <cctype> in the "C"
+ * locale.
+ */
+TEST(ScanTest, TestClassification) {
+  for (int c = 0; c < 256; ++c) {
+    char as_char = static_cast<char>(c);
+    ASSERT_EQ(hls::scan::is_space(as_char), isspace(c) != 0);
+    ASSERT_EQ(hls::scan::is_identifier(as_char), isalnum(c) || c == '_');
+  }
+}
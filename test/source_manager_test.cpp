@@ -0,0 +1,172 @@
+/**
+ * @file source_manager_test.cpp
+ * @author Salvatore Cardamone
+ * @brief Unit tests for the locating of tokens, AST nodes and generated code
+ * in their source.
+ */
+// clang-format off
+#include <gtest/gtest.h>
+
+#include <llvm/IR/DebugInfoMetadata.h>
+#include <llvm/IR/Verifier.h>
+#include <llvm/Support/raw_ostream.h>
+
+#include <memory>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+#include "hls/ast.hpp"
+#include "hls/driver.hpp"
+#include "hls/lexer.hpp"
+#include "hls/parser.hpp"
+#include "hls/source_manager.hpp"
+// clang-format on
+
+/**
+ * @brief Verify that offsets in each of several buffers map back onto the
+ * right buffer, line and column.
+ */
+TEST(SourceManagerTests, Locations) {
+  hls::SourceManager sources;
+  std::string first = "def f(x)\n  x + 1\n";
+  std::string second = "\n\nf(2)";
+  hls::SourceOffset base = sources.add("first.k", first);
+  hls::SourceOffset next = sources.add("second.k", second);
+  ASSERT_NE(base, hls::no_offset);
+  ASSERT_EQ(sources.size(), 2);
+
+  auto location = [&](hls::SourceOffset offset) {
+    auto found = sources.location(offset);
+    return std::make_pair(found.line, found.column);
+  };
+  ASSERT_EQ(location(base), std::make_pair(1u, 1u));
+  ASSERT_EQ(location(base + first.find('x')), std::make_pair(1u, 7u));
+  ASSERT_EQ(location(base + first.find("x +")), std::make_pair(2u, 3u));
+  // The end of a buffer is a location of its own, on the line after a
+  // trailing newline
+  ASSERT_EQ(location(base + first.size()), std::make_pair(3u, 1u));
+  ASSERT_EQ(sources.name(base + first.size()), "first.k");
+
+  ASSERT_EQ(location(next + second.find('f')), std::make_pair(3u, 1u));
+  ASSERT_EQ(location(next + second.size()), std::make_pair(3u, 5u));
+  ASSERT_EQ(sources.name(next), "second.k");
+
+  // Offsets outside every buffer aren't anywhere
+  ASSERT_FALSE(sources.location(hls::no_offset).valid());
+  ASSERT_FALSE(sources.location(next + second.size() + 1).valid());
+  ASSERT_TRUE(sources.name(hls::no_offset).empty());
+
+  hls::SourceManager empty;
+  hls::SourceOffset nothing = empty.add("empty.k", "");
+  ASSERT_EQ(empty.location(nothing).line, 1);
+  ASSERT_EQ(empty.location(nothing).column, 1);
+}
+
+/**
+ * @brief Verify that Tokens and AST nodes record where they were lexed and
+ * parsed from, and that this doesn't affect their equality.
+ */
+TEST(SourceManagerTests, TokensAndNodes) {
+  std::string source =
+      "def f(x)\n"
+      "  if x < 1 then g(x) else x * (x + 2)\n";
+  hls::SourceManager sources;
+  hls::SourceOffset base = sources.add("nodes.k", source);
+  auto line_column = [&](const hls::AST& ast) {
+    auto location = sources.location(ast.offset());
+    return std::make_pair(location.line, location.column);
+  };
+
+  hls::Lexer lexer(source, nullptr, nullptr, base);
+  hls::Token def = lexer.get_token();
+  ASSERT_EQ(def.offset(), base);
+  hls::Token name = lexer.get_token();
+  ASSERT_EQ(name.offset(), base + 4);
+  ASSERT_TRUE(name == hls::Token(hls::TokenType::tok_identifier, "f"));
+
+  hls::Lexer unregistered(source);
+  ASSERT_EQ(unregistered.get_token().offset(), hls::no_offset);
+
+  hls::Lexer parsed_lexer(source, nullptr, nullptr, base);
+  hls::Parser parser(parsed_lexer);
+  auto function = std::static_pointer_cast<hls::FunctionAST>(parser.step());
+  ASSERT_EQ(line_column(*function), std::make_pair(1u, 1u));
+  ASSERT_EQ(line_column(*function->proto()), std::make_pair(1u, 5u));
+
+  auto& if_expr = static_cast<hls::IfExprAST&>(*function->body());
+  ASSERT_EQ(line_column(if_expr), std::make_pair(2u, 3u));
+  // Binary expressions are located at their operator
+  ASSERT_EQ(line_column(*if_expr.cond()), std::make_pair(2u, 8u));
+  auto& cond = static_cast<hls::BinaryExprAST&>(*if_expr.cond());
+  ASSERT_EQ(line_column(*cond.lhs()), std::make_pair(2u, 6u));
+  ASSERT_EQ(line_column(*cond.rhs()), std::make_pair(2u, 10u));
+  ASSERT_EQ(line_column(*if_expr.then_expr()), std::make_pair(2u, 17u));
+  auto& product = static_cast<hls::BinaryExprAST&>(*if_expr.else_expr());
+  ASSERT_EQ(line_column(product), std::make_pair(2u, 29u));
+  ASSERT_EQ(line_column(*product.rhs()), std::make_pair(2u, 34u));
+
+  // Locations aren't part of a node's structure
+  hls::Lexer unlocated_lexer(source);
+  hls::Parser unlocated(unlocated_lexer);
+  auto same = unlocated.step();
+  ASSERT_EQ(same->offset(), hls::no_offset);
+  ASSERT_TRUE(*same == *function);
+  ASSERT_EQ(hls::structural_hash(*same), hls::structural_hash(*function));
+}
+
+/**
+ * @brief Verify that the offset costs AST nodes no memory; it has to fit in
+ * the padding after the node kind.
+ */
+TEST(SourceManagerTests, NodeSize) {
+  struct UnlocatedAST {
+    virtual ~UnlocatedAST() {}
+    hls::ASTKind kind;
+  };
+  ASSERT_EQ(sizeof(hls::AST), sizeof(UnlocatedAST));
+}
+
+/**
+ * @brief Verify that debug info locates the generated instructions at the
+ * nodes they were generated from, and that it's only generated on request.
+ */
+TEST(SourceManagerTests, DebugInfo) {
+  std::string source =
+      "extern sin(x)\n"
+      "def f(x)\n"
+      "  sin(x) * 2\n"
+      "f(1)\n";
+  hls::CodegenOptions options;
+  options.opt_level = hls::OptLevel::O0;
+  auto plain = hls::Driver::compile_source(source, "dir/debug.k", options);
+  ASSERT_EQ(plain.module->getFunction("f")->getSubprogram(), nullptr);
+
+  options.debug_info = true;
+  auto module = hls::Driver::compile_source(source, "dir/debug.k", options);
+  std::string errors;
+  llvm::raw_string_ostream os(errors);
+  bool broken_debug_info = false;
+  ASSERT_FALSE(llvm::verifyModule(*module.module, &os, &broken_debug_info))
+      << errors;
+  ASSERT_FALSE(broken_debug_info);
+
+  auto* function = module.module->getFunction("f");
+  auto* subprogram = function->getSubprogram();
+  ASSERT_NE(subprogram, nullptr);
+  ASSERT_EQ(subprogram->getLine(), 2);
+  ASSERT_EQ(subprogram->getFilename(), "debug.k");
+  ASSERT_EQ(subprogram->getDirectory(), "dir");
+
+  std::vector<std::pair<unsigned, unsigned>> locations;
+  for (const auto& instruction : function->getEntryBlock()) {
+    const llvm::DebugLoc& location = instruction.getDebugLoc();
+    ASSERT_TRUE(location);
+    locations.emplace_back(location.getLine(), location.getCol());
+  }
+  // The call, the multiplication, and the return at the definition
+  std::vector<std::pair<unsigned, unsigned>> expected{
+      {3, 3}, {3, 10}, {2, 1}};
+  ASSERT_EQ(locations, expected);
+}
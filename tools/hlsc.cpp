@@ -0,0 +1,174 @@
+/**
+ * @file hlsc.cpp
+ * @author Salvatore Cardamone
+ * @brief Command-line compiler driver. Compiles Kaleidoscope source files to
+ * LLVM IR in parallel.
+ *
+ * Usage: hlsc [-j threads] [-o output.ll] [-O0|-O1|-O2|-O3] [--passes=pipeline]
+ *             [--cache=directory] [-g] [--no-link]
+ *             [--split-functions|--stream] file...
+ *
+ * By default the modules are linked and the result is written to the output
+ * file, or stdout if there isn't one. With --no-link, each file.k is compiled
+ * to file.k.ll alongside it instead. Files are compiled in parallel with each
+ * other; with --split-functions they're compiled one after the other, but the
+ * functions within each file are compiled in parallel, which suits a few large
+ * files better than many small ones. --stream also compiles the functions of
+ * each file in parallel, but starts on them while the file is still being
+ * parsed.
+ *
+ * Functions are optimised at -O2 unless another level is given; --passes
+ * replaces the default pipeline with a function pass pipeline in the syntax of
+ * opt's -passes. With --cache, optimised functions are kept in the given
+ * directory and reused by later runs; hit and miss counts are reported on
+ * stderr. With -g, every instruction is given a debug location pointing back
+ * at the line and column of the source it was generated from.
+ *
+ * Errors and warnings in the source are printed to stderr as they're found.
+ * If there were any errors, the output is still written but hlsc exits with a
+ * failure status.
+ */
+#include <llvm/Support/FileSystem.h>
+#include <llvm/Support/raw_ostream.h>
+
+#include <atomic>
+#include <cstdlib>
+#include <exception>
+#include <iostream>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "hls/compile_cache.hpp"
+#include "hls/diagnostics.hpp"
+#include "hls/driver.hpp"
+
+namespace {
+
+/**
+ * @brief Prints diagnostics to stderr, counting the errors among them.
+ */
+class CountingSink : public hls::StreamDiagnosticSink {
+ public:
+  void report(const hls::Diagnostic& diagnostic) override {
+    if (diagnostic.severity == hls::Severity::error) ++errors;
+    StreamDiagnosticSink::report(diagnostic);
+  }
+
+  std::atomic<std::size_t> errors{0};
+};
+
+/**
+ * @brief Print the usage message.
+ * @param program Name the tool was invoked as.
+ */
+void usage(const char* program) {
+  std::cerr << "Usage: " << program
+            << " [-j threads] [-o output.ll] [-O0|-O1|-O2|-O3]"
+            << " [--passes=pipeline] [--cache=directory] [-g] [--no-link]"
+            << " [--split-functions|--stream] file...\n";
+}
+
+/**
+ * @brief Write an IR module out as text.
+ * @param module The module to write.
+ * @param path File to write to; "-" for stdout.
+ */
+void write(const llvm::Module& module, const std::string& path) {
+  std::error_code error;
+  llvm::raw_fd_ostream os(path, error, llvm::sys::fs::OF_Text);
+  if (error) {
+    throw std::runtime_error("Couldn't open " + path + ": " + error.message());
+  }
+  module.print(os, nullptr);
+}
+
+}  // namespace
+
+int main(int argc, char* argv[]) {
+  unsigned threads = 0;
+  std::string output = "-";
+  bool link = true;
+  bool split_functions = false;
+  bool stream = false;
+  hls::CodegenOptions options;
+  std::string cache;
+  std::vector<std::string> paths;
+
+  for (int i = 1; i < argc; ++i) {
+    std::string arg = argv[i];
+    if (arg == "-j" && i + 1 < argc) {
+      threads = static_cast<unsigned>(std::strtoul(argv[++i], nullptr, 10));
+    } else if (arg == "-o" && i + 1 < argc) {
+      output = argv[++i];
+    } else if (arg == "-O0") {
+      options.opt_level = hls::OptLevel::O0;
+    } else if (arg == "-O1") {
+      options.opt_level = hls::OptLevel::O1;
+    } else if (arg == "-O2") {
+      options.opt_level = hls::OptLevel::O2;
+    } else if (arg == "-O3") {
+      options.opt_level = hls::OptLevel::O3;
+    } else if (arg.rfind("--passes=", 0) == 0) {
+      options.pipeline = arg.substr(std::string("--passes=").size());
+    } else if (arg.rfind("--cache=", 0) == 0) {
+      cache = arg.substr(std::string("--cache=").size());
+    } else if (arg == "-g") {
+      options.debug_info = true;
+    } else if (arg == "--no-link") {
+      link = false;
+    } else if (arg == "--split-functions") {
+      split_functions = true;
+    } else if (arg == "--stream") {
+      stream = true;
+    } else if (arg == "-h" || arg == "--help") {
+      usage(argv[0]);
+      return EXIT_SUCCESS;
+    } else if (!arg.empty() && arg[0] == '-') {
+      usage(argv[0]);
+      return EXIT_FAILURE;
+    } else {
+      paths.push_back(arg);
+    }
+  }
+  if (paths.empty()) {
+    usage(argv[0]);
+    return EXIT_FAILURE;
+  }
+
+  auto diagnostics = std::make_shared<CountingSink>();
+  options.diagnostics = diagnostics;
+  try {
+    if (!cache.empty())
+      options.cache = std::make_shared<hls::CompileCache>(cache);
+    hls::Driver driver(threads, options);
+    std::vector<hls::CodegenModule> modules;
+    if (stream) {
+      for (const auto& path : paths)
+        modules.push_back(driver.compile_streaming(path));
+    } else if (split_functions) {
+      for (const auto& path : paths)
+        modules.push_back(driver.compile_functions(path));
+    } else {
+      modules = driver.compile(paths);
+    }
+    if (link) {
+      auto linked = hls::Driver::link(std::move(modules), output);
+      write(*linked.module, output);
+    } else {
+      for (std::size_t i = 0; i < paths.size(); ++i)
+        write(*modules[i].module, paths[i] + ".ll");
+    }
+    if (options.cache) {
+      auto stats = options.cache->stats();
+      std::cerr << "Cache: " << stats.hits << " hits, " << stats.misses
+                << " misses\n";
+    }
+  } catch (const std::exception& e) {
+    std::cerr << argv[0] << ": " << e.what() << "\n";
+    return EXIT_FAILURE;
+  }
+  return diagnostics->errors ? EXIT_FAILURE : EXIT_SUCCESS;
+}